@@ -2,642 +2,8680 @@
 // Name        : testMaker.cpp
 // Author      : Levi Hoffer
 // Description : Allows user to create a quiz and then take that quiz
-// Compile     : g++ testMaker.cpp (in linux)
+// Compile     : g++ -std=c++17 -O2 -pthread testMaker.cpp (in linux)
 // Run         : ./a.out
+//             : ./a.out --grade <bank file> <submissions file> <scores file> [item analysis report]
+//             : ./a.out --leaderboard <scores file> [student ...]
+//             : ./a.out --script <script file, or - for stdin>
+//             : ./a.out --serve <bank file> <unix:/path | tcp:host:port> [threads] [exam seconds] [question seconds]
+//             :         (SIGHUP reloads the bank)
+//             : ./a.out --loadtest <unix:/path | tcp:host:port> <sessions> [concurrent takers]
+//             : ./a.out --forms <bank file> <students> <questions per form> [seed]
+//             : ./a.out --adaptive <bank file> [questions]   (IRT-calibrated adaptive test)
+//             : ./a.out --take <bank file> [exam seconds]   (submitted automatically when time is up)
+//             : ./a.out --duplicates <bank file> [similarity threshold]   (near-duplicate clusters, default 0.8)
+//             : ./a.out --verify <bank file>   (checksum and every record; opening checks only the header)
+//             : ./a.out --memory <bank file>   (bytes interning and text coding save, per field)
+//             : ./a.out --synthesize <bank file> <questions> [seed]   (calibrated bank of every question type)
+//             : ./a.out --simulate <bank file> <takers> <submissions file> [trace file] [seed]
+//             :         (synthetic takers: answer sheets for --grade, protocol commands per taker)
+//             : ./a.out --import <csv or jsonl file> <bank file>
+//             : ./a.out --journal <base path>   (author with every change journaled to disk)
+// Benchmark   : g++ -std=c++17 -O2 -pthread -DBENCHMARKING testMaker.cpp -o bench
+//             : ./bench [--sizes 10000,100000,1000000] [--json results.json] [--seed n]
+// Metrics     : g++ -std=c++17 -O2 -pthread -DMETRICS testMaker.cpp
+//             : QUIZ_METRICS_FILE=quiz.prom [QUIZ_METRICS_INTERVAL=seconds] ./a.out ...
+//             : writes a Prometheus text snapshot every interval (default 10s), on SIGUSR1 and at exit
 // Credit      : Used chatGPT to help with limit error
 //             : Used youTube video (https://www.youtube.com/watch?v=eiugg-Nb40A)
 //             : to learn about class implementation
 //=============================================================================
 //#define UNIT_TESTING // UNCOMMENT FOR TESTING!!
+//#define BENCHMARKING // UNCOMMENT FOR THE BENCHMARK SUITE
+//#define METRICS // UNCOMMENT FOR LATENCY AND COUNTER METRICS
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <cstdint>
 #include <limits>
 #include <cctype>
 #include <memory>
+#include <utility>    // std::as_const for read-only store access
 #include <cassert>
-//#include <vector> //no arrays are used in this code
+#include <vector>
 #include <iomanip>
 #include <algorithm> // Include algorithm for std::find
-//#include <unordered_map>
+#include <unordered_map>
+#include <tuple>
+#include <map>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <sys/mman.h>  // mmap for reading quiz bank files
+#include <sys/stat.h>
+#include <dirent.h>    // finding edit journal generations
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <sstream>
+#include <charconv>
+#include <cmath>
+#include <immintrin.h>  // AVX2 grading kernel
+#include <sys/resource.h>
+#include <poll.h>        // waiting for console input against a time limit
+#include <sys/socket.h>  // quiz server and load-test client
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <csignal>
 
 using namespace std;
 
 
-// Struct representing a choice in the linked list of choices for MCQs
-struct ChoiceNode {
-    char letter; //stores letter
-    string choiceText;           // Text of the answer choice
+// HDR-style latency histogram: exact up to 64 ns, then 64 linear buckets per
+// power of two up to about 18 minutes, so any reported value is within 1% of
+// what was recorded. This is the merged, single-threaded form; threads
+// record into MetricsBlocks.
+struct LatencyHistogram {
+    static constexpr int subBucketBits = 6;
+    static constexpr int maxExponent = 40;  // Values from 2^40 ns up share the last bucket
+    static constexpr size_t bucketCount = static_cast<size_t>(maxExponent - subBucketBits + 1) << subBucketBits;
 
-    ChoiceNode* next; // Pointer to the next choice
+    vector<uint64_t> counts = vector<uint64_t>(bucketCount);
+    uint64_t total = 0;  // Values recorded
+    uint64_t sumNs = 0;
+    uint64_t maxNs = 0;
 
-    // Constructor for initializing a choice with given text
-    explicit ChoiceNode(char c, const string& text) : letter(c), choiceText(text), next(nullptr) {}
+    // Function to find the bucket holding a value
+    static size_t bucketOf(uint64_t ns) {
+        if (ns < (1u << subBucketBits)) return ns;
+        int exponent = 63 - __builtin_clzll(ns);
+        if (exponent >= maxExponent) return bucketCount - 1;
+        return (static_cast<size_t>(exponent - subBucketBits + 1) << subBucketBits) +
+               (ns >> (exponent - subBucketBits)) - (1u << subBucketBits);
+    }
+
+    // Function to give the middle of a bucket's range
+    static uint64_t bucketValue(size_t bucket) {
+        if (bucket < (1u << subBucketBits)) return bucket;
+        int shift = static_cast<int>(bucket >> subBucketBits) - 1;
+        uint64_t low = ((bucket & ((1u << subBucketBits) - 1)) + (1u << subBucketBits)) << shift;
+        return low + (uint64_t(1) << shift) / 2;
+    }
+
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        total++;
+        sumNs += ns;
+        maxNs = max(maxNs, ns);
+    }
+
+    // Function to estimate the value below which a fraction q of the recorded values fall
+    uint64_t quantile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(q * total)));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < bucketCount; bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank) return min(bucketValue(bucket), maxNs);
+        }
+        return maxNs;
+    }
 };
 
 
-// Struct representing a question in the quiz
-struct Question {
-    int id;                     // Unique ID for the question
-    string type;                // Type of question (e.g., mcq, tf, wr)
-    string text;                // Question text
-    //vector<string> choices;     // Answer choices (for MCQs)
-    ChoiceNode* choicesHead; //answer choices  for MCQs
-    string correctAnswer;       // Correct answer
-    double points;              // Points awarded for this question
-    shared_ptr<Question> next;  // Pointer to the next question in the linked list
-    string studentAnswer; //The student's answer 0_0
+// Counters and latency timers for finding where time goes in production.
+// Each thread records into its own MetricsBlock of relaxed atomics: with one
+// writer per block an add is a plain load and store, never a locked
+// read-modify-write. Blocks are pushed onto a lock-free list when a thread
+// first records and live for the rest of the process, so a snapshot can walk
+// and sum them at any time without stopping anyone. Instrumentation points
+// use the METRIC_* macros, which compile to nothing unless built with -DMETRICS.
+struct Metrics {
+    enum Counter { questionsDisplayed, answersRecorded, submits, lookups, lookupMisses, counterCount };
+    enum Timer { displayQuestion, submit, getQuestionById, thinkTime, timerCount };
 
-    // Constructor to initialize a question with a given ID and default values
-    explicit Question(int questionId) : id(questionId), choicesHead(nullptr), points(0.0), next(nullptr) {}
+    // One thread's counts
+    struct Block {
+        atomic<uint64_t> counters[counterCount];
+        struct TimerCounts {
+            atomic<uint64_t> buckets[LatencyHistogram::bucketCount];
+            atomic<uint64_t> total, sumNs, maxNs;
+        } timers[timerCount];
+        Block* next;
+    };
 
-    void addChoice(char c, const string& text) {
-        ChoiceNode* newAnswer = new ChoiceNode(c, text);
-        if (choicesHead == nullptr) {
-            choicesHead = newAnswer;
-        } else {
-            ChoiceNode* temp = choicesHead;
-            while (temp->next != nullptr) {
-                temp = temp->next;
+    // Every thread's counts added up
+    struct Snapshot {
+        uint64_t counters[counterCount] = {};
+        LatencyHistogram timers[timerCount];
+    };
+
+    static inline atomic<Block*> blocks{nullptr};
+
+    static void add(atomic<uint64_t>& value, uint64_t amount) {
+        value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    // Function to find this thread's block, creating and publishing it on first use
+    static Block& local() {
+        thread_local Block* block = [] {
+            Block* created = new Block();  // Value-initialized: every count starts at zero
+            created->next = blocks.load(memory_order_relaxed);
+            while (!blocks.compare_exchange_weak(created->next, created, memory_order_release, memory_order_relaxed)) {}
+            return created;
+        }();
+        return *block;
+    }
+
+    static void count(Counter counter, uint64_t amount = 1) { add(local().counters[counter], amount); }
+
+    static void record(Timer timer, uint64_t ns) {
+        Block::TimerCounts& counts = local().timers[timer];
+        add(counts.buckets[LatencyHistogram::bucketOf(ns)], 1);
+        add(counts.total, 1);
+        add(counts.sumNs, ns);
+        if (ns > counts.maxNs.load(memory_order_relaxed)) counts.maxNs.store(ns, memory_order_relaxed);
+    }
+
+    // Function to add up every thread's counts; threads keep recording meanwhile
+    static Snapshot snapshot() {
+        Snapshot merged;
+        for (Block* block = blocks.load(memory_order_acquire); block; block = block->next) {
+            for (int c = 0; c < counterCount; c++) merged.counters[c] += block->counters[c].load(memory_order_relaxed);
+            for (int t = 0; t < timerCount; t++) {
+                const Block::TimerCounts& counts = block->timers[t];
+                LatencyHistogram& histogram = merged.timers[t];
+                for (size_t b = 0; b < LatencyHistogram::bucketCount; b++) {
+                    histogram.counts[b] += counts.buckets[b].load(memory_order_relaxed);
+                }
+                histogram.total += counts.total.load(memory_order_relaxed);
+                histogram.sumNs += counts.sumNs.load(memory_order_relaxed);
+                histogram.maxNs = max(histogram.maxNs, counts.maxNs.load(memory_order_relaxed));
             }
-            temp->next = newAnswer;
         }
+        return merged;
     }
 
-    void printQuestion() {
-        ChoiceNode* temp = choicesHead;
-        while (temp != nullptr) {
-            std::cout << temp->letter << ". " << temp->choiceText << std::endl;
-            temp = temp->next;
+    // Function to format a snapshot in the Prometheus text exposition format
+    static string prometheus(const Snapshot& snapshot) {
+        static const char* const counterNames[counterCount][2] = {
+            {"quiz_questions_displayed_total", "Questions shown to a taker"},
+            {"quiz_answers_recorded_total", "Answers recorded for a question"},
+            {"quiz_submits_total", "Attempts graded"},
+            {"quiz_question_lookups_total", "Questions looked up by id"},
+            {"quiz_question_lookup_misses_total", "Lookups of an id with no question"},
+        };
+        static const char* const timerNames[timerCount][2] = {
+            {"quiz_display_question_seconds", "Time to render a question for a taker"},
+            {"quiz_submit_seconds", "Time to grade an attempt"},
+            {"quiz_question_lookup_seconds", "Time to look up a question by id (one lookup in 64 is timed)"},
+            {"quiz_think_seconds", "Time from showing a question to receiving its answer"},
+        };
+        string text;
+        char line[256];
+        for (int c = 0; c < counterCount; c++) {
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counterNames[c][0],
+                     counterNames[c][1], counterNames[c][0], counterNames[c][0],
+                     static_cast<unsigned long long>(snapshot.counters[c]));
+            text += line;
         }
-        std::cout << "Correct answer: " << correctAnswer << std::endl;
+        for (int t = 0; t < timerCount; t++) {
+            const char* name = timerNames[t][0];
+            const LatencyHistogram& histogram = snapshot.timers[t];
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s summary\n", name, timerNames[t][1], name);
+            text += line;
+            for (double q : {0.5, 0.9, 0.99, 0.999}) {
+                snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9f\n", name, q, histogram.quantile(q) / 1e9);
+                text += line;
+            }
+            snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n%s_max %.9f\n", name, histogram.sumNs / 1e9, name,
+                     static_cast<unsigned long long>(histogram.total), name, histogram.maxNs / 1e9);
+            text += line;
+        }
+        return text;
     }
 
-    void resetAnswers() {
-        ChoiceNode* current = choicesHead;
-        while (current != nullptr) {
-            ChoiceNode* nextNode = current->next; // Save the next node
-            delete current;                        // Delete current node
-            current = nextNode;                    // Move to next node
+    // Function to write a snapshot file, replacing the old one only once the new one is complete
+    static bool writeSnapshot(const string& path) {
+        string tempPath = path + ".tmp";
+        {
+            ofstream out(tempPath, ios::trunc);
+            out << prometheus(snapshot());
+            if (!out.flush()) return false;
         }
-
-        // Ensure head is a nullptr after clearing
-        choicesHead = nullptr;
+        return rename(tempPath.c_str(), path.c_str()) == 0;
     }
 };
 
 
-// Class representing the quiz and containing operations to manage questions
-class Quiz {
+// Times the scope it lives in into a Metrics timer
+class MetricTimer {
 private:
-    shared_ptr<Question> head;  // Head pointer of the linked list of questions
-    int questionCount;          // Counter for the number of questions in the quiz
-    double totalPoints;         // Sum of all points for all questions
-    double score;               //sum of student points
+    Metrics::Timer timer;
+    bool active;
+    chrono::steady_clock::time_point start;
 
 public:
-    // Constructor initializing the quiz with no questions
-    Quiz() : head(nullptr), questionCount(0), totalPoints(0.0), score(0.0) {}
-    bool errorMessage = false;
-    double getScore() {
-        return score;
-    }
-    // Function to clear the input stream, handling input errors
-    void clearInput() {
-        cin.clear();
-        if (cin.peek() == '\n') {
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        }
+    explicit MetricTimer(Metrics::Timer timerToRecord, bool sampled = true) : timer(timerToRecord), active(sampled) {
+        if (active) start = chrono::steady_clock::now();
     }
-    //check if no questions submitted
-    bool check1() {
-        if(questionCount == 0) {
-            cout << "Warning - the number of questions to be asked must equal to or be larger than 1." << endl;
-            return false;
-        }
-        return true;
+    ~MetricTimer() {
+        if (active) Metrics::record(timer, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
     }
-    //check for null ptr;
-    bool check2() {
-       if(!check1()) {
-           if(head == nullptr) {
-               cout << "[Linked list set to NULL]" << endl;
-               return false;
-           }
-           cout << "[Linked list not set to NULL]" << endl;
-           return true;
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+};
+
+#ifdef METRICS
+#define METRIC_COUNT(counter) Metrics::count(Metrics::counter)
+#define METRIC_TIME(timer) MetricTimer metricTimer(Metrics::timer)
+// Times one call in 64, for operations so quick that reading the clock would dominate them
+#define METRIC_TIME_SAMPLED(timer) \
+    static thread_local uint32_t metricSample = 0; \
+    MetricTimer metricTimer(Metrics::timer, (++metricSample & 63) == 0)
+#define METRIC_RECORD(timer, ns) Metrics::record(Metrics::timer, ns)
+#else
+#define METRIC_COUNT(counter) ((void)0)
+#define METRIC_TIME(timer) ((void)0)
+#define METRIC_TIME_SAMPLED(timer) ((void)0)
+#define METRIC_RECORD(timer, ns) ((void)0)
+#endif
 
-       }
-        return true;
-    }
 
+// Writes a metrics snapshot to a file every interval, whenever the process
+// gets SIGUSR1, and once more when it is destroyed
+class MetricsExporter {
 private:
-    // Helper function to get validated input from the user
-    //const vector<string>& validOptions = {}
-    string getInput(const string& prompt, string type) {
-        string input;
-        while (true) {
-            cout << prompt;
-            cin >> input;
-            clearInput();
+    string path;
+    chrono::milliseconds interval;
+    mutex lock;
+    condition_variable wakeup;
+    bool stopping = false;
+    thread worker;
 
-            // Convert input to lowercase for case-insensitive comparison
-            for (auto& c : input) c = tolower(c);
-            int typeNum = -1;
-            if(type == "create") {
-                typeNum = 1;
-            }
-            else if(type == "TF") {
-                typeNum = 2;
-            }
-            else if(type == "MCQ") {
-                typeNum = 3;
-            }
+    static inline atomic<bool> requested{false};
+    static void onSignal(int) { requested.store(true); }
 
-            switch(typeNum) {
-                case 1:
-                    if(input == "mcq" || input == "tf" || input == "wr") {
-                        return input;
-                    }
-                break;
-                case 2:
-                    if(input == "true" || input == "false") {
-                        return input;
-                    }
-                break;
-                case 3:
-                    if(isalpha(input[0])) {
-                        return input;
-                    }
-                break;
-                default:
-                    return input;
+public:
+    MetricsExporter(string snapshotPath, double seconds)
+        : path(std::move(snapshotPath)), interval(static_cast<long>(max(seconds, 0.1) * 1000)) {
+        signal(SIGUSR1, onSignal);
+        worker = thread([this] {
+            auto due = chrono::steady_clock::now() + interval;
+            unique_lock<mutex> guard(lock);
+            while (!stopping) {
+                // Signal handlers cannot notify a condition variable, so look for requests every 100 ms
+                wakeup.wait_for(guard, min<chrono::steady_clock::duration>(chrono::milliseconds(100), interval));
+                if (requested.exchange(false) || chrono::steady_clock::now() >= due) {
+                    Metrics::writeSnapshot(path);
+                    due = chrono::steady_clock::now() + interval;
+                }
             }
-
-            cout << "[Invalid input, please try again!]" << endl;
-        }
+        });
     }
 
-    // Modified getInput function to handle integer actions
-    int getActionInput(const string& prompt) {
-        string input;
-        int action;
-        while (true) {
-            cout << prompt;
-            getline(cin, input);  // Use getline to avoid newline issues
-            try {
-                action = stoi(input);  // Convert string to integer
-                return action;
-            } catch (const invalid_argument&) {
-                cout << "[Unknown input, please try again]" << endl;
-            }
+    ~MetricsExporter() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
         }
+        wakeup.notify_all();
+        worker.join();
+        signal(SIGUSR1, SIG_DFL);
+        Metrics::writeSnapshot(path);
     }
 
-    // Helper function to get a validated point value for the question
-    double getPointsInput() {
-        double points;
-        while (true) {
-            cout << "Enter point value: ";
-            cin >> points;
-            if (!cin.fail() && points >= 0) break;
-            cout << "[Invalid input, please try again!]" << endl;
-            clearInput();
-        }
-        clearInput();
-        return points;
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+};
+
+
+// Reference to a piece of text stored in a StringArena
+struct ArenaString {
+    uint32_t offset;  // Byte offset of the text in the arena
+    uint32_t length;  // Length of the text in bytes
+};
+
+
+// Append-only character heap for keeping many strings together (a string
+// pool page, an answer sheet, a bank file's heap). Nothing is ever taken
+// out; owners that drop strings rebuild their arena instead. References
+// are 32-bit, so an owner that can pass 4 GiB checks size() itself.
+class StringArena {
+private:
+    string bytes;  // Every string added so far, back to back
+
+public:
+    // Function to copy text into the arena and return a reference to it
+    ArenaString add(string_view text) {
+        ArenaString ref{static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(text.size())};
+        bytes += text;
+        return ref;
     }
 
-    // Function to add a new question to the end of the linked list
-    void addQuestionNode(shared_ptr<Question> newQuestion) {
-        if (!head) {  // If list is empty, new question is the head
-            head = newQuestion;
-        } else {  // Traverse to the end of the list and append the new question
-            auto temp = head;
-            while (temp->next) {
-                temp = temp->next;
-            }
-            temp->next = newQuestion;
-        }
-        questionCount++;            // Increment question count
-        totalPoints += newQuestion->points;  // Add to total points
+    // Function to view text previously added; valid until the next add
+    string_view view(ArenaString ref) const {
+        return string_view(bytes.data() + ref.offset, ref.length);
     }
 
-    // Function to retrieve a question by its ID
-    shared_ptr<Question> getQuestionById(int id) {
-        auto temp = head;
-        while (temp) {
-            if (temp->id == id) return temp;
-            temp = temp->next;
+    size_t size() const { return bytes.size(); }
+    void clear() { bytes.clear(); }
+};
+
+
+// Points and scores are kept in fixed point, in millionths of a point, so
+// totals and scores add up exactly in any order and deleting a question
+// takes off exactly what adding it put on. Point values are rounded to the
+// nearest millionth when they enter a quiz.
+using FixedPoints = int64_t;
+const double fixedPointsScale = 1e6;
+const double maxQuestionPoints = 1e6;  // So even millions of questions total well inside int64_t
+
+FixedPoints toFixedPoints(double points) {
+    return llround(points * fixedPointsScale);
+}
+
+double fromFixedPoints(FixedPoints points) {
+    return points / fixedPointsScale;
+}
+
+
+// The question types. Each has a policy struct (McqType, TfType, ...) that
+// visitType() dispatches to; the names are what bank files, journals,
+// imports and protocol lines spell them as.
+enum class QuestionKind : uint8_t { mcq, tf, wr, numeric, multi };
+const int questionKindCount = 5;
+const char* const questionKindNames[questionKindCount] = {"mcq", "tf", "wr", "numeric", "multi"};
+
+const char* kindName(QuestionKind kind) {
+    return questionKindNames[static_cast<int>(kind)];
+}
+
+// Function to look up a type by its lowercase name; false if there is no such type
+bool parseKind(string_view name, QuestionKind& kind) {
+    for (int i = 0; i < questionKindCount; i++) {
+        if (name == questionKindNames[i]) {
+            kind = static_cast<QuestionKind>(i);
+            return true;
         }
-        return nullptr;  // Return nullptr if question not found
     }
+    return false;
+}
 
+// Function to list the type names for a prompt, e.g. "mcq/tf/wr"
+string kindChoices() {
+    string names;
+    for (int i = 0; i < questionKindCount; i++) names += (i ? "/" : "") + string(questionKindNames[i]);
+    return names;
+}
 
-    // Function to create a multiple-choice question
-    void createMCQ(shared_ptr<Question> question) {
-        question->type = "mcq";
-        cout << "Enter a question: ";
-        getline(cin, question->text);
 
-        // Collect answer choices for the MCQ
-        string choice;
-        for (char option = 'A'; option <= 'Z'; ++option) {
-            cout << "Enter choice " << option << ": ";
-            getline(cin, choice);
-            if (choice == "quit()") break;
-            //question->choices.push_back(string(1, option) + ". " + choice);
-            question -> addChoice(option, choice);
-        }
+// Item response theory parameters of a question under the three-parameter
+// logistic model: a taker of ability theta answers correctly with probability
+// guessing + (1 - guessing) / (1 + exp(-discrimination * (theta - difficulty))).
+// Abilities and difficulties are on the logistic scale, 0 being the average
+// taker. Uncalibrated questions get the defaults.
+struct ItemParameters {
+    float discrimination = 1.0f;  // a: how sharply the question separates abilities near its difficulty
+    float difficulty = 0.0f;      // b: ability at which a taker is halfway from guessing to certain
+    float guessing = 0.0f;        // c: chance that a taker of very low ability still answers correctly
 
-        // Get the correct answer and point value
-        question->correctAnswer = getInput("Select correct answer: ", "MCQ");
-        question->points = getPointsInput();
-        cout << "Question saved." << endl;
+    // Function to give the chance that a taker of ability theta answers correctly
+    double probability(double theta) const {
+        return guessing + (1.0 - guessing) / (1.0 + exp(-discrimination * (theta - difficulty)));
     }
 
-    // Function to create a true/false question
-    void createTF(shared_ptr<Question> question) {
-        question->type = "tf";
-        cout << "Enter a question: ";
-        getline(cin, question->text);
-
-        // Get correct answer and point value
-        question->correctAnswer = getInput("Select correct answer [true/false]: ", "TF");
-        question->points = getPointsInput();
-        cout << "Question saved." << endl;
+    // Function to give the Fisher information the question carries about ability theta
+    double information(double theta) const {
+        double p = probability(theta);
+        double above = (p - guessing) / (1.0 - guessing);
+        return discrimination * discrimination * above * above * (1.0 - p) / p;
     }
 
-    // Function to create a written response question
-    void createWR(shared_ptr<Question> question) {
-        question->type = "wr";
-        cout << "Enter a question: ";
-        getline(cin, question->text);
+    bool isDefault() const { return discrimination == 1.0f && difficulty == 0.0f && guessing == 0.0f; }
+};
 
-        // Get correct answer and point value
-        cout << "Type correct answer: ";
-        getline(cin, question->correctAnswer);
-        question->points = getPointsInput();
-        cout << "Question saved." << endl;
-    }
+// Function to check parameters are ones the model can use (also rejects NaN)
+bool validItemParameters(const ItemParameters& parameters) {
+    return parameters.discrimination > 0 && parameters.discrimination <= 10 &&
+           parameters.difficulty >= -10 && parameters.difficulty <= 10 &&
+           parameters.guessing >= 0 && parameters.guessing < 1;
+}
 
-    // Function to edit an existing question's properties
-    void editQuestion(shared_ptr<Question> question) {
-        cout << "===============================\n";
-        cout << "=== QUESTION " << question->id << " SAVED VALUES ===\n";
-        cout << "===============================\n";
-        cout << "1. Type: " << question->type << "\n";
-        cout << "2. Question: " << question->text << "\n";
 
-        // Display choices if question is an MCQ
+// Three-level table of fixed-size pages that copies share. Copying a table
+// copies one pointer per shelf of 64 directories of 64 pages, so publishing
+// a million-question store copies 16 pointers; afterwards the copy and the
+// original each copy a shelf, directory or page the first time they write
+// to it, so a write costs one page however large the table is. A node may
+// be written in place only if it carries this table's owner stamp, and
+// copying a table gives both sides new stamps. Only const access is safe
+// while another thread writes to a copy.
+template <typename Page>
+class PageTable {
+private:
+    static constexpr size_t fanout = 64;
+    static constexpr size_t shelfPages = fanout * fanout;
 
-        if (question->type == "mcq") {
-            cout << "3. Answer choices:\n";
+    struct Directory {
+        uint64_t owner = 0;                // Stamp of the table that may write this directory in place
+        uint64_t pageOwners[fanout] = {};  // Same, per page
+        shared_ptr<Page> pages[fanout];
+    };
 
-            ChoiceNode* temp = question -> choicesHead;
-            while (temp != nullptr) {
-                std::cout << temp->letter << ". " << temp->choiceText << std::endl;
-                temp = temp->next;
-            }
-            /*
-            for (const auto& choice : question->choices) {
-                cout << choice << endl;
-            }*/
-            cout << "4. Correct answer: " << question->correctAnswer << "\n";
-        } else {
-            cout << "3. Correct answer: " << question->correctAnswer << "\n";
-        }
+    struct Shelf {
+        uint64_t owner = 0;                // Stamp of the table that may write this shelf in place
+        shared_ptr<Directory> directories[fanout];
+    };
 
-        // Edit specific properties based on user input
-        int option;
-        do {
-            cout << "Type a number to edit, or type -1 to quit: ";
-            if (!(cin >> option)) { clearInput(); option = -1; }
-            clearInput();
-            switch (option) {
-                case 1:
-                    cout << "Type of question [mcq/tf/wr]: ";
-                cin >> question->type;
-                break;
-                case 2:
-                    cout << "Enter a new question: ";
-                getline(cin, question->text);
-                break;
-                case 3:
-                    if (question->type == "mcq") {
-                        //question->choices.clear();
-                        question -> resetAnswers();
-                        // Collect answer choices for the MCQ
-                        string choice;
-                        for (char option = 'A'; option <= 'Z'; ++option) {
-                            cout << "Enter choice " << option << ": ";
-                            getline(cin, choice);
-                            if (choice == "quit()") break;
-                            //question->choices.push_back(string(1, option) + ". " + choice);
-                            question -> addChoice(option, choice);
-                        }
-                    } else {
-                        cout << "Enter correct answer: ";
-                        getline(cin, question->correctAnswer);
-                    }
-                break;
-                case 4:
-                    if (question->type == "mcq") {
-                        cout << "Select correct answer: ";
-                        getline(cin, question->correctAnswer);
-                    }
-                break;
-                default:
-                    if (option != -1) cout << "[Unknown option, please try again]" << endl;
-            }
-        } while (option != -1);
+    vector<shared_ptr<Shelf>> shelves;
+    size_t pageCount = 0;
+    mutable atomic<uint64_t> owner;  // Mutable: copying from a const table still un-owns its pages
+
+    static uint64_t freshOwner() {
+        static atomic<uint64_t> next{1};
+        return next.fetch_add(1, memory_order_relaxed);
     }
 
-    // Function to delete a question by its ID
-    void deleteQuestion(int id) {
-        shared_ptr<Question> temp = head, prev = nullptr;
+    // Function to get the directory holding a page for writing, copying it and its shelf first if they may be shared
+    Directory& writeDirectory(size_t index, uint64_t stamp) {
+        shared_ptr<Shelf>& shelf = shelves[index / shelfPages];
+        if (shelf->owner != stamp) {
+            shelf = make_shared<Shelf>(*shelf);
+            shelf->owner = stamp;
+        }
+        shared_ptr<Directory>& directory = shelf->directories[index / fanout % fanout];
+        if (!directory) {
+            directory = make_shared<Directory>();
+            directory->owner = stamp;
+        } else if (directory->owner != stamp) {
+            directory = make_shared<Directory>(*directory);
+            directory->owner = stamp;
+        }
+        return *directory;
+    }
 
-        // Search for the question to delete
-        while (temp && temp->id != id) {
-            prev = temp;
-            temp = temp->next;
+public:
+    PageTable() : owner(freshOwner()) {}
+    PageTable(const PageTable& other) : shelves(other.shelves), pageCount(other.pageCount), owner(freshOwner()) {
+        other.owner.store(freshOwner(), memory_order_relaxed);
+    }
+    PageTable(PageTable&& other) noexcept
+        : shelves(std::move(other.shelves)), pageCount(other.pageCount), owner(other.owner.load(memory_order_relaxed)) {
+        other.pageCount = 0;
+        other.shelves.clear();
+        other.owner.store(freshOwner(), memory_order_relaxed);
+    }
+    PageTable& operator=(const PageTable& other) {
+        if (this != &other) {
+            shelves = other.shelves;
+            pageCount = other.pageCount;
+            owner.store(freshOwner(), memory_order_relaxed);
+            other.owner.store(freshOwner(), memory_order_relaxed);
+        }
+        return *this;
+    }
+    PageTable& operator=(PageTable&& other) noexcept {
+        if (this != &other) {
+            shelves = std::move(other.shelves);
+            pageCount = other.pageCount;
+            owner.store(other.owner.load(memory_order_relaxed), memory_order_relaxed);
+            other.pageCount = 0;
+            other.shelves.clear();
+            other.owner.store(freshOwner(), memory_order_relaxed);
         }
+        return *this;
+    }
 
-        // Handle case where question is not found
-        if (!temp) {
-            cout << "[Question not found]" << endl;
-            return;
+    size_t size() const { return pageCount; }
+
+    const Page& operator[](size_t index) const {
+        return *shelves[index / shelfPages]->directories[index / fanout % fanout]->pages[index % fanout];
+    }
+
+    // Function to get a page for writing, copying it (and the nodes above it) first if it may be shared
+    Page& write(size_t index) {
+        uint64_t stamp = owner.load(memory_order_relaxed);
+        Directory& directory = writeDirectory(index, stamp);
+        size_t at = index % fanout;
+        if (directory.pageOwners[at] != stamp) {
+            directory.pages[at] = make_shared<Page>(*directory.pages[at]);
+            directory.pageOwners[at] = stamp;
         }
+        return *directory.pages[at];
+    }
 
-        // Remove question from the linked list
-        if (!prev) {
-            head = temp->next;
-        } else {
-            prev->next = temp->next;
+    // Function to add a page at the end and return it
+    Page& append(Page page) {
+        uint64_t stamp = owner.load(memory_order_relaxed);
+        if (pageCount % shelfPages == 0) {
+            shelves.push_back(make_shared<Shelf>());
+            shelves.back()->owner = stamp;
         }
-        totalPoints -= temp->points;
-        questionCount--;
-        cout << "Question " << id << " deleted." << endl;
+        Directory& directory = writeDirectory(pageCount, stamp);
+        size_t at = pageCount++ % fanout;
+        directory.pages[at] = make_shared<Page>(std::move(page));
+        directory.pageOwners[at] = stamp;
+        return *directory.pages[at];
     }
 
-    void displayQuestion(shared_ptr<Question> question) {
-        cout << "Question " << question -> id << ": " << question -> text << endl;
-        if(question -> type == "mcq") {
-            //if mcq, must also display the answer choices
+    void clear() {
+        shelves.clear();
+        pageCount = 0;
+    }
 
-            auto temp = question -> choicesHead;
-            while (temp != nullptr) {
-                std::cout << temp->letter << ". " << temp->choiceText << std::endl;
-                temp = temp->next;
-            }
-            /*
-            for(const auto& choice : question -> choices) {
-                cout << choice << endl;
-            }*/
-        }
-        string answer;
-        cout << "Your answer: ";
-        cin >> answer;
-        // Convert input to lowercase for case-insensitive comparison
-        for (auto& c : answer) c = tolower(c);
-        question -> studentAnswer = answer;
-        clearInput();
+    void reserve(size_t pages) { shelves.reserve((pages + shelfPages - 1) / shelfPages); }
 
+    // Function to check whether two tables hold the very same page, i.e. share it
+    bool sharesPage(const PageTable& other, size_t index) const {
+        return &(*this)[index] == &other[index];
     }
+};
 
-    bool allQuestionAnswer() {
-        auto current = head;  // Start at the head of the linked list
-        while (current != nullptr) {
-            if (current->studentAnswer.empty()) {  // Check if the answer is empty
-                return false;  // Found an unanswered question, return false
-            }
-            current = current->next;  // Move to the next question in the list
-        }
-        return true;  // All questions have answers, return true
+
+// Handle of a string interned in a StringPool; 0 is always the empty string
+using StringHandle = uint32_t;
+
+
+// Bank-wide table of interned strings. Answer keys and choice text repeat
+// endlessly across a bank ("true", "b", "None of the above"), so a store
+// keeps each distinct string once and refers to it by a 4-byte handle; two
+// handles from one pool are equal exactly when their strings are. Long
+// question text is dictionary-coded against the same pool, each word (the
+// bytes between single spaces) becoming its handle as a varint.
+// Strings sit 256 to a page in a PageTable, so copies of a store share the
+// pool and interning copies at most one page. The lookup table interning
+// uses is never shared: a copy rebuilds it the first time it interns.
+// Strings are never removed; the question store rebuilds its pool when it
+// compacts.
+class StringPool {
+public:
+    static constexpr size_t packMinimum = 64;  // Text shorter than this is never coded
+
+private:
+    static constexpr int pageBits = 8;
+    static constexpr StringHandle pageMask = (1 << pageBits) - 1;
+
+    struct Page {
+        ArenaString refs[1 << pageBits];  // Handle -> its text in bytes
+        StringArena bytes;
+    };
+
+    PageTable<Page> pages;
+    StringHandle count = 1;    // Handles given out, counting the empty string's
+    size_t textBytes = 0;      // Bytes of every string held
+    vector<uint64_t> lookup;   // Open addressing: hash << 32 | handle, 0 if free; empty in a fresh copy
+
+    static uint32_t hashOf(string_view text) {
+        uint64_t value = hash<string_view>()(text);
+        return static_cast<uint32_t>(value ^ value >> 32);
     }
 
-    //return the next unanswered question
-    shared_ptr<Question> getNextUnansweredQuestion() {
-        auto temp = head;
-        while (temp) {
-            if (temp->studentAnswer.empty()){ return temp;}//if student answer for question is empty, return that
-            temp = temp->next;//if not, then go to next node
+    // Function to size the lookup table for the strings held and fill it
+    void rebuild() {
+        size_t size = 64;
+        while (size < static_cast<size_t>(count) * 2) size *= 2;
+        lookup.assign(size, 0);
+        for (StringHandle handle = 1; handle < count; handle++) {
+            uint32_t hash = hashOf(view(handle));
+            size_t i = hash & (size - 1);
+            while (lookup[i]) i = (i + 1) & (size - 1);
+            lookup[i] = static_cast<uint64_t>(hash) << 32 | handle;
         }
-        return nullptr;
     }
 
 public:
-    void auto_createQuestion(bool correct, bool answered) {
-        auto newQuestion = make_shared<Question>(1);
-        newQuestion -> type = "wr";
-        newQuestion -> text = "How long was the shortest war on record?";
-        newQuestion -> correctAnswer = "38";
-        newQuestion -> points = 100;
-        if (correct && answered) {
-            newQuestion -> studentAnswer = "38";
-        }
-        else if (answered) {
-            newQuestion -> studentAnswer = "85";
+    StringPool() = default;
+    StringPool(const StringPool& other) : pages(other.pages), count(other.count), textBytes(other.textBytes) {}
+    StringPool(StringPool&&) = default;
+    StringPool& operator=(const StringPool& other) {
+        if (this != &other) {
+            pages = other.pages;
+            count = other.count;
+            textBytes = other.textBytes;
+            lookup.clear();
         }
-        addQuestionNode(newQuestion);
-
+        return *this;
     }
-    // Public interface for creating a question based on type
-    void createQuestion() {
-        auto newQuestion = make_shared<Question>(questionCount + 1);
-        cout << "=== Question " << questionCount + 1 << " ===" << endl;
+    StringPool& operator=(StringPool&&) = default;
 
-        string type = getInput("Type of question [mcq/tf/wr]: ", "create");//"mcq", "tf", "wr"
-        if (type == "mcq") createMCQ(newQuestion);
-        else if (type == "tf") createTF(newQuestion);
-        else if (type == "wr") createWR(newQuestion);
-        addQuestionNode(newQuestion);
+    // Function to get the handle of a string, adding it if the pool does not hold it yet
+    StringHandle intern(string_view text) {
+        if (text.empty()) return 0;
+        if ((static_cast<size_t>(count) + 1) * 4 > lookup.size() * 3) rebuild();  // At most 3/4 full
+        uint32_t hash = hashOf(text);
+        size_t mask = lookup.size() - 1, i = hash & mask;
+        for (; lookup[i]; i = (i + 1) & mask) {
+            StringHandle handle = static_cast<StringHandle>(lookup[i]);
+            if ((lookup[i] >> 32) == hash && view(handle) == text) return handle;
+        }
+        StringHandle handle = count++;
+        if ((handle >> pageBits) == pages.size()) pages.append(Page());
+        Page& page = pages.write(handle >> pageBits);
+        page.refs[handle & pageMask] = page.bytes.add(text);
+        textBytes += text.size();
+        lookup[i] = static_cast<uint64_t>(hash) << 32 | handle;
+        return handle;
     }
 
-    // Public interface to edit an existing question
-    void editQuestion() {
-        int id;
-        cout << "Select a question to edit, or type quit() [" << 1 << "-" << questionCount << "]: ";
-        cin >> id;
-        auto question = getQuestionById(id);
-        if (question) editQuestion(question);
-        else cout << "[Question not found]" << endl;
+    // Function to view an interned string; valid until the next intern()
+    string_view view(StringHandle handle) const {
+        if (handle == 0) return string_view();
+        const Page& page = pages[handle >> pageBits];
+        return page.bytes.view(page.refs[handle & pageMask]);
     }
 
-    // Public interface to delete a question by its ID
-    void deleteQuestion() {
-        int id;
-        cout << "Select a question to delete [" << 1 << "-" << questionCount << "]: ";
-        cin >> id;
-        deleteQuestion(id);
+    // Function to store question text, coding it as word handles when it is
+    // long and that is shorter; returns whether stored holds the coding.
+    // text may view stored itself.
+    bool pack(string_view text, string& stored) {
+        if (text.size() >= packMinimum) {
+            thread_local string coded;
+            coded.clear();
+            for (size_t start = 0;; ) {
+                size_t end = text.find(' ', start);
+                StringHandle word = intern(text.substr(start, end - start));
+                for (; word >= 0x80; word >>= 7) coded += static_cast<char>(word | 0x80);
+                coded += static_cast<char>(word);
+                if (end == string_view::npos) break;
+                start = end + 1;
+            }
+            if (coded.size() < text.size()) {
+                stored = coded;
+                return true;
+            }
+        }
+        stored.assign(text.data(), text.size());
+        return false;
     }
 
-    // Public interface to delete all questions
-    void deleteQuestionTest() {
-        head = nullptr;
-        questionCount = 0;
+    // Function to decode text pack() coded; the result views scratch
+    string_view unpack(string_view stored, string& scratch) const {
+        scratch.clear();
+        for (size_t i = 0; i < stored.size();) {
+            if (i > 0) scratch += ' ';
+            StringHandle word = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t byte = static_cast<uint8_t>(stored[i++]);
+                word |= static_cast<StringHandle>(byte & 0x7f) << shift;
+                if (byte < 0x80) break;
+            }
+            scratch += view(word);
+        }
+        return scratch;
     }
 
+    size_t size() const { return count; }
 
-    // Displays a summary log of the quiz session
-    void displaySessionLog() {
-        cout << "=== SESSION LOG ===" << endl;
-        cout << "Total questions: " << questionCount << endl;
-        cout << fixed << setprecision(2) << "Total point values: " << totalPoints << endl;
+    void clear() {
+        pages.clear();
+        count = 1;
+        textBytes = 0;
+        lookup.clear();
     }
 
-    bool promptUserEmpty(shared_ptr<Question> question) {
+    // Function to report the heap bytes the pool holds, counting shared pages in full
+    size_t memoryBytes() const { return pages.size() * sizeof(Page) + textBytes + lookup.capacity() * sizeof(uint64_t); }
+};
 
-        do{cout << "Do you want to?\n";
-            cout << "\t1. Go to next question\n";
-            cout << "\t2. Jump to question\n";
+
+// Struct representing a question in the quiz
+// The fields grading scans (type, correct answer, points) are kept in
+// QuestionStore's columns rather than here, and text is kept in the
+// store's StringPool or, for long question text, coded against it.
+struct Question {
+    static const int maxChoices = 26;  // One choice per letter A-Z
+
+    int id;                     // Unique ID for the question
+    uint8_t choiceCount;        // Number of answer choices (for MCQs)
+    bool packedText;            // storedText holds StringPool::pack() coding rather than the text
+    StringHandle choices[maxChoices]; //answer choices for MCQs, choice i has letter 'A' + i
+    string storedText;          // Question text, see text()
+
+    // Constructor to initialize a question with a given ID and default values
+    explicit Question(int questionId) : id(questionId), choiceCount(0), packedText(false), choices() {}
+
+    // Function to add the next lettered choice; returns false once A-Z are used
+    bool addChoice(StringPool& pool, string_view text) {
+        if (choiceCount == maxChoices) return false;
+        choices[choiceCount++] = pool.intern(text);
+        return true;
+    }
+
+    char choiceLetter(int index) const {
+        return static_cast<char>('A' + index);
+    }
+
+    string_view choiceText(const StringPool& pool, int index) const {
+        return pool.view(choices[index]);
+    }
+
+    // Function to set the question text, coding it against the pool when it is long
+    void setText(StringPool& pool, string_view text) {
+        packedText = pool.pack(text, storedText);
+    }
+
+    // Function to view the question text; coded text is decoded into scratch
+    string_view text(const StringPool& pool, string& scratch) const {
+        return packedText ? pool.unpack(storedText, scratch) : string_view(storedText);
+    }
+
+    string text(const StringPool& pool) const {
+        string scratch;
+        return string(text(pool, scratch));
+    }
+
+    void printQuestion(const StringPool& pool, string_view correctAnswer) {
+        for (int i = 0; i < choiceCount; i++) {
+            std::cout << choiceLetter(i) << ". " << choiceText(pool, i) << std::endl;
+        }
+        std::cout << "Correct answer: " << correctAnswer << std::endl;
+    }
+
+    void resetAnswers() {
+        choiceCount = 0;
+    }
+};
+
+
+// Bytes a store's strings take, per field, against one std::string per
+// string (see QuestionStore::stringMemory). The pool's own cost is shared by
+// every field, so it is reported once rather than split between them.
+struct StringMemory {
+    struct Field {
+        size_t values = 0;       // Strings of this field in live questions
+        size_t plainBytes = 0;   // As one std::string each: the object plus any heap block
+        size_t storedBytes = 0;  // As handles, or as the stored (possibly coded) text
+
+        void add(size_t plain, size_t stored) {
+            values++;
+            plainBytes += plain;
+            storedBytes += stored;
+        }
+        long long saved() const { return static_cast<long long>(plainBytes) - static_cast<long long>(storedBytes); }
+    };
+
+    Field text, choices, answers;
+    size_t poolStrings = 0;  // Handles given out, the empty string's included
+    size_t poolBytes = 0;    // What the pool itself takes
+
+    long long netSaved() const { return text.saved() + choices.saved() + answers.saved() - static_cast<long long>(poolBytes); }
+};
+
+
+// Storage for the quiz's questions, indexed by slot.
+// Slots are handed out in creation order, so walking slots 0..slotCount()-1
+// visits questions in the same order the old linked list did. Ids are never
+// reused: slotById maps an id to its slot in O(1), and deleted slots are
+// tombstoned until they make up half of the store, at which point the live
+// rows are compacted and the index rebuilt.
+// Slots are grouped 16 to a page, each page keeping its columns together,
+// and pages live in PageTables; choice text, answer keys and the words of
+// long question text are interned in a StringPool that is paged the same way. Copying a store is therefore
+// cheap and shares every page, and writing a slot afterwards copies only its
+// page, which is what lets Quiz::publish hand out a new bank version per
+// edit. Writing through the non-const accessors counts as writing, so code
+// that only reads should go through a const reference.
+// Each page also caches the compiled keys of its written-response slots;
+// any write to the page drops them and lists the page for the next
+// compileKeys(), which visits only listed pages.
+class WrKey;
+
+class QuestionStore {
+public:
+    static constexpr int pageBits = 4;
+    static constexpr int pageSize = 1 << pageBits;  // Slots per page
+
+private:
+    static constexpr int idPageBits = 10;  // Ids per page of the id index: 1024
+
+    struct Page {
+        vector<Question> rows;            // Cold per-question data (text, choices)
+        QuestionKind types[pageSize] = {};  // Column: type of each slot
+        StringHandle answerKeys[pageSize] = {}; // Column: answer key of each slot, in pool
+        FixedPoints pointValues[pageSize] = {}; // Column: points of each slot
+        ItemParameters calibration[pageSize];   // Column: IRT parameters of each slot
+        char live[pageSize] = {};         // Column: 0 once a slot has been deleted
+        shared_ptr<const WrKey> wrKeys[pageSize]; // Column: compiled key of each wr slot, set by compileKeys()
+        bool keysCompiled = false;        // wrKeys matches the page; cleared by every write
+    };
+
+    struct IdPage {
+        int slots[1 << idPageBits];
+        IdPage() { fill(begin(slots), end(slots), -1); }
+    };
+
+    PageTable<Page> pages;
+    vector<size_t> uncompiled;      // Pages with keysCompiled unset, each listed once
+    PageTable<IdPage> slotById;     // id -> slot, -1 if the id has no question
+    StringPool pool;                // Strings the pages refer to by handle
+    int rowCount;                   // Slots handed out, live or not
+    int liveCount;                  // Number of questions not deleted
+    int nextQuestionId;             // Id handed to the next new question
+
+    static int offset(int slot) { return slot & (pageSize - 1); }
+    const Page& page(int slot) const { return pages[slot >> pageBits]; }
+    Page& writePage(int slot) {
+        Page& target = pages.write(slot >> pageBits);
+        if (target.keysCompiled) {  // The write may change a type or an answer key
+            target.keysCompiled = false;
+            uncompiled.push_back(slot >> pageBits);
+        }
+        return target;
+    }
+
+    void setSlotOf(int id, int slot) {
+        while ((static_cast<size_t>(id) >> idPageBits) >= slotById.size()) slotById.append(IdPage());
+        slotById.write(id >> idPageBits).slots[id & ((1 << idPageBits) - 1)] = slot;
+    }
+
+    // Function to append a blank slot for an id without touching the id index
+    int appendSlot(int id) {
+        if (rowCount % pageSize == 0) {
+            Page fresh;
+            fresh.rows.reserve(pageSize);
+            pages.append(std::move(fresh));
+            uncompiled.push_back(pages.size() - 1);
+        }
+        int slot = rowCount++;
+        Page& target = writePage(slot);
+        if (target.rows.capacity() < pageSize) target.rows.reserve(pageSize);  // Copied pages come without spare room
+        target.rows.emplace_back(id);
+        target.live[offset(slot)] = 1;
+        return slot;
+    }
+
+    // Function to squeeze out deleted slots and strings nothing uses, keeping creation order
+    void compact() {
+        QuestionStore packed;
+        packed.nextQuestionId = nextQuestionId;
+        string scratch;
+        for (int slot = nextLive(0); slot != -1; slot = nextLive(slot + 1)) {
+            const Page& from = page(slot);
+            const Question& question = from.rows[offset(slot)];
+            int to = packed.appendSlot(question.id);
+            Page& into = packed.writePage(to);
+            Question& copy = into.rows[offset(to)];
+            copy.setText(packed.pool, question.text(pool, scratch));
+            for (int i = 0; i < question.choiceCount; i++) copy.addChoice(packed.pool, question.choiceText(pool, i));
+            into.types[offset(to)] = from.types[offset(slot)];
+            into.answerKeys[offset(to)] = packed.pool.intern(pool.view(from.answerKeys[offset(slot)]));
+            into.pointValues[offset(to)] = from.pointValues[offset(slot)];
+            into.calibration[offset(to)] = from.calibration[offset(slot)];
+        }
+        packed.liveCount = packed.rowCount;
+        packed.slotById = std::move(slotById);
+        pages = std::move(packed.pages);
+        uncompiled = std::move(packed.uncompiled);
+        pool = std::move(packed.pool);
+        rowCount = packed.rowCount;
+        for (int slot = 0; slot < rowCount; slot++) setSlotOf(page(slot).rows[offset(slot)].id, slot);
+    }
+
+public:
+    QuestionStore() : rowCount(0), liveCount(0), nextQuestionId(1) {}
+
+    // Function to append a blank question and return its slot
+    int emplace(int id) {
+        if (id >= nextQuestionId) nextQuestionId = id + 1;
+        int slot = appendSlot(id);
+        setSlotOf(id, slot);
+        liveCount++;
+        return slot;
+    }
+
+    // Function to append a blank question with the next unused id
+    int emplace() {
+        return emplace(nextQuestionId);
+    }
+
+    // Function to delete the question in a slot; its id is never handed out again
+    void erase(int slot) {
+        Page& target = writePage(slot);
+        target.rows[offset(slot)].resetAnswers();
+        target.live[offset(slot)] = 0;
+        setSlotOf(target.rows[offset(slot)].id, -1);
+        liveCount--;
+        size_t dead = rowCount - liveCount;
+        if (dead >= 64 && dead * 2 > static_cast<size_t>(rowCount)) compact();
+    }
+
+    // Function to delete every question
+    void clear() {
+        pages.clear();
+        uncompiled.clear();
+        slotById.clear();
+        pool.clear();
+        rowCount = 0;
+        liveCount = 0;
+        nextQuestionId = 1;
+    }
+
+    // Function to find the slot holding an id, -1 if not found
+    int slotOf(int id) const {
+        if (id < 0 || (static_cast<size_t>(id) >> idPageBits) >= slotById.size()) return -1;
+        return slotById[id >> idPageBits].slots[id & ((1 << idPageBits) - 1)];
+    }
+
+    // Function to find the first live slot at or after a given slot, -1 if none
+    int nextLive(int slot) const {
+        for (; slot < rowCount; ++slot) {
+            if (page(slot).live[offset(slot)]) return slot;
+        }
+        return -1;
+    }
+
+    int nextId() const { return nextQuestionId; }
+    // Function to make sure ids below nextId are never handed out (e.g. after loading a bank)
+    void reserveIds(int nextId) { nextQuestionId = max(nextQuestionId, nextId); }
+    void reserve(size_t count) { pages.reserve((count + pageSize - 1) / pageSize); }
+    // Function to drop deleted slots and unused strings right away
+    void shrink() { compact(); }
+    int size() const { return liveCount; }
+    bool empty() const { return liveCount == 0; }
+    int slotCount() const { return rowCount; }
+    bool isLive(int slot) const { return page(slot).live[offset(slot)] != 0; }
+
+    Question& row(int slot) { return writePage(slot).rows[offset(slot)]; }
+    const Question& row(int slot) const { return page(slot).rows[offset(slot)]; }
+    // The pool holding choice text, answer keys and the words of long question text
+    StringPool& strings() { return pool; }
+    const StringPool& strings() const { return pool; }
+    QuestionKind& type(int slot) { return writePage(slot).types[offset(slot)]; }
+    QuestionKind type(int slot) const { return page(slot).types[offset(slot)]; }
+    StringHandle answerKey(int slot) const { return page(slot).answerKeys[offset(slot)]; }
+    string_view correctAnswer(int slot) const { return pool.view(answerKey(slot)); }
+
+    // Function to give the compiled key of a written-response slot, or null if the slot's page
+    // changed since compileKeys() last ran
+    const WrKey* compiledKey(int slot) const {
+        const Page& at = page(slot);
+        return at.keysCompiled ? at.wrKeys[offset(slot)].get() : nullptr;
+    }
+
+    // Function to compile the written-response keys of every page changed since the last call,
+    // so grading never rebuilds a key per answer. Costs the changed pages, not the store.
+    // Slots with the same answer key share one key.
+    template <typename Compile>
+    void compileKeys(Compile compile) {
+        unordered_map<StringHandle, shared_ptr<const WrKey>> byHandle;
+        for (size_t index : uncompiled) {
+            Page& target = pages.write(index);  // Not writePage: compiling is not an edit
+            for (size_t at = 0; at < target.rows.size(); at++) {
+                target.wrKeys[at].reset();
+                if (!target.live[at] || target.types[at] != QuestionKind::wr) continue;
+                auto found = byHandle.find(target.answerKeys[at]);
+                if (found == byHandle.end()) {
+                    found = byHandle.emplace(target.answerKeys[at], compile(pool.view(target.answerKeys[at]))).first;
+                }
+                target.wrKeys[at] = found->second;
+            }
+            target.keysCompiled = true;
+        }
+        uncompiled.clear();
+    }
+
+    void setCorrectAnswer(int slot, string_view key) {
+        StringHandle handle = pool.intern(key);
+        writePage(slot).answerKeys[offset(slot)] = handle;
+    }
+    FixedPoints& points(int slot) { return writePage(slot).pointValues[offset(slot)]; }
+    FixedPoints points(int slot) const { return page(slot).pointValues[offset(slot)]; }
+    ItemParameters& parameters(int slot) { return writePage(slot).calibration[offset(slot)]; }
+    const ItemParameters& parameters(int slot) const { return page(slot).calibration[offset(slot)]; }
+
+    // Function to check whether a slot's question is stored once for both this store and another
+    bool sharesSlot(const QuestionStore& other, int slot) const {
+        return slot < other.rowCount && pages.sharesPage(other.pages, slot >> pageBits);
+    }
+
+    // Function to estimate the heap bytes the store holds, counting shared pages in full
+    size_t memoryBytes() const {
+        auto heap = [](const string& text) { return text.capacity() > 15 ? text.capacity() + 1 : 0; };
+        size_t bytes = pages.size() * sizeof(Page) + slotById.size() * sizeof(IdPage) + pool.memoryBytes();
+        for (size_t index = 0; index < pages.size(); index++) {
+            const Page& at = pages[index];
+            bytes += at.rows.capacity() * sizeof(Question);
+            for (const Question& question : at.rows) bytes += heap(question.storedText);
+        }
+        return bytes;
+    }
+
+    // Function to account for the bytes live questions' strings take as the
+    // store keeps them, next to what one std::string per string would take
+    StringMemory stringMemory() const {
+        auto plain = [](size_t length) { return sizeof(string) + (length > 15 ? length + 1 : 0); };
+        StringMemory memory;
+        string scratch;
+        for (int slot = nextLive(0); slot != -1; slot = nextLive(slot + 1)) {
+            const Question& question = row(slot);
+            memory.text.add(plain(question.text(pool, scratch).size()), plain(question.storedText.size()));
+            memory.answers.add(plain(correctAnswer(slot).size()), sizeof(StringHandle));
+            for (int i = 0; i < question.choiceCount; i++) {
+                memory.choices.add(plain(question.choiceText(pool, i).size()), sizeof(StringHandle));
+            }
+        }
+        memory.poolStrings = pool.size();
+        memory.poolBytes = pool.memoryBytes();
+        return memory;
+    }
+};
+
+
+// Questions frozen for taking: a copy of a quiz's store that any number of
+// concurrent attempts share through a shared_ptr. Nothing in it changes once
+// published, so readers need no locking. The copy shares its pages with the
+// quiz and with earlier versions, and may still hold deleted slots.
+struct QuestionBank {
+    QuestionStore questions;   // Skip deleted slots with nextLive/isLive
+    double totalPoints = 0.0;  // Sum of all points for all questions
+};
+
+
+// Hands the newest published bank to readers without locks. A reader pins
+// the current version by copying its shared_ptr and then reads it with no
+// further synchronization for as long as it holds it; publishing swaps one
+// pointer, so new readers see the new version while attempts already under
+// way keep theirs, and a version's memory goes back (apart from the pages
+// later versions share) when its last reader lets go of it.
+// The swapped pointer points at a small node holding the shared_ptr. A pin
+// announces the node it is about to copy from in a hazard slot, and the
+// publisher frees a retired node only once no hazard slot names it.
+class BankPublisher {
+private:
+    struct Version {
+        shared_ptr<const QuestionBank> bank;
+        uint64_t number;
+    };
+
+    struct Hazard {
+        atomic<Version*> pointer{nullptr};  // Node being copied from, null when idle
+        atomic<bool> claimed{false};        // Set while a pin uses this slot
+        Hazard* next = nullptr;
+    };
+
+    atomic<Version*> current;
+    atomic<Hazard*> hazards{nullptr};  // Grows to the most pins ever running at once; never shrinks
+    mutex publishing;                  // Publishers take turns; readers never take it
+    atomic<uint64_t> latest{1};        // Number of the current version, readable without a node
+    vector<Version*> retired;          // Swapped-out nodes not yet freed
+
+    Hazard& claimHazard() {
+        for (Hazard* hazard = hazards.load(memory_order_acquire); hazard; hazard = hazard->next) {
+            bool idle = false;
+            if (!hazard->claimed.load(memory_order_relaxed)
+                && hazard->claimed.compare_exchange_strong(idle, true, memory_order_acquire)) {
+                return *hazard;
+            }
+        }
+        Hazard* hazard = new Hazard;
+        hazard->claimed.store(true, memory_order_relaxed);
+        Hazard* head = hazards.load(memory_order_relaxed);
+        do {
+            hazard->next = head;
+        } while (!hazards.compare_exchange_weak(head, hazard, memory_order_release, memory_order_relaxed));
+        return *hazard;
+    }
+
+    // Function to free the retired nodes no pin is reading; called with publishing held
+    void reclaim() {
+        vector<Version*> reading;
+        for (Hazard* hazard = hazards.load(); hazard; hazard = hazard->next) {
+            if (Version* version = hazard->pointer.load()) reading.push_back(version);
+        }
+        auto freed = [&reading](Version* version) {
+            if (find(reading.begin(), reading.end(), version) != reading.end()) return false;
+            delete version;
+            return true;
+        };
+        retired.erase(remove_if(retired.begin(), retired.end(), freed), retired.end());
+    }
+
+public:
+    explicit BankPublisher(shared_ptr<const QuestionBank> bank) : current(new Version{std::move(bank), 1}) {}
+
+    ~BankPublisher() {
+        delete current.load();
+        for (Version* version : retired) delete version;
+        for (Hazard* hazard = hazards.load(); hazard;) {
+            Hazard* next = hazard->next;
+            delete hazard;
+            hazard = next;
+        }
+    }
+
+    BankPublisher(const BankPublisher&) = delete;
+    BankPublisher& operator=(const BankPublisher&) = delete;
+
+    // Function to get the current version; it stays valid and unchanged for as long as it is held
+    shared_ptr<const QuestionBank> pin() {
+        Hazard& hazard = claimHazard();
+        Version* version = current.load();
+        while (true) {
+            hazard.pointer.store(version);
+            Version* latest = current.load();  // Still current after announcing, so it cannot be freed yet
+            if (latest == version) break;
+            version = latest;
+        }
+        shared_ptr<const QuestionBank> bank = version->bank;
+        hazard.pointer.store(nullptr, memory_order_release);
+        hazard.claimed.store(false, memory_order_release);
+        return bank;
+    }
+
+    // Function to make a bank the current version and return its version number
+    uint64_t publish(shared_ptr<const QuestionBank> bank) {
+        lock_guard<mutex> guard(publishing);
+        Version* old = current.load(memory_order_relaxed);
+        Version* next = new Version{std::move(bank), old->number + 1};
+        current.store(next);
+        latest.store(next->number);
+        retired.push_back(old);
+        reclaim();
+        return next->number;
+    }
+
+    // Function to get the current version number; a publish may retire the node at any time,
+    // so this never touches it
+    uint64_t version() const { return latest.load(); }
+};
+
+
+// One taker's answers to a question store, kept apart from the questions so
+// the same store can back many attempts. Answers are looked up by question
+// slot but stored in a small open-addressing table keyed by question id (ids
+// survive compaction, slots do not), with the text in a per-sheet arena, so a
+// sheet's memory grows with the number of answers rather than the bank size.
+class AnswerSheet {
+private:
+    struct Entry {
+        int32_t id;          // Question id, -1 for an empty table entry
+        ArenaString answer;  // Answer text; length 0 once cleared
+    };
+
+    StringArena text;        // Text of every answer given on this sheet
+    vector<Entry> table;     // Power-of-two sized, at most half full
+    int entries = 0;         // Table entries in use
+    int answered = 0;        // Entries holding a non-empty answer
+    int cursor = 0;          // No unanswered live slot before this one
+
+    static size_t hashId(int id) { return static_cast<uint32_t>(id) * 0x9E3779B1u; }
+
+    // Function to find the table entry of an id, -1 if the id has none
+    long find(int id) const {
+        if (table.empty()) return -1;
+        size_t mask = table.size() - 1;
+        for (size_t i = hashId(id) & mask;; i = (i + 1) & mask) {
+            if (table[i].id == id) return static_cast<long>(i);
+            if (table[i].id == -1) return -1;
+        }
+    }
+
+    Entry& insert(int id) {
+        if ((entries + 1) * 2 > static_cast<int>(table.size())) {
+            vector<Entry> old(max<size_t>(16, table.size() * 2), Entry{-1, {0, 0}});
+            old.swap(table);
+            entries = 0;
+            for (const Entry& entry : old) if (entry.id != -1) insert(entry.id).answer = entry.answer;
+        }
+        size_t mask = table.size() - 1;
+        size_t i = hashId(id) & mask;
+        while (table[i].id != id && table[i].id != -1) i = (i + 1) & mask;
+        if (table[i].id == -1) {
+            table[i].id = id;
+            table[i].answer = ArenaString{0, 0};
+            entries++;
+        }
+        return table[i];
+    }
+
+public:
+    FixedPoints score = 0;   // Points earned, as of the last grading
+
+    // Function to record (or, with an empty answer, clear) the answer to a slot's question
+    void setAnswer(const QuestionStore& questions, int slot, string_view answer) {
+        METRIC_COUNT(answersRecorded);
+        Entry& entry = insert(questions.row(slot).id);
+        answered += (answer.empty() ? 0 : 1) - (entry.answer.length == 0 ? 0 : 1);
+        entry.answer = answer.empty() ? ArenaString{0, 0} : text.add(answer);
+        if (answer.empty()) cursor = min(cursor, slot);
+    }
+
+    // Function to view the answer to a slot's question, empty if it has none
+    string_view answer(const QuestionStore& questions, int slot) const {
+        long entry = find(questions.row(slot).id);
+        return entry == -1 ? string_view() : text.view(table[entry].answer);
+    }
+
+    // Function to drop the answer to a question that is being deleted
+    void forget(int id) {
+        long entry = find(id);
+        if (entry == -1 || table[entry].answer.length == 0) return;
+        table[entry].answer = ArenaString{0, 0};
+        answered--;
+        cursor = 0;  // Deleting may compact the store and move later slots down
+    }
+
+    int unansweredCount(const QuestionStore& questions) const { return questions.size() - answered; }
+
+    // Function to find the first live slot without an answer, -1 if there is none.
+    // The cursor only moves back when an answer is cleared, so walking forward
+    // through an exam is amortized O(1) per question.
+    int firstUnanswered(const QuestionStore& questions) {
+        if (answered >= questions.size()) return -1;
+        for (; cursor < questions.slotCount(); ++cursor) {
+            if (questions.isLive(cursor) && answer(questions, cursor).empty()) return cursor;
+        }
+        return -1;
+    }
+
+    void clear() {
+        text.clear();
+        table.clear();
+        entries = answered = cursor = 0;
+        score = 0;
+    }
+
+    // Function to report the heap bytes this sheet holds
+    size_t memoryBytes() const { return text.size() + table.capacity() * sizeof(Entry); }
+};
+
+
+// Inverted index over question and choice text, kept up to date as questions
+// are created, edited and deleted. Each term's postings are sorted by
+// question id, in blocks of about 32 that keep their first id, where they
+// start, how many postings they hold and a bound on what those can score.
+// Within a block postings are delta-coded: a posting is a varint of the gap
+// from the previous id (0 for the first), shifted left 4 bits past an
+// in-question weight (question text counts twice as much as choice text), so
+// a common word costs a byte or two per question it appears in. New
+// questions have the highest ids and append; a word new to an older question
+// re-codes just its block, which splits once it doubles. Unindexing a
+// question zeroes its posting's weight in place (the varint keeps its
+// length), re-indexing revives it, and a list is re-coded without its dead
+// postings once half of it is dead. Queries are whitespace-separated words,
+// "prefix*" and "quoted phrases"; a question has to match all of them, and
+// results are ranked by BM25 (a prefix scores as its best-matching word).
+// Searches drive from the rarest word and bound each of its
+// blocks by the other words' blocks over the same ids, walk the blocks best
+// bound first so the top results fill early, skip blocks (and whole words of
+// a prefix) that cannot reach them, and jump through the other words'
+// blocks instead of decoding them. Like the store, the index serves one
+// caller at a time.
+class TextIndex {
+private:
+    static constexpr int idBits = 28;              // Ids must fit a 32-bit varint with the weight below them
+    static constexpr uint32_t weightMask = 0xF;    // Weight 0 once unindexed
+    static constexpr size_t maxTokenLength = 64;   // Longer words are cut, in text and queries alike
+    static constexpr size_t maxPrefixTerms = 256;  // A prefix expands to at most this many of its commonest terms
+    static constexpr size_t blockSize = 32;        // Postings per block as a list grows; up to twice that after inserts
+    static constexpr uint32_t noId = UINT32_MAX;   // Cursor id once past the last posting
+
+    struct Block {
+        uint32_t firstId;  // Id of the block's first posting
+        uint32_t offset;   // Where that posting's varint starts
+        uint32_t bound;    // What its postings can score; see widen()
+        uint8_t count;     // Postings in the block
+    };
+
+    struct Term {
+        vector<uint8_t> postings;  // Varint of (id - previous id in the block) << 4 | weight each, ascending by id
+        vector<Block> blocks;
+        uint32_t count = 0;        // Postings, dead ones included
+        uint32_t dead = 0;         // Postings with weight 0
+        uint32_t lastId = 0;       // Id of the last posting
+        uint32_t bound = 0xFFFFFF; // Highest weight and fewest tokens of all its postings, packed like a block's
+    };
+
+    // Position in one term's postings; seek() moves it to the first posting at or after an id
+    struct Cursor {
+        const Term* term = nullptr;
+        size_t block = 0;               // Block holding the current posting
+        size_t left = 0;                // Postings of that block after the current one
+        const uint8_t* start = nullptr; // Varint of the current posting
+        const uint8_t* next = nullptr;  // Varint of the one after it
+        uint32_t before = 0;            // Every posting behind the cursor has an id at or below this
+        uint32_t id = noId;             // Current posting, noId past the end
+        uint32_t weight = 0;
+    };
+
+    // Postings of one run of new questions, built apart from the index so runs can be built in parallel
+    struct Partial {
+        StringArena text;                        // Words of the run
+        vector<ArenaString> words;               // Local term -> its word
+        vector<uint64_t> table;                  // Open addressing like the index's: hash << 32 | (local term + 1)
+        vector<uint32_t> postings;               // Id << 4 | weight, grouped by local term and ascending by id
+        vector<uint32_t> firstOf;                // Local term -> its first posting, plus the end
+        vector<uint32_t> global;                 // Local term -> index term, once registered
+        vector<uint32_t> byOwner;                // Local terms grouped by the merging task that owns them
+        vector<uint32_t> ownerStarts;            // Where each task's group starts in byOwner, plus the end
+        uint64_t tokens = 0;
+
+        // Function to find a word's local term, adding the word if it is new to the run
+        long termOf(string_view word) {
+            if ((words.size() + 1) * 2 > table.size()) {
+                vector<uint64_t> grown(max<size_t>(4096, table.size() * 2), 0);
+                for (uint64_t value : table) {
+                    if (value == 0) continue;
+                    size_t i = (value >> 32) & (grown.size() - 1);
+                    while (grown[i] != 0) i = (i + 1) & (grown.size() - 1);
+                    grown[i] = value;
+                }
+                table.swap(grown);
+            }
+            uint64_t hash = hashTerm(word);
+            size_t mask = table.size() - 1, i = hash & mask;
+            for (; table[i] != 0; i = (i + 1) & mask) {
+                uint32_t local = static_cast<uint32_t>(table[i]) - 1;
+                if ((table[i] >> 32) == hash && text.view(words[local]) == word) return local;
+            }
+            table[i] = hash << 32 | (words.size() + 1);
+            words.push_back(text.add(word));
+            return static_cast<long>(words.size() - 1);
+        }
+    };
+
+    StringArena termText;                  // Text of every term
+    vector<ArenaString> termRefs;          // Term id -> its text
+    vector<uint64_t> termTable;            // Open addressing: hash << 32 | (term id + 1), 0 when empty
+    vector<Term> terms;
+    mutable vector<uint32_t> byText;       // Term ids in text order, for prefix search; new terms are merged in by the next search
+    vector<uint16_t> lengths;              // By id: tokens + 1, 0 if the id is not indexed
+    size_t documents = 0;
+    uint64_t totalLength = 0;
+
+    // A block's bound is highest weight << 28 | step << 24 | fewest tokens << 12 | fewest tokens among
+    // postings weighing more than step (token counts capped at 4095). A posting weighing up to step then
+    // scores at most BM25(step, fewest tokens), and a heavier one BM25(highest weight, fewest above step):
+    // heavy weights mostly come from long questions, so this is much tighter than the one pair.
+    static constexpr uint32_t emptyBound = 0xFFFFFF;
+
+    // Function to widen a bound over one more posting
+    uint32_t widen(uint32_t bound, uint32_t id, uint32_t weight) const {
+        if (weight == 0) return bound;
+        uint32_t length = min<uint32_t>(lengths[id] - 1u, 0xFFF);
+        uint32_t step = bound >> 24 & 0xF, shortest = min(bound >> 12 & 0xFFF, length), above = bound & 0xFFF;
+        if (weight > step) above = min(above, length);
+        return max(bound >> 28, weight) << 28 | step << 24 | shortest << 12 | above;
+    }
+
+    // Function to pick the step that gives a block its lowest bound at the current average length
+    void tighten(Term& term, size_t block) {
+        uint32_t shortestAt[weightMask + 1];
+        fill(begin(shortestAt), end(shortestAt), 0xFFFu);
+        Cursor at;
+        at.term = &term;
+        openBlock(at, block);
+        for (size_t left = term.blocks[block].count; left > 0; left--, advance(at)) {
+            if (at.weight != 0) shortestAt[at.weight] = min(shortestAt[at.weight], min<uint32_t>(lengths[at.id] - 1u, 0xFFF));
+        }
+        uint32_t bound = term.blocks[block].bound, top = bound >> 28, shortest = bound >> 12 & 0xFFF;
+        Bm25 bm25(*this);
+        uint32_t best = 0, bestAbove = shortest, above = 0xFFF;
+        float lowest = bm25(1, top, shortest);
+        for (uint32_t step = top; step > 0; above = min(above, shortestAt[step--])) {
+            float score = max(bm25(1, step, shortest), bm25(1, top, above));
+            if (score < lowest) {
+                lowest = score;
+                best = step;
+                bestAbove = above;
+            }
+        }
+        term.blocks[block].bound = top << 28 | best << 24 | shortest << 12 | bestAbove;
+    }
+
+    static uint32_t readVarint(const uint8_t*& at) {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *at++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (byte < 0x80) return value;
+        }
+    }
+
+    static void writeVarint(vector<uint8_t>& bytes, uint32_t value) {
+        for (; value >= 0x80; value >>= 7) bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Function to add a posting after the last one of a term
+    void append(Term& term, uint32_t id, uint32_t weight) {
+        bool opens = term.blocks.empty() || term.blocks.back().count >= blockSize;
+        if (opens) term.blocks.push_back({id, static_cast<uint32_t>(term.postings.size()), emptyBound, 0});
+        Block& block = term.blocks.back();
+        block.bound = widen(block.bound, id, weight);
+        term.bound = widen(term.bound, id, weight);
+        vector<uint8_t>& bytes = term.postings;
+        if (bytes.capacity() - bytes.size() < 5) bytes.reserve(bytes.size() + bytes.size() / 4 + 8);  // Grow by a quarter, not double
+        writeVarint(bytes, (opens ? 0 : id - term.lastId) << 4 | weight);
+        term.lastId = id;
+        term.count++;
+        if (weight == 0) term.dead++;
+        if (++block.count == blockSize) tighten(term, term.blocks.size() - 1);
+    }
+
+    // Function to decode one block's postings onto out as id << 4 | weight
+    static void decodeBlock(const Term& term, size_t block, vector<uint32_t>& out) {
+        const uint8_t* at = term.postings.data() + term.blocks[block].offset;
+        uint32_t id = term.blocks[block].firstId;
+        for (uint32_t i = 0; i < term.blocks[block].count; i++) {
+            uint32_t value = readVarint(at);
+            id += value >> 4;
+            out.push_back(id << 4 | (value & weightMask));
+        }
+    }
+
+    // Function to decode a term's postings as id << 4 | weight
+    static void decode(const Term& term, vector<uint32_t>& out) {
+        out.clear();
+        for (size_t block = 0; block < term.blocks.size(); block++) decodeBlock(term, block, out);
+    }
+
+    // Function to put a posting inside a term's list, before its last one. Only the block it falls in is
+    // re-coded and spliced in; a block that reaches twice blockSize splits in two.
+    void insert(Term& term, uint32_t id, uint32_t weight) {
+        static thread_local vector<uint32_t> postings;
+        static thread_local vector<uint8_t> bytes;
+        vector<Block>& blocks = term.blocks;
+        size_t block = upper_bound(blocks.begin(), blocks.end(), id, [](uint32_t id, const Block& block) { return id < block.firstId; })
+                     - blocks.begin();
+        block = block == 0 ? 0 : block - 1;
+        postings.clear();
+        decodeBlock(term, block, postings);
+        postings.insert(lower_bound(postings.begin(), postings.end(), id << 4), id << 4 | weight);
+        size_t pieces = postings.size() >= 2 * blockSize ? 2 : 1;
+        size_t begin = blocks[block].offset;
+        size_t end = block + 1 < blocks.size() ? blocks[block + 1].offset : term.postings.size();
+        bytes.clear();
+        Block made[2];
+        for (size_t piece = 0, first = 0; piece < pieces; piece++) {
+            size_t last = piece + 1 == pieces ? postings.size() : postings.size() / 2;
+            made[piece] = {postings[first] >> 4, static_cast<uint32_t>(begin + bytes.size()), emptyBound, static_cast<uint8_t>(last - first)};
+            for (size_t i = first; i < last; i++) {
+                writeVarint(bytes, (i == first ? 0 : (postings[i] >> 4) - (postings[i - 1] >> 4)) << 4 | (postings[i] & weightMask));
+                made[piece].bound = widen(made[piece].bound, postings[i] >> 4, postings[i] & weightMask);
+            }
+            first = last;
+        }
+        // Splice the block's new bytes over its old ones and move the later blocks' offsets with them
+        ptrdiff_t grown = static_cast<ptrdiff_t>(bytes.size()) - static_cast<ptrdiff_t>(end - begin);
+        if (grown > 0) term.postings.insert(term.postings.begin() + end, grown, 0);
+        else term.postings.erase(term.postings.begin() + end + grown, term.postings.begin() + end);
+        copy(bytes.begin(), bytes.end(), term.postings.begin() + begin);
+        for (size_t later = block + 1; later < blocks.size(); later++) blocks[later].offset += static_cast<uint32_t>(grown);
+        blocks[block] = made[0];
+        if (pieces == 2) blocks.insert(blocks.begin() + block + 1, made[1]);
+        for (size_t piece = 0; piece < pieces; piece++) tighten(term, block + piece);
+        term.bound = widen(term.bound, id, weight);
+        term.count++;
+    }
+
+    // Function to code a term's postings afresh from id << 4 | weight values in id order
+    void encode(Term& term, const vector<uint32_t>& postings) {
+        term.postings.clear();
+        term.blocks.clear();
+        term.count = term.dead = term.lastId = 0;
+        term.bound = emptyBound;
+        for (uint32_t posting : postings) append(term, posting >> 4, posting & weightMask);
+        term.postings.shrink_to_fit();
+        term.blocks.shrink_to_fit();
+    }
+
+    static Cursor cursor(const Term& term) {
+        Cursor at;
+        at.term = &term;
+        if (!term.blocks.empty()) openBlock(at, 0);
+        return at;
+    }
+
+    static void openBlock(Cursor& at, size_t block) {
+        const Term& term = *at.term;
+        at.block = block;
+        at.left = term.blocks[block].count - 1u;
+        at.start = term.postings.data() + term.blocks[block].offset;
+        at.next = at.start;
+        at.weight = readVarint(at.next) & weightMask;
+        at.id = term.blocks[block].firstId;
+        at.before = block == 0 ? 0 : at.id - 1;
+    }
+
+    static void advance(Cursor& at) {
+        at.before = at.id;
+        if (at.left == 0) {
+            if (at.block + 1 < at.term->blocks.size()) openBlock(at, at.block + 1);
+            else at.id = noId;
+            return;
+        }
+        at.start = at.next;
+        uint32_t value = readVarint(at.next);
+        at.id += value >> 4;
+        at.weight = value & weightMask;
+        at.left--;
+    }
+
+    // Function to move a cursor into the block that would hold an id, backwards too, without decoding it
+    static void locate(Cursor& at, uint32_t id) {
+        const vector<Block>& blocks = at.term->blocks;
+        if (id <= at.before || (at.block + 1 < blocks.size() && blocks[at.block + 1].firstId <= id)) {
+            size_t block = upper_bound(blocks.begin(), blocks.end(), id, [](uint32_t id, const Block& block) { return id < block.firstId; })
+                         - blocks.begin();
+            openBlock(at, block == 0 ? 0 : block - 1);
+        }
+    }
+
+    // Function to move a cursor to the first posting whose id is not below id, backwards too;
+    // blocks that cannot hold it are jumped over without being decoded
+    static void seek(Cursor& at, uint32_t id) {
+        if (at.term->blocks.empty()) return;
+        locate(at, id);
+        while (at.id < id) advance(at);
+    }
+
+    // Function to rewrite the weight of the posting a cursor is on; the varint keeps its length
+    void setWeight(Term& term, const Cursor& at, uint32_t weight) {
+        uint8_t& first = term.postings[at.start - term.postings.data()];
+        first = static_cast<uint8_t>((first & ~weightMask) | weight);
+        term.blocks[at.block].bound = widen(term.blocks[at.block].bound, at.id, weight);
+        term.bound = widen(term.bound, at.id, weight);
+    }
+
+    static uint32_t hashTerm(string_view text) {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (char c : text) hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+        return static_cast<uint32_t>(hash >> 32);
+    }
+
+    friend class MinHasher;  // Reads text the same way for near-duplicate signatures
+
+    // Function to split text into lowercase words; bytes outside ASCII count as letters so UTF-8 words stay whole
+    template <typename Visit>
+    static void tokenize(string_view text, Visit visit) {
+        char word[maxTokenLength];
+        size_t length = 0;
+        for (size_t i = 0; i <= text.size(); i++) {
+            unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+            bool letter = (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+            if (letter || (c >= '0' && c <= '9') || c >= 0x80) {
+                if (length < maxTokenLength) word[length++] = static_cast<char>(letter ? c | 0x20 : c);
+            } else if (length > 0) {
+                visit(string_view(word, length));
+                length = 0;
+            }
+        }
+    }
+
+    // Function to find a term id, or add the term when create is set; -1 if absent
+    long termOf(string_view text, bool create) {
+        if (create && (terms.size() + 1) * 2 > termTable.size()) {
+            vector<uint64_t> table(max<size_t>(1024, termTable.size() * 2), 0);
+            for (uint32_t term = 0; term < terms.size(); term++) {
+                uint64_t hash = hashTerm(termText.view(termRefs[term]));
+                size_t i = hash & (table.size() - 1);
+                while (table[i] != 0) i = (i + 1) & (table.size() - 1);
+                table[i] = hash << 32 | (term + 1);
+            }
+            termTable.swap(table);
+        }
+        if (termTable.empty()) return -1;
+        uint64_t hash = hashTerm(text);
+        size_t mask = termTable.size() - 1, i = hash & mask;
+        for (; termTable[i] != 0; i = (i + 1) & mask) {
+            uint32_t term = static_cast<uint32_t>(termTable[i]) - 1;
+            if ((termTable[i] >> 32) == hash && termText.view(termRefs[term]) == text) return term;
+        }
+        if (!create) return -1;
+        uint32_t term = static_cast<uint32_t>(terms.size());
+        termTable[i] = hash << 32 | (term + 1);
+        termRefs.push_back(termText.add(text));
+        terms.emplace_back();
+        return term;
+    }
+
+    long termOf(string_view text) const {
+        return const_cast<TextIndex*>(this)->termOf(text, false);
+    }
+
+    // Function to merge terms added since the last search into the text-ordered list
+    void sortNewTerms() const {
+        size_t sorted = byText.size();
+        if (sorted == terms.size()) return;
+        for (size_t term = sorted; term < terms.size(); term++) byText.push_back(static_cast<uint32_t>(term));
+        auto inTextOrder = [this](uint32_t a, uint32_t b) { return termText.view(termRefs[a]) < termText.view(termRefs[b]); };
+        sort(byText.begin() + sorted, byText.end(), inTextOrder);
+        inplace_merge(byText.begin(), byText.begin() + sorted, byText.end(), inTextOrder);
+    }
+
+    // Function to collect a question's distinct terms with their weights; lookup(word) gives a word's term, or -1
+    template <typename Lookup>
+    static void questionTerms(const QuestionStore& store, int slot, Lookup lookup, vector<uint64_t>& out, size_t& tokens) {
+        out.clear();
+        tokens = 0;
+        auto visit = [&](uint64_t weight) {
+            return [&lookup, &out, &tokens, weight](string_view word) {
+                long term = lookup(word);
+                if (term != -1) out.push_back(static_cast<uint64_t>(term) << 8 | weight);
+                tokens++;
+            };
+        };
+        const Question& question = store.row(slot);
+        thread_local string scratch;
+        tokenize(question.text(store.strings(), scratch), visit(2));
+        for (int i = 0; i < question.choiceCount; i++) tokenize(question.choiceText(store.strings(), i), visit(1));
+        sort(out.begin(), out.end());
+        size_t kept = 0;
+        for (size_t i = 0; i < out.size(); i++) {
+            if (kept > 0 && out[kept - 1] >> 8 == out[i] >> 8) {
+                uint64_t weight = min<uint64_t>(weightMask, (out[kept - 1] & 0xFF) + (out[i] & 0xFF));
+                out[kept - 1] = (out[kept - 1] >> 8) << 8 | weight;
+            } else {
+                out[kept++] = out[i];
+            }
+        }
+        out.resize(kept);
+    }
+
+    double idf(const Term& term) const {
+        double df = static_cast<double>(term.count - term.dead);
+        return log(1.0 + (documents - df + 0.5) / (df + 0.5));
+    }
+
+    // BM25 (k1 = 1.2, b = 0.75) with the length normalization worked out once per search
+    struct Bm25 {
+        float base, perToken;
+
+        explicit Bm25(const TextIndex& index) {
+            float average = index.documents ? static_cast<float>(index.totalLength) / index.documents : 1.0f;
+            base = 1.2f * 0.25f;
+            perToken = 1.2f * 0.75f / max(average, 1.0f);
+        }
+
+        float operator()(float termIdf, uint32_t weight, uint32_t length) const {
+            return termIdf * weight * 2.2f / (weight + base + perToken * length);
+        }
+    };
+
+    // Function to check whether words appear consecutively in text
+    static bool containsPhrase(string_view text, const vector<string>& words) {
+        vector<string> tokens;
+        tokenize(text, [&](string_view word) { tokens.emplace_back(word); });
+        return std::search(tokens.begin(), tokens.end(), words.begin(), words.end()) != tokens.end();
+    }
+
+    // Function to re-code a list without its dead postings once they make up half of it
+    void squeeze(Term& term) {
+        if (term.dead < 32 || term.dead * 2 < term.count) return;
+        static thread_local vector<uint32_t> postings;
+        decode(term, postings);
+        postings.erase(remove_if(postings.begin(), postings.end(), [](uint32_t posting) { return (posting & weightMask) == 0; }),
+                       postings.end());
+        encode(term, postings);
+    }
+
+public:
+    // Function to index a question; call after its text and choices are final
+    void add(const QuestionStore& store, int slot) {
+        static thread_local vector<uint64_t> found;
+        uint32_t id = static_cast<uint32_t>(store.row(slot).id);
+        assert(id < (1u << idBits));
+        if (id >= lengths.size()) lengths.resize(id + 1, 0);
+        if (lengths[id] != 0) remove(store, slot);  // Re-adding an id with unchanged text replaces it
+        size_t tokens;
+        questionTerms(store, slot, [this](string_view word) { return termOf(word, true); }, found, tokens);
+        lengths[id] = static_cast<uint16_t>(min<size_t>(tokens, 65534) + 1);
+        for (uint64_t entry : found) {
+            Term& term = terms[entry >> 8];
+            uint32_t weight = static_cast<uint32_t>(entry & weightMask);
+            if (term.count == 0 || term.lastId < id) {
+                append(term, id, weight);
+                continue;
+            }
+            Cursor at = cursor(term);
+            seek(at, id);
+            if (at.id == id) {
+                if (at.weight == 0) term.dead--;
+                setWeight(term, at, weight);
+            } else {
+                insert(term, id, weight);  // A word new to an older question
+            }
+        }
+        documents++;
+        totalLength += lengths[id] - 1;
+    }
+
+    // Function to unindex a question; call before its text or choices change, or before it is deleted
+    void remove(const QuestionStore& store, int slot) {
+        static thread_local vector<uint64_t> found;
+        uint32_t id = static_cast<uint32_t>(store.row(slot).id);
+        if (id >= lengths.size() || lengths[id] == 0) return;
+        size_t tokens;
+        questionTerms(store, slot, [this](string_view word) { return termOf(word, false); }, found, tokens);
+        for (uint64_t entry : found) {
+            Term& term = terms[entry >> 8];
+            Cursor at = cursor(term);
+            seek(at, id);
+            if (at.id != id || at.weight == 0) continue;
+            setWeight(term, at, 0);
+            term.dead++;
+            squeeze(term);
+        }
+        documents--;
+        totalLength -= lengths[id] - 1;
+        lengths[id] = 0;
+    }
+
+    // Function to index many new questions at once on a pool; their ids must be above every indexed id
+    // and ascend with slots. Each run of questions builds a partial index against its own term table,
+    // words new to the index are registered once, and then the partials are merged by term: each task
+    // owns a share of the terms and appends their postings run by run, in id order.
+    template <typename Pool>
+    void addAll(const QuestionStore& store, const vector<int>& slots, Pool& pool) {
+        static constexpr size_t runSize = 16384;  // Questions per partial
+        if (slots.empty()) return;
+        uint32_t highest = static_cast<uint32_t>(store.row(slots.back()).id);
+        assert(highest < (1u << idBits));
+        if (highest >= lengths.size()) lengths.resize(highest + 1, 0);
+        // Pass 1: tokenize each run into a partial index, then scatter its postings into groups by local term
+        vector<Partial> partials((slots.size() + runSize - 1) / runSize);
+        for (size_t run = 0; run < partials.size(); run++) {
+            pool.submit([this, &store, &slots, &partials, run] {
+                Partial& partial = partials[run];
+                auto lookup = [&partial](string_view word) { return partial.termOf(word); };
+                vector<uint64_t> found, staged;  // Staged: local term << 32 | id << 4 | weight, in id order
+                size_t tokens;
+                for (size_t i = run * runSize; i < min(slots.size(), (run + 1) * runSize); i++) {
+                    uint64_t id = static_cast<uint32_t>(store.row(slots[i]).id);
+                    assert(lengths[id] == 0);
+                    questionTerms(store, slots[i], lookup, found, tokens);
+                    lengths[id] = static_cast<uint16_t>(min<size_t>(tokens, 65534) + 1);
+                    partial.tokens += lengths[id] - 1;
+                    for (uint64_t entry : found) staged.push_back(entry >> 8 << 32 | id << 4 | (entry & weightMask));
+                }
+                partial.firstOf.assign(partial.words.size() + 1, 0);
+                for (uint64_t posting : staged) partial.firstOf[(posting >> 32) + 1]++;
+                for (size_t local = 1; local < partial.firstOf.size(); local++) partial.firstOf[local] += partial.firstOf[local - 1];
+                partial.postings.resize(staged.size());
+                vector<uint32_t> next(partial.firstOf.begin(), partial.firstOf.end() - 1);
+                for (uint64_t posting : staged) partial.postings[next[posting >> 32]++] = static_cast<uint32_t>(posting);
+            });
+        }
+        pool.wait();
+
+        // Pass 2: register every word with the index, so the term list stops growing before the merge
+        for (Partial& partial : partials) {
+            partial.global.resize(partial.words.size());
+            for (size_t local = 0; local < partial.words.size(); local++) {
+                partial.global[local] = static_cast<uint32_t>(termOf(partial.text.view(partial.words[local]), true));
+            }
+            totalLength += partial.tokens;
+        }
+        documents += slots.size();
+
+        // Pass 3: group each partial's terms by owning task, then let each task append its terms' postings
+        size_t owners = max<size_t>(1, pool.size() * 4);
+        for (Partial& partial : partials) {
+            pool.submit([&partial, owners] {
+                partial.ownerStarts.assign(owners + 1, 0);
+                for (uint32_t term : partial.global) partial.ownerStarts[term % owners + 1]++;
+                for (size_t owner = 1; owner <= owners; owner++) partial.ownerStarts[owner] += partial.ownerStarts[owner - 1];
+                partial.byOwner.resize(partial.global.size());
+                vector<uint32_t> next(partial.ownerStarts.begin(), partial.ownerStarts.end() - 1);
+                for (uint32_t local = 0; local < partial.global.size(); local++) partial.byOwner[next[partial.global[local] % owners]++] = local;
+            });
+        }
+        pool.wait();
+        for (size_t owner = 0; owner < owners; owner++) {
+            pool.submit([this, &partials, owner] {
+                for (const Partial& partial : partials) {
+                    for (uint32_t at = partial.ownerStarts[owner]; at < partial.ownerStarts[owner + 1]; at++) {
+                        uint32_t local = partial.byOwner[at];
+                        Term& term = terms[partial.global[local]];
+                        for (uint32_t posting = partial.firstOf[local]; posting < partial.firstOf[local + 1]; posting++) {
+                            uint32_t value = partial.postings[posting];
+                            assert(term.count == 0 || term.lastId < value >> 4);
+                            append(term, value >> 4, value & weightMask);
+                        }
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    void clear() {
+        *this = TextIndex();
+    }
+
+    // Function to find the ids of questions matching a query, best first
+    vector<int> search(const QuestionStore& store, string_view query, size_t limit) const {
+        // Parse the query into groups; a question must match every group, and a group matches through any of its terms
+        vector<vector<uint32_t>> groups;
+        vector<vector<string>> phrases;
+        bool missing = false;
+        auto addTerm = [&](string_view word) {
+            long term = termOf(word);
+            if (term == -1) missing = true;
+            else groups.push_back({static_cast<uint32_t>(term)});
+        };
+        auto live = [this](uint32_t term) { return terms[term].count - terms[term].dead; };
+        while (!query.empty() && !missing) {
+            size_t start = query.find_first_not_of(" \t");
+            if (start == string_view::npos) break;
+            query.remove_prefix(start);
+            if (query[0] == '"') {
+                size_t close = query.find('"', 1);
+                string_view phrase = query.substr(1, close == string_view::npos ? string_view::npos : close - 1);
+                query.remove_prefix(close == string_view::npos ? query.size() : close + 1);
+                vector<string> words;
+                tokenize(phrase, [&](string_view word) { words.emplace_back(word); addTerm(word); });
+                if (words.size() > 1) phrases.push_back(std::move(words));
+                continue;
+            }
+            size_t end = query.find_first_of(" \t");
+            string_view token = query.substr(0, end);
+            query.remove_prefix(end == string_view::npos ? query.size() : end);
+            bool prefix = token.back() == '*';
+            if (prefix) token.remove_suffix(1);
+            vector<string> words;
+            tokenize(token, [&](string_view word) { words.emplace_back(word); });
+            if (!prefix || words.empty()) {
+                for (const string& word : words) addTerm(word);
+                continue;
+            }
+            // Words before the last one of a prefix token ("e-mail*") are matched exactly
+            for (size_t i = 0; i + 1 < words.size(); i++) addTerm(words[i]);
+            const string& stem = words.back();
+            sortNewTerms();
+            vector<uint32_t> expansion;
+            auto first = lower_bound(byText.begin(), byText.end(), stem,
+                                     [this](uint32_t term, const string& stem) { return termText.view(termRefs[term]) < stem; });
+            for (auto term = first; term != byText.end() && termText.view(termRefs[*term]).substr(0, stem.size()) == stem; ++term) {
+                if (live(*term) > 0) expansion.push_back(*term);
+            }
+            if (expansion.size() > maxPrefixTerms) {
+                nth_element(expansion.begin(), expansion.begin() + maxPrefixTerms, expansion.end(),
+                            [&](uint32_t a, uint32_t b) { return live(a) > live(b); });
+                expansion.resize(maxPrefixTerms);
+            }
+            if (expansion.empty()) missing = true;
+            else groups.push_back(std::move(expansion));
+        }
+        if (missing || groups.empty() || limit == 0) return {};
+
+        // The best results so far, in a heap whose top is the worst of them; a question seen again
+        // through another word of a prefix keeps its higher score
+        vector<pair<float, uint32_t>> best;
+        auto worse = [](const pair<float, uint32_t>& a, const pair<float, uint32_t>& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        };
+        auto threshold = [&] { return best.size() < limit ? 0.0f : best.front().first; };
+        auto offer = [&](float score, uint32_t id) {
+            for (auto& entry : best) {
+                if (entry.second != id) continue;
+                if (score > entry.first) {
+                    entry.first = score;
+                    make_heap(best.begin(), best.end(), worse);
+                }
+                return;
+            }
+            if (best.size() < limit) {
+                best.push_back({score, id});
+                push_heap(best.begin(), best.end(), worse);
+            } else {
+                pop_heap(best.begin(), best.end(), worse);
+                best.back() = {score, id};
+                push_heap(best.begin(), best.end(), worse);
+            }
+        };
+
+        // Upper bounds: per word from all its postings, per group the best of its words
+        Bm25 bm25(*this);
+        auto blockScore = [&](float wordIdf, uint32_t bound) {
+            return max(bm25(wordIdf, bound >> 24 & 0xF, bound >> 12 & 0xFFF), bm25(wordIdf, bound >> 28, bound & 0xFFF));
+        };
+        vector<vector<float>> termIdf(groups.size()), termBound(groups.size());
+        vector<float> groupBound(groups.size(), 0.0f);
+        vector<size_t> groupPostings(groups.size(), 0);
+        for (size_t g = 0; g < groups.size(); g++) {
+            for (uint32_t id : groups[g]) {
+                const Term& term = terms[id];
+                float wordIdf = static_cast<float>(idf(term));
+                float bound = blockScore(wordIdf, term.bound);
+                termIdf[g].push_back(wordIdf);
+                termBound[g].push_back(bound);
+                groupBound[g] = max(groupBound[g], bound);
+                groupPostings[g] += live(id);
+            }
+        }
+
+        // Walk the group with the fewest postings and look each question up in the others
+        size_t driver = min_element(groupPostings.begin(), groupPostings.end()) - groupPostings.begin();
+        float otherBound = 0;
+        for (size_t g = 0; g < groups.size(); g++) if (g != driver) otherBound += groupBound[g];
+        vector<vector<Cursor>> cursors(groups.size());
+        for (size_t g = 0; g < groups.size(); g++) {
+            for (uint32_t id : groups[g]) cursors[g].push_back(cursor(terms[id]));
+        }
+        // Function to score a question's matches in the other groups, -1 if it misses one or cannot get past floor
+        auto otherScore = [&](uint32_t id, float floor) {
+            // Blocks first: the other words' postings are only decoded if their blocks can lift it past floor
+            float reachable = 0;
+            for (size_t g = 0; g < groups.size(); g++) {
+                if (g == driver) continue;
+                if (groups[g].size() > 1) {
+                    reachable += groupBound[g];
+                    continue;
+                }
+                Cursor& at = cursors[g][0];
+                if (at.term->blocks.empty()) return -1.0f;
+                locate(at, id);
+                reachable += blockScore(termIdf[g][0], at.term->blocks[at.block].bound);
+            }
+            if (reachable <= floor) return -1.0f;
+            float total = 0;
+            for (size_t g = 0; g < groups.size(); g++) {
+                if (g == driver) continue;
+                float found = -1;
+                for (size_t t = 0; t < groups[g].size(); t++) {
+                    Cursor& at = cursors[g][t];
+                    seek(at, id);
+                    if (at.id == id && at.weight != 0) found = max(found, bm25(termIdf[g][t], at.weight, lengths[id] - 1u));
+                }
+                if (found < 0) return -1.0f;
+                total += found;
+            }
+            return total;
+        };
+        // Phrases need their words in order, within the question text or a single choice
+        auto phrasesMatch = [&](uint32_t id) {
+            if (phrases.empty()) return true;
+            int slot = store.slotOf(static_cast<int>(id));
+            if (slot == -1) return false;
+            const Question& question = store.row(slot);
+            thread_local string scratch;
+            string_view text = question.text(store.strings(), scratch);
+            for (const vector<string>& words : phrases) {
+                bool found = containsPhrase(text, words);
+                for (int i = 0; i < question.choiceCount && !found; i++) {
+                    found = containsPhrase(question.choiceText(store.strings(), i), words);
+                }
+                if (!found) return false;
+            }
+            return true;
+        };
+
+        // Words of a prefix are walked best bound first, so later, weaker ones are often skipped outright.
+        // Within a word, each block is bounded by its own postings plus the other groups' blocks over
+        // the same ids (merged in id order, so a block no other word overlaps is out), and the blocks
+        // are walked best bound first, in buckets, until the rest cannot reach the results
+        constexpr size_t buckets = 64;
+        const float none = -numeric_limits<float>::infinity();
+        vector<size_t> order(groups[driver].size());
+        for (size_t t = 0; t < order.size(); t++) order[t] = t;
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) { return termBound[driver][a] > termBound[driver][b]; });
+        static thread_local vector<float> own, rest, otherScores;  // Reused from search to search
+        static thread_local vector<uint32_t> blockOrder;
+        static thread_local vector<uint8_t> bucketOf;
+        for (size_t t : order) {
+            float wordIdf = termIdf[driver][t];
+            if (termBound[driver][t] + otherBound <= threshold()) break;
+            const Term& term = terms[groups[driver][t]];
+            size_t blocks = term.blocks.size();
+            own.resize(blocks);
+            rest.assign(blocks, 0.0f);
+            for (size_t block = 0; block < blocks; block++) own[block] = blockScore(wordIdf, term.blocks[block].bound);
+            for (size_t g = 0; g < groups.size(); g++) {
+                if (g == driver) continue;
+                if (groups[g].size() > 1) {
+                    for (float& bound : rest) bound += groupBound[g];
+                    continue;
+                }
+                const Term& other = terms[groups[g][0]];
+                otherScores.resize(other.blocks.size());
+                for (size_t k = 0; k < other.blocks.size(); k++) otherScores[k] = blockScore(termIdf[g][0], other.blocks[k].bound);
+                size_t first = 0;
+                for (size_t block = 0; block < blocks; block++) {
+                    uint32_t low = term.blocks[block].firstId;
+                    uint32_t high = block + 1 < blocks ? term.blocks[block + 1].firstId - 1 : term.lastId;
+                    while (first + 1 < other.blocks.size() && other.blocks[first + 1].firstId <= low) first++;
+                    float bound = none;
+                    for (size_t k = first; k < other.blocks.size() && other.blocks[k].firstId <= high; k++) {
+                        uint32_t end = k + 1 < other.blocks.size() ? other.blocks[k + 1].firstId - 1 : other.lastId;
+                        if (end >= low) bound = max(bound, otherScores[k]);
+                    }
+                    rest[block] += bound;
+                }
+            }
+            float highest = 0;
+            for (size_t block = 0; block < blocks; block++) highest = max(highest, own[block] + rest[block]);
+            float scale = highest > 0 ? buckets / highest : 0;
+            size_t starts[buckets + 2] = {};  // Bucket buckets holds blocks that cannot match
+            bucketOf.resize(blocks);
+            for (size_t block = 0; block < blocks; block++) {
+                float bound = own[block] + rest[block];
+                bucketOf[block] = bound > 0 ? static_cast<uint8_t>(buckets - 1 - min(buckets - 1, static_cast<size_t>(bound * scale))) : buckets;
+                starts[bucketOf[block] + 1]++;
+            }
+            for (size_t b = 1; b <= buckets; b++) starts[b] += starts[b - 1];
+            blockOrder.resize(starts[buckets]);
+            for (size_t block = 0; block < blocks; block++) {
+                if (bucketOf[block] < buckets) blockOrder[starts[bucketOf[block]]++] = static_cast<uint32_t>(block);
+            }
+            Cursor at = cursor(term);
+            size_t walked = 0;
+            for (size_t b = 0; b < buckets; b++) {
+                if (highest * (buckets - b + 1) / buckets <= threshold()) break;  // A bucket's slack covers rounding
+                for (; walked < starts[b]; walked++) {
+                    uint32_t block = blockOrder[walked];
+                    if (own[block] + rest[block] <= threshold()) continue;
+                    // What each weight can score in the block, so most postings are passed over without
+                    // looking up their question's length
+                    uint32_t packed = term.blocks[block].bound;
+                    float reach[weightMask + 1] = {};
+                    for (uint32_t weight = 1; weight <= packed >> 28; weight++) {
+                        reach[weight] = bm25(wordIdf, weight, weight <= (packed >> 24 & 0xF) ? packed >> 12 & 0xFFF : packed & 0xFFF);
+                    }
+                    openBlock(at, block);
+                    for (size_t left = term.blocks[block].count; left > 0; left--, advance(at)) {
+                        if (at.weight == 0 || reach[at.weight] + rest[block] <= threshold()) continue;
+                        uint32_t id = at.id;
+                        float score = bm25(wordIdf, at.weight, lengths[id] - 1u);
+                        if (score + rest[block] <= threshold()) continue;
+                        if (groups.size() > 1) {
+                            float others = otherScore(id, threshold() - score);
+                            if (others < 0) continue;
+                            score += others;
+                        }
+                        if (score > threshold() && phrasesMatch(id)) offer(score, id);
+                    }
+                }
+            }
+        }
+
+        sort_heap(best.begin(), best.end(), worse);
+        vector<int> ids;
+        for (const auto& entry : best) ids.push_back(static_cast<int>(entry.second));
+        return ids;
+    }
+
+    // Function to report the heap bytes the index holds
+    size_t memoryBytes() const {
+        size_t bytes = termText.size() + termRefs.capacity() * sizeof(ArenaString) + termTable.capacity() * 8
+                     + terms.capacity() * sizeof(Term) + byText.capacity() * 4 + lengths.capacity() * 2;
+        for (const Term& term : terms) bytes += term.postings.capacity() + term.blocks.capacity() * sizeof(Block);
+        return bytes;
+    }
+};
+
+
+// Quiz bank file format (little-endian, native layout):
+//   BankHeader | BankRecord[questionCount] | BankParameters[questionCount] | ArenaString[choiceCount] | heap
+// Version 1 files have no BankParameters section; their questions open uncalibrated.
+// Every string (type, question text, answer key, choice text) is an
+// ArenaString into the heap, so a reader can mmap the file and use it in
+// place without parsing or allocating per question.
+const char bankMagic[8] = {'Q', 'U', 'I', 'Z', 'B', 'A', 'N', 'K'};
+const uint32_t bankVersion = 2;
+
+struct BankHeader {
+    char magic[8];           // Always bankMagic
+    uint32_t version;        // Format version, bankVersion when written
+    uint32_t recordSize;     // sizeof(BankRecord), guards against layout changes
+    uint64_t questionCount;  // Number of BankRecords
+    uint64_t choiceCount;    // Number of choice references, shared by all records
+    uint64_t heapSize;       // Bytes of string data
+    uint64_t nextId;         // First id not yet handed out when the bank was saved
+    uint64_t checksum;       // bankChecksum of everything after the header
+};
+
+// Fixed-size record for one question
+struct BankRecord {
+    int32_t id;              // Question id
+    uint32_t firstChoice;    // Index of the question's first choice reference
+    uint32_t choiceCount;    // Number of choices (0 unless mcq)
+    uint32_t reserved;       // Padding, always 0
+    double points;           // Points awarded for this question
+    ArenaString type;        // Type of question (mcq, tf, wr)
+    ArenaString text;        // Question text
+    ArenaString correctAnswer; // Correct answer
+};
+
+// IRT parameters of the record at the same index
+struct BankParameters {
+    float discrimination;
+    float difficulty;
+    float guessing;
+    uint32_t reserved;       // Padding, always 0
+};
+
+static_assert(sizeof(BankHeader) % 8 == 0 && sizeof(BankRecord) % 8 == 0 && sizeof(BankParameters) % 8 == 0,
+              "bank sections must stay 8-byte aligned");
+
+// Function to checksum a bank body, four independent 64-bit lanes so it runs near memory speed
+uint64_t bankChecksum(const char* data, size_t size) {
+    const uint64_t prime1 = 0x9E3779B185EBCA87ull, prime2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t lanes[4] = {prime1, prime2, ~prime1, ~prime2};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, data + i + lane * 8, 8);
+            lanes[lane] += word * prime2;
+            lanes[lane] = ((lanes[lane] << 31) | (lanes[lane] >> 33)) * prime1;
+        }
+    }
+    uint64_t hash = size;
+    for (int lane = 0; lane < 4; lane++) hash = (hash ^ lanes[lane]) * prime1;
+    for (; i < size; i++) hash = (hash ^ static_cast<unsigned char>(data[i])) * prime2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+
+// Read-only view of a quiz bank file, mapped straight from disk.
+// Opening only validates the header and section sizes, so a bank of
+// millions of questions opens in the time of an mmap; questions are read
+// in place on demand. String and choice references are bounds-checked as
+// they are read, so a damaged file can give wrong text but never reads
+// outside the mapping. recordProblem() checks one record's type, points
+// and parameters where it is used, and verify() checks the checksum and
+// every record up front (--verify mode, and snapshots during recovery).
+class MappedBank {
+private:
+    const char* base;              // Start of the mapping
+    size_t length;                 // Size of the mapping in bytes
+    const BankHeader* header;
+    const BankRecord* records;
+    const BankParameters* calibration; // Null for version 1 files
+    const ArenaString* choiceRefs;
+    const char* heap;
+    string error;                  // Why the last open failed
+
+    bool fail(const string& reason) {
+        close();
+        error = reason;
+        return false;
+    }
+
+    bool inHeap(ArenaString ref) const {
+        return ref.offset <= header->heapSize && ref.length <= header->heapSize - ref.offset;
+    }
+
+public:
+    MappedBank() : base(nullptr), length(0), header(nullptr), records(nullptr), calibration(nullptr), choiceRefs(nullptr), heap(nullptr) {}
+    ~MappedBank() { close(); }
+    MappedBank(const MappedBank&) = delete;
+    MappedBank& operator=(const MappedBank&) = delete;
+
+    // Function to map a bank file, checking its header and section sizes; with verify, also verify()
+    bool open(const string& path, bool verify = false) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return fail("cannot open " + path);
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(BankHeader))) {
+            ::close(fd);
+            return fail("file too small to be a quiz bank");
+        }
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return fail("mmap failed");
+        base = static_cast<const char*>(mapping);
+        length = info.st_size;
+
+        header = reinterpret_cast<const BankHeader*>(base);
+        if (memcmp(header->magic, bankMagic, sizeof(bankMagic)) != 0) return fail("not a quiz bank file");
+        if (header->version != 1 && header->version != bankVersion) return fail("unsupported bank version " + to_string(header->version));
+        if (header->recordSize != sizeof(BankRecord)) return fail("bank record size mismatch");
+        uint64_t body = length - sizeof(BankHeader);
+        uint64_t questionSize = sizeof(BankRecord) + (header->version >= 2 ? sizeof(BankParameters) : 0);
+        if (header->questionCount > body / questionSize ||
+            header->choiceCount > body / sizeof(ArenaString) ||
+            header->questionCount * questionSize + header->choiceCount * sizeof(ArenaString) + header->heapSize != body) {
+            return fail("bank section sizes do not match file size");
+        }
+        records = reinterpret_cast<const BankRecord*>(base + sizeof(BankHeader));
+        const char* afterRecords = reinterpret_cast<const char*>(records + header->questionCount);
+        if (header->version >= 2) {
+            calibration = reinterpret_cast<const BankParameters*>(afterRecords);
+            afterRecords += header->questionCount * sizeof(BankParameters);
+        }
+        choiceRefs = reinterpret_cast<const ArenaString*>(afterRecords);
+        heap = reinterpret_cast<const char*>(choiceRefs + header->choiceCount);
+
+        if (verify && !this->verify()) return false;
+        error.clear();
+        return true;
+    }
+
+    // Function to check the checksum and every record of an open bank, reading the whole file;
+    // on failure the bank is closed and lastError() says why
+    bool verify() {
+        madvise(const_cast<char*>(base), length, MADV_SEQUENTIAL);
+        if (bankChecksum(base + sizeof(BankHeader), length - sizeof(BankHeader)) != header->checksum) {
+            return fail("checksum mismatch");
+        }
+        return checkRecords();
+    }
+
+    // Function to check every record but not the checksum, e.g. before building a grading key from
+    // all of them; on failure the bank is closed and lastError() says why
+    bool checkRecords() {
+        for (uint64_t i = 0; i < header->questionCount; i++) {
+            if (const char* problem = recordProblem(i)) return fail("question record " + to_string(i) + problem);
+        }
+        return true;
+    }
+
+    // Function to check one record's references, type, points and IRT parameters; null if it is sound
+    const char* recordProblem(size_t index) const {
+        const BankRecord& record = records[index];
+        if (!inHeap(record.type) || !inHeap(record.text) || !inHeap(record.correctAnswer) ||
+            record.firstChoice > header->choiceCount || record.choiceCount > header->choiceCount - record.firstChoice ||
+            record.choiceCount > Question::maxChoices) {
+            return " out of bounds";
+        }
+        for (uint32_t c = 0; c < record.choiceCount; c++) {
+            if (!inHeap(choiceRefs[record.firstChoice + c])) return " has choice text out of bounds";
+        }
+        QuestionKind kind;
+        if (!parseKind(view(record.type), kind)) return " has an unknown type";
+        if (!(record.points >= 0 && record.points <= maxQuestionPoints)) return " has an invalid point value";
+        if (!validItemParameters(parameters(index))) return " has invalid IRT parameters";
+        return nullptr;
+    }
+
+    // Function to unmap the bank
+    void close() {
+        if (base) munmap(const_cast<char*>(base), length);
+        base = nullptr;
+        length = 0;
+        header = nullptr;
+        records = nullptr;
+        calibration = nullptr;
+        choiceRefs = nullptr;
+        heap = nullptr;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    const string& lastError() const { return error; }
+    size_t size() const { return header ? header->questionCount : 0; }
+    int nextId() const { return header ? static_cast<int>(header->nextId) : 1; }
+
+    const BankRecord& record(size_t index) const { return records[index]; }
+
+    // Function to give the IRT parameters of the record at index (the defaults in a version 1 file)
+    ItemParameters parameters(size_t index) const {
+        ItemParameters parameters;
+        if (calibration) {
+            parameters.discrimination = calibration[index].discrimination;
+            parameters.difficulty = calibration[index].difficulty;
+            parameters.guessing = calibration[index].guessing;
+        }
+        return parameters;
+    }
+    // Function to read a string; empty if the reference points outside the heap
+    string_view view(ArenaString ref) const { return inHeap(ref) ? string_view(heap + ref.offset, ref.length) : string_view(); }
+
+    // Function to give a record's type; open() has checked it names one
+    QuestionKind kind(const BankRecord& record) const {
+        QuestionKind kind = QuestionKind::mcq;
+        parseKind(view(record.type), kind);
+        return kind;
+    }
+
+    // Function to read a record's choice; empty if the record's choices run past the table
+    string_view choiceText(const BankRecord& record, int index) const {
+        uint64_t at = static_cast<uint64_t>(record.firstChoice) + index;
+        return at < header->choiceCount ? view(choiceRefs[at]) : string_view();
+    }
+};
+
+
+// One edit read back from a journal. Views point into the journal being replayed.
+struct JournalRecord {
+    enum Kind : uint8_t { put = 1, erase = 2, clear = 3 };
+
+    Kind kind;
+    int32_t id;                 // Question put or erased
+    double points;
+    string_view type, text, answer;
+    uint32_t choiceCount;
+    string_view choices[Question::maxChoices];
+    ItemParameters parameters;  // Defaults when a put from an older build carries none
+};
+
+
+// Crash-safe record of every change made to a bank while authoring. Each
+// change is appended as "payload size | checksum | payload", where a put
+// carries the question's whole new state, so replay is a series of
+// idempotent upserts and deletes. Appending only copies the record into a
+// buffer; a flusher thread writes whatever has built up and fdatasyncs it
+// as one group, so one sync covers every change made while the previous
+// one was in flight. waitDurable() blocks until a given change is on disk.
+// If a write or sync fails the journal is cut back to its last good record
+// and stays failed: later changes are refused rather than written after a
+// gap that replay would stop at, and waitDurable() reports them as lost.
+//
+// Files share a base path: base.snapshot.G is a bank file holding the state
+// before generation G, and base.journal.G holds the changes made after it.
+// Once the live journal passes compactBytes the flusher starts journal G+1
+// and a compactor thread replays the older files into base.snapshot.G+1,
+// then deletes what it folded in. Recovery loads the newest snapshot that
+// verifies, replays every later journal in order and cuts off a torn tail.
+class EditJournal {
+public:
+    // Function to rebuild a snapshot: load snapshotIn (empty means none), replay the journals, save to snapshotOut
+    using Compactor = function<bool(const string& snapshotIn, const vector<string>& journals, const string& snapshotOut)>;
+
+private:
+    static constexpr char journalMagic[8] = {'Q', 'U', 'I', 'Z', 'J', 'R', 'N', '1'};
+
+    string base;
+    Compactor compactor;
+    size_t compactBytes;
+    int fd = -1;
+    uint64_t generation = 0;          // Journal being appended to
+    uint64_t snapshotGeneration = 0;  // Newest complete snapshot; 0 if there is none
+
+    mutex lock;
+    condition_variable work, flushed;
+    string pending;                   // Records not yet handed to the flusher
+    uint64_t appended = 0;            // Sequence number of the last record appended
+    uint64_t durable = 0;             // Sequence number of the last record on disk
+    size_t journalBytes = 0;          // Size of the live journal file
+    bool stopping = false;
+    bool compacting = false;
+    bool failed = false;              // A write or sync failed; nothing after durable will reach disk
+    uint64_t groups = 0;              // fdatasync calls so far
+    thread flusher, compaction;
+
+    string snapshotPath(uint64_t g) const { return base + ".snapshot." + to_string(g); }
+    string journalPath(uint64_t g) const { return base + ".journal." + to_string(g); }
+
+    // Function to make a directory entry change (create, rename, unlink) durable
+    static void syncDirectory(const string& path) {
+        size_t slash = path.rfind('/');
+        string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir < 0) return;
+        fsync(dir);
+        ::close(dir);
+    }
+
+    static bool writeAll(int file, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(file, data, size);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    // Function to start a new, empty journal file for generation g
+    bool startJournal(uint64_t g) {
+        int file = ::open(journalPath(g).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file < 0) return false;
+        if (!writeAll(file, journalMagic, sizeof(journalMagic)) || fdatasync(file) != 0) {
+            ::close(file);
+            return false;
+        }
+        syncDirectory(journalPath(g));
+        if (fd >= 0) ::close(fd);
+        fd = file;
+        generation = g;
+        journalBytes = sizeof(journalMagic);
+        return true;
+    }
+
+    // Function to find the generations of base's snapshot and journal files
+    void listGenerations(vector<uint64_t>& snapshots, vector<uint64_t>& journals) const {
+        size_t slash = base.rfind('/');
+        string directory = slash == string::npos ? "." : slash == 0 ? "/" : base.substr(0, slash);
+        string name = slash == string::npos ? base : base.substr(slash + 1);
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) return;
+        while (dirent* entry = readdir(dir)) {
+            string_view file(entry->d_name);
+            if (file.substr(0, name.size()) != name) continue;
+            file.remove_prefix(name.size());
+            vector<uint64_t>* list = nullptr;
+            if (file.substr(0, 10) == ".snapshot.") list = &snapshots, file.remove_prefix(10);
+            else if (file.substr(0, 9) == ".journal.") list = &journals, file.remove_prefix(9);
+            uint64_t g = 0;
+            auto parsed = from_chars(file.data(), file.data() + file.size(), g);
+            if (list && !file.empty() && parsed.ec == errc() && parsed.ptr == file.data() + file.size()) list->push_back(g);
+        }
+        closedir(dir);
+        sort(snapshots.begin(), snapshots.end());
+        sort(journals.begin(), journals.end());
+    }
+
+    // Function to fold every journal before the live one into a new snapshot, on the compaction thread
+    void compact(uint64_t from, uint64_t to) {
+        vector<string> journals;
+        for (uint64_t g = from; g < to; g++) {
+            if (access(journalPath(g).c_str(), F_OK) == 0) journals.push_back(journalPath(g));
+        }
+        // The compactor saves through Quiz::save, which syncs the file before renaming it into place
+        bool done = compactor(from > 0 && access(snapshotPath(from).c_str(), F_OK) == 0 ? snapshotPath(from) : string(),
+                              journals, snapshotPath(to));
+        if (done) {
+            syncDirectory(snapshotPath(to));
+            // The new snapshot is durable, so what it replaces can go
+            for (const string& journal : journals) unlink(journal.c_str());
+            if (from > 0) unlink(snapshotPath(from).c_str());
+        }
+        lock_guard<mutex> guard(lock);
+        if (done) snapshotGeneration = to;
+        compacting = false;
+        flushed.notify_all();
+    }
+
+    void flushLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            work.wait(guard, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) break;  // Stopping with nothing left to write
+            string group;
+            group.swap(pending);
+            uint64_t upTo = appended;
+            guard.unlock();
+            bool written = writeAll(fd, group.data(), group.size()) && fdatasync(fd) == 0;
+            guard.lock();
+            if (!written) {
+                // Drop any partial write so the file ends on a whole record, then refuse everything after it
+                cerr << "[Edit journal write failed: " << strerror(errno) << "]" << endl;
+                if (ftruncate(fd, journalBytes) == 0) fdatasync(fd);
+                failed = true;
+                pending.clear();
+                flushed.notify_all();
+                continue;
+            }
+            durable = upTo;
+            groups++;
+            journalBytes += group.size();
+            flushed.notify_all();
+            if (journalBytes >= compactBytes && !compacting && !stopping) {
+                uint64_t from = snapshotGeneration;
+                if (!startJournal(generation + 1)) continue;  // Keep appending to the old one
+                compacting = true;
+                if (compaction.joinable()) compaction.join();
+                compaction = thread([this, from, to = generation] { compact(from, to); });
+            }
+        }
+    }
+
+    template <typename T>
+    static void appendValue(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void appendText(string& out, string_view text) {
+        appendValue(out, static_cast<uint32_t>(text.size()));
+        out += text;
+    }
+
+    // Function to frame a payload and queue it for the flusher; returns its sequence number.
+    // Once the journal has failed nothing is queued, so waitDurable() on the number returns false.
+    uint64_t append(const string& payload) {
+        uint32_t header[2] = {static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(bankChecksum(payload.data(), payload.size()))};
+        lock_guard<mutex> guard(lock);
+        if (failed) return ++appended;
+        pending.append(reinterpret_cast<const char*>(header), sizeof(header));
+        pending += payload;
+        work.notify_one();
+        return ++appended;
+    }
+
+public:
+    explicit EditJournal(size_t compactAfterBytes = size_t(64) << 20) : compactBytes(compactAfterBytes) {}
+
+    ~EditJournal() { close(); }
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    // Function to read a journal file, calling apply for each intact record; returns the
+    // length of the intact prefix (0 if the file is missing or not a journal)
+    static size_t replay(const string& path, const function<void(const JournalRecord&)>& apply) {
+        int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0) return 0;
+        struct stat info;
+        if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(journalMagic))) {
+            ::close(file);
+            return 0;
+        }
+        size_t size = info.st_size;
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (mapping == MAP_FAILED) return 0;
+        const char* data = static_cast<const char*>(mapping);
+        size_t at = 0;
+        if (memcmp(data, journalMagic, sizeof(journalMagic)) == 0) {
+            at = sizeof(journalMagic);
+            JournalRecord record{};
+            while (size - at >= 8) {
+                uint32_t header[2];
+                memcpy(header, data + at, sizeof(header));
+                if (header[0] > size - at - 8) break;  // Torn: the crash came mid-write
+                const char* payload = data + at + 8;
+                const char* end = payload + header[0];
+                if (static_cast<uint32_t>(bankChecksum(payload, header[0])) != header[1]) break;
+                auto read = [&](void* value, size_t bytes) {
+                    if (static_cast<size_t>(end - payload) < bytes) return false;
+                    memcpy(value, payload, bytes);
+                    payload += bytes;
+                    return true;
+                };
+                auto readText = [&](string_view& text) {
+                    uint32_t length;
+                    if (!read(&length, sizeof(length)) || static_cast<size_t>(end - payload) < length) return false;
+                    text = string_view(payload, length);
+                    payload += length;
+                    return true;
+                };
+                uint8_t kind = 0;
+                bool valid = read(&kind, 1) && read(&record.id, sizeof(record.id));
+                record.kind = static_cast<JournalRecord::Kind>(kind);
+                if (valid && kind == JournalRecord::put) {
+                    valid = read(&record.points, sizeof(record.points)) && read(&record.choiceCount, sizeof(record.choiceCount)) &&
+                            record.choiceCount <= Question::maxChoices && readText(record.type) && readText(record.text) &&
+                            readText(record.answer);
+                    for (uint32_t i = 0; valid && i < record.choiceCount; i++) valid = readText(record.choices[i]);
+                    record.parameters = ItemParameters();
+                    if (valid && payload != end) {
+                        valid = read(&record.parameters.discrimination, sizeof(float)) &&
+                                read(&record.parameters.difficulty, sizeof(float)) && read(&record.parameters.guessing, sizeof(float));
+                    }
+                } else if (valid && kind != JournalRecord::erase && kind != JournalRecord::clear) {
+                    valid = false;
+                }
+                if (!valid || payload != end) break;
+                apply(record);
+                at = end - data;
+            }
+        }
+        munmap(mapping, size);
+        return at;
+    }
+
+    // Function to recover base's state into load/apply and start journaling after it. load is
+    // given the snapshot to start from; apply gets every journaled change made since.
+    bool open(const string& basePath, const function<bool(const string&)>& load,
+              const function<void(const JournalRecord&)>& apply, Compactor compact, string& error) {
+        close();
+        base = basePath;
+        compactor = std::move(compact);
+        vector<uint64_t> snapshots, journals;
+        listGenerations(snapshots, journals);
+
+        // Newest snapshot that opens cleanly; an older one is only left over from a crash mid-compaction
+        snapshotGeneration = 0;
+        for (auto g = snapshots.rbegin(); g != snapshots.rend(); ++g) {
+            MappedBank bank;
+            if (bank.open(snapshotPath(*g), true)) {
+                snapshotGeneration = *g;
+                break;
+            }
+        }
+        if (snapshotGeneration > 0 && !load(snapshotPath(snapshotGeneration))) {
+            error = "cannot load " + snapshotPath(snapshotGeneration);
+            return false;
+        }
+        uint64_t last = snapshotGeneration;
+        size_t intact = 0;
+        for (uint64_t g : journals) {
+            if (g < snapshotGeneration) continue;
+            intact = replay(journalPath(g), apply);
+            last = g;
+        }
+        for (uint64_t g : snapshots) if (g < snapshotGeneration) unlink(snapshotPath(g).c_str());
+        for (uint64_t g : journals) if (g < snapshotGeneration) unlink(journalPath(g).c_str());
+
+        // Keep appending to the newest journal, minus any torn tail
+        int file = -1;
+        if (intact > 0) file = ::open(journalPath(last).c_str(), O_WRONLY | O_CLOEXEC);
+        if (file >= 0) {
+            if (ftruncate(file, intact) != 0 || lseek(file, 0, SEEK_END) < 0 || fdatasync(file) != 0) {
+                ::close(file);
+                file = -1;
+            }
+        }
+        if (file >= 0) {
+            fd = file;
+            generation = last;
+            journalBytes = intact;
+        } else if (!startJournal(max<uint64_t>(last, 1))) {
+            error = "cannot create " + journalPath(max<uint64_t>(last, 1));
+            return false;
+        }
+        stopping = false;
+        failed = false;
+        flusher = thread([this] { flushLoop(); });
+        return true;
+    }
+
+    // Function to flush everything, stop the threads and close the journal
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            if (fd < 0) return;
+            stopping = true;
+        }
+        work.notify_all();
+        if (flusher.joinable()) flusher.join();
+        if (compaction.joinable()) compaction.join();
+        ::close(fd);
+        fd = -1;
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    // Function to journal a question's current state; returns the record's sequence number.
+    // IRT parameters go on the end only when set, so uncalibrated puts read as they always have.
+    uint64_t put(const QuestionStore& questions, int slot) {
+        thread_local string payload, scratch;
+        const Question& question = questions.row(slot);
+        payload.clear();
+        appendValue(payload, static_cast<uint8_t>(JournalRecord::put));
+        appendValue(payload, static_cast<int32_t>(question.id));
+        appendValue(payload, fromFixedPoints(questions.points(slot)));
+        appendValue(payload, static_cast<uint32_t>(question.choiceCount));
+        appendText(payload, kindName(questions.type(slot)));
+        appendText(payload, question.text(questions.strings(), scratch));
+        appendText(payload, questions.correctAnswer(slot));
+        for (int i = 0; i < question.choiceCount; i++) appendText(payload, question.choiceText(questions.strings(), i));
+        const ItemParameters& parameters = questions.parameters(slot);
+        if (!parameters.isDefault()) {
+            appendValue(payload, parameters.discrimination);
+            appendValue(payload, parameters.difficulty);
+            appendValue(payload, parameters.guessing);
+        }
+        return append(payload);
+    }
+
+    // Function to journal a question's deletion
+    uint64_t erase(int id) {
+        thread_local string payload;
+        payload.clear();
+        appendValue(payload, static_cast<uint8_t>(JournalRecord::erase));
+        appendValue(payload, static_cast<int32_t>(id));
+        return append(payload);
+    }
+
+    // Function to journal that every question was deleted
+    uint64_t clear() {
+        thread_local string payload;
+        payload.clear();
+        appendValue(payload, static_cast<uint8_t>(JournalRecord::clear));
+        appendValue(payload, int32_t(0));
+        return append(payload);
+    }
+
+    // Function to block until the record with this sequence number is on disk; false if it never will be
+    bool waitDurable(uint64_t sequence) {
+        unique_lock<mutex> guard(lock);
+        flushed.wait(guard, [&] { return durable >= sequence || failed || fd < 0; });
+        return durable >= sequence;
+    }
+
+    // Function to block until everything appended so far is on disk; false if some of it never will be
+    bool sync() {
+        uint64_t last;
+        {
+            lock_guard<mutex> guard(lock);
+            last = appended;
+        }
+        return waitDurable(last);
+    }
+
+    // Function to tell whether a write has failed, so later changes cannot be made durable
+    bool hasFailed() {
+        lock_guard<mutex> guard(lock);
+        return failed;
+    }
+
+    // Function to block until no compaction is running
+    void waitForCompaction() {
+        unique_lock<mutex> guard(lock);
+        flushed.wait(guard, [this] { return !compacting; });
+    }
+
+    uint64_t syncCount() {
+        lock_guard<mutex> guard(lock);
+        return groups;
+    }
+
+    uint64_t currentGeneration() {
+        lock_guard<mutex> guard(lock);
+        return generation;
+    }
+};
+
+
+// Thread pool where every worker owns a task deque. Workers pop their own
+// newest task first and, when empty, steal the oldest task from another
+// worker, so uneven chunks of work still keep every core busy.
+class WorkStealingPool {
+private:
+    struct WorkerQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<WorkerQueue>> queues;  // One deque per worker
+    vector<thread> workers;
+    mutex idleLock;
+    condition_variable wakeup;               // Signalled when tasks arrive or the pool stops
+    condition_variable drained;              // Signalled when the last pending task finishes
+    atomic<size_t> pending;                  // Tasks submitted but not finished
+    atomic<unsigned> nextQueue;              // Round-robin target for outside submissions
+    bool stopping;
+
+    static thread_local int workerIndex;     // Index of the calling worker, -1 outside the pool
+
+    bool popTask(unsigned self, function<void()>& task) {
+        {
+            WorkerQueue& own = *queues[self];
+            lock_guard<mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < queues.size(); i++) {
+            WorkerQueue& victim = *queues[(self + i) % queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(unsigned self) {
+        workerIndex = static_cast<int>(self);
+        function<void()> task;
+        while (true) {
+            if (popTask(self, task)) {
+                task();
+                task = nullptr;
+                if (pending.fetch_sub(1) == 1) {
+                    lock_guard<mutex> guard(idleLock);
+                    drained.notify_all();
+                }
+                continue;
+            }
+            unique_lock<mutex> guard(idleLock);
+            if (stopping) return;
+            wakeup.wait_for(guard, chrono::milliseconds(1));
+        }
+    }
+
+public:
+    explicit WorkStealingPool(unsigned threadCount = thread::hardware_concurrency())
+        : pending(0), nextQueue(0), stopping(false) {
+        if (threadCount == 0) threadCount = 1;
+        for (unsigned i = 0; i < threadCount; i++) queues.push_back(make_unique<WorkerQueue>());
+        for (unsigned i = 0; i < threadCount; i++) workers.emplace_back(&WorkStealingPool::run, this, i);
+    }
+
+    ~WorkStealingPool() {
+        wait();
+        {
+            lock_guard<mutex> guard(idleLock);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Function to queue a task; tasks queued from a worker stay on that worker's deque
+    void submit(function<void()> task) {
+        unsigned target = workerIndex >= 0 ? static_cast<unsigned>(workerIndex)
+                                           : nextQueue.fetch_add(1) % queues.size();
+        pending.fetch_add(1);
+        {
+            lock_guard<mutex> guard(queues[target]->lock);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        wakeup.notify_one();
+    }
+
+    // Function to block until every submitted task has finished
+    void wait() {
+        unique_lock<mutex> guard(idleLock);
+        drained.wait(guard, [this] { return pending.load() == 0; });
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+};
+
+thread_local int WorkStealingPool::workerIndex = -1;
+
+
+// Near-duplicate questions are found with MinHash. A question's text and
+// choices are read as lowercase words (as the search index reads them) and
+// cut into overlapping 5-character shingles. The share of shingles two
+// questions have in common (their Jaccard similarity) is estimated from 64
+// one-permutation MinHash bins: each shingle is hashed once, its top bits
+// pick a bin, and the bin keeps 16 bits of the smallest hash it sees. Bins
+// left empty by short questions copy a bin picked by a fixed hash sequence,
+// the same for every question, so estimates stay unbiased. For lookups the
+// bins are split into 16 bands of 4 (locality-sensitive hashing): questions
+// that agree on a whole band are candidates, and a candidate counts when its
+// estimate reaches the threshold. A pair at similarity 0.8 shares a band
+// with probability 0.9998, a pair at 0.3 only 0.12.
+struct MinHashSignature {
+    static constexpr int bins = 64, bands = 16, rows = bins / bands;
+
+    uint16_t bin[bins];
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Function to estimate the Jaccard similarity of the two questions' shingles
+    double similarity(const MinHashSignature& other) const {
+        int equal = 0;
+        for (int i = 0; i < bins; i++) equal += bin[i] == other.bin[i];
+        return static_cast<double>(equal) / bins;
+    }
+
+    // Function to hash one band's bins; questions agreeing on the band get the same key
+    uint64_t bandKey(int band) const {
+        uint64_t packed = 0;
+        for (int i = 0; i < rows; i++) packed = packed << 16 | bin[band * rows + i];
+        return mix(packed + (band + 1) * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+// Builds one MinHashSignature at a time from a question's text pieces;
+// reusable, so a thread keeps one for all the questions it signs.
+class MinHasher {
+private:
+    static constexpr size_t shingleLength = 5;
+    static constexpr uint64_t noHash = UINT64_MAX;
+
+    string folded;  // Words of the pieces added so far, lowercase and separated by single spaces
+    uint64_t smallest[MinHashSignature::bins];
+
+public:
+    // Function to add a piece of the question (its text, or one choice)
+    void add(string_view text) {
+        TextIndex::tokenize(text, [this](string_view word) {
+            if (!folded.empty()) folded += ' ';
+            folded += word;
+        });
+    }
+
+    // Function to finish the signature of the pieces added and start over; false if they held no words
+    bool finish(MinHashSignature& signature) {
+        if (folded.empty()) return false;
+        fill(begin(smallest), end(smallest), noHash);
+        size_t shingles = folded.size() < shingleLength ? 1 : folded.size() - shingleLength + 1;
+        for (size_t at = 0; at < shingles; at++) {
+            uint64_t packed = 0;
+            for (size_t i = at; i < min(at + shingleLength, folded.size()); i++) packed = packed << 8 | static_cast<unsigned char>(folded[i]);
+            uint64_t hash = MinHashSignature::mix(packed);
+            uint64_t& kept = smallest[hash >> 58];
+            kept = min<uint64_t>(kept, hash & ((1ull << 58) - 1));
+        }
+        for (int i = 0; i < MinHashSignature::bins; i++) {
+            uint64_t from = smallest[i];
+            for (uint64_t attempt = 1; from == noHash; attempt++) {
+                from = smallest[MinHashSignature::mix(static_cast<uint64_t>(i) << 32 | attempt) % MinHashSignature::bins];
+            }
+            signature.bin[i] = static_cast<uint16_t>(MinHashSignature::mix(from));
+        }
+        folded.clear();
+        return true;
+    }
+
+    // Function to add the text and choices of the question in a store slot
+    void add(const QuestionStore& store, int slot) {
+        const Question& question = store.row(slot);
+        thread_local string scratch;
+        add(question.text(store.strings(), scratch));
+        for (int i = 0; i < question.choiceCount; i++) add(question.choiceText(store.strings(), i));
+    }
+
+    // Function to add the text and choices of a bank file's record
+    void add(const MappedBank& bank, size_t index) {
+        const BankRecord& record = bank.record(index);
+        add(bank.view(record.text));
+        for (uint32_t i = 0; i < record.choiceCount; i++) add(bank.choiceText(record, i));
+    }
+};
+
+// A question found to be a near duplicate, with its estimated similarity
+struct DuplicateMatch {
+    int id;
+    double similarity;
+};
+
+// Questions linked by near-duplicate pairs. members[0] is the lowest id and
+// every similarity is to it, so it is 1 for the first member.
+struct DuplicateCluster {
+    vector<DuplicateMatch> members;
+};
+
+struct DuplicateReport {
+    vector<DuplicateCluster> clusters;  // Ordered by first id
+    size_t questions = 0;               // Questions with text to compare
+    size_t candidates = 0;              // Pairs sharing a band, checked against the threshold
+    size_t similarPairs = 0;            // Of those, pairs at or above it
+    double seconds = 0;
+};
+
+// Function to find every cluster of near duplicates among count questions
+// in parallel. source(index, hasher) adds question index's text to hasher
+// and returns its id, or -1 to leave the index out. Each band is sorted on
+// its own; within a run of equal keys each question is checked against the
+// first and the one before it, so a run of n copies costs O(n) checks.
+template <typename Source>
+DuplicateReport findNearDuplicates(size_t count, Source&& source, double threshold, WorkStealingPool& pool) {
+    auto start = chrono::steady_clock::now();
+    DuplicateReport report;
+    vector<MinHashSignature> signatures(count);
+    vector<int> ids(count, -1);
+    const size_t chunk = 4096;
+    for (size_t first = 0; first < count; first += chunk) {
+        pool.submit([&, first] {
+            MinHasher hasher;
+            for (size_t index = first; index < min(count, first + chunk); index++) {
+                int id = source(index, hasher);
+                if (!hasher.finish(signatures[index])) id = -1;
+                ids[index] = id;
+            }
+        });
+    }
+    pool.wait();
+    report.questions = count - std::count(ids.begin(), ids.end(), -1);
+
+    // A band key keeps its top bits and the question's index goes in the rest
+    int indexBits = 1;
+    while (indexBits < 63 && (1ull << indexBits) < count) indexBits++;
+    const uint64_t indexMask = (1ull << indexBits) - 1;
+    vector<vector<pair<uint32_t, uint32_t>>> pairs(MinHashSignature::bands);
+    vector<size_t> candidates(MinHashSignature::bands, 0);
+    for (int band = 0; band < MinHashSignature::bands; band++) {
+        pool.submit([&, band] {
+            vector<uint64_t> keys;
+            keys.reserve(report.questions);
+            for (size_t index = 0; index < count; index++) {
+                if (ids[index] != -1) keys.push_back((signatures[index].bandKey(band) & ~indexMask) | index);
+            }
+            sort(keys.begin(), keys.end());
+            auto check = [&](uint64_t a, uint64_t b) {
+                candidates[band]++;
+                if (signatures[a & indexMask].similarity(signatures[b & indexMask]) >= threshold) {
+                    pairs[band].push_back({static_cast<uint32_t>(a & indexMask), static_cast<uint32_t>(b & indexMask)});
+                }
+            };
+            for (size_t run = 0, end; run < keys.size(); run = end) {
+                for (end = run + 1; end < keys.size() && (keys[end] & ~indexMask) == (keys[run] & ~indexMask); end++) {
+                    check(keys[run], keys[end]);
+                    if (end - 1 > run) check(keys[end - 1], keys[end]);
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    vector<pair<uint32_t, uint32_t>> similar;
+    for (int band = 0; band < MinHashSignature::bands; band++) {
+        report.candidates += candidates[band];
+        similar.insert(similar.end(), pairs[band].begin(), pairs[band].end());
+    }
+    sort(similar.begin(), similar.end());
+    similar.erase(unique(similar.begin(), similar.end()), similar.end());
+    report.similarPairs = similar.size();
+
+    // Union-find over the pairs, rooted at the lowest index of each cluster
+    vector<uint32_t> parent(count);
+    for (size_t index = 0; index < count; index++) parent[index] = static_cast<uint32_t>(index);
+    auto root = [&parent](uint32_t index) {
+        while (parent[index] != index) index = parent[index] = parent[parent[index]];  // Path halving
+        return index;
+    };
+    for (auto [a, b] : similar) {
+        uint32_t x = root(a), y = root(b);
+        if (x != y) parent[max(x, y)] = min(x, y);
+    }
+    map<uint32_t, vector<uint32_t>> groups;
+    for (auto [a, b] : similar) {
+        groups[root(a)];
+        groups[root(b)];
+    }
+    for (size_t index = 0; index < count; index++) {
+        auto group = groups.find(root(static_cast<uint32_t>(index)));
+        if (group != groups.end()) group->second.push_back(static_cast<uint32_t>(index));
+    }
+    for (auto& group : groups) {
+        vector<uint32_t>& members = group.second;
+        sort(members.begin(), members.end(), [&ids](uint32_t a, uint32_t b) { return ids[a] < ids[b]; });
+        DuplicateCluster cluster;
+        for (uint32_t index : members) cluster.members.push_back({ids[index], signatures[members[0]].similarity(signatures[index])});
+        report.clusters.push_back(std::move(cluster));
+    }
+    sort(report.clusters.begin(), report.clusters.end(),
+         [](const DuplicateCluster& a, const DuplicateCluster& b) { return a.members[0].id < b.members[0].id; });
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+// Signatures of a quiz's questions and their band keys, kept up to date as
+// questions come and go, so a new question can be checked against the bank
+// as it is added. An open-addressing table holds one entry per band key in
+// use, hash << 32 | (first id + 1) with 0 for empty, and the questions
+// sharing a key are linked through per-band prev/next arrays, so a bank
+// full of copies neither lengthens probe runs nor slows removal. The index
+// is empty and costs nothing until enable() builds it.
+class NearDuplicateIndex {
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+    static constexpr size_t maxWalk = 256;  // Questions read per band when checking one; copies beyond add nothing
+
+    struct Links {
+        uint32_t prev[MinHashSignature::bands], next[MinHashSignature::bands];
+    };
+
+    vector<MinHashSignature> signatures;  // By id
+    vector<Links> links;                  // By id
+    vector<uint8_t> indexed;              // By id: 1 if the id is linked in
+    vector<uint64_t> table;
+    size_t entries = 0;
+    bool enabled = false;
+    MinHasher hasher;
+
+    static uint64_t keyOf(const MinHashSignature& signature, int band) {
+        return signature.bandKey(band) >> 32;
+    }
+
+    // Function to find the table position of a key's entry, or of the empty one ending its probe run
+    size_t find(uint64_t key) const {
+        size_t mask = table.size() - 1, i = key & mask;
+        while (table[i] != 0 && (table[i] >> 32) != key) i = (i + 1) & mask;
+        return i;
+    }
+
+    void erase(size_t i) {
+        size_t mask = table.size() - 1;
+        // Pull later entries of the probe run back so lookups never stop short at the hole
+        for (size_t next = (i + 1) & mask; table[next] != 0; next = (next + 1) & mask) {
+            size_t home = (table[next] >> 32) & mask;
+            if (((next - home) & mask) >= ((next - i) & mask)) {
+                table[i] = table[next];
+                i = next;
+            }
+        }
+        table[i] = 0;
+        entries--;
+    }
+
+    void grow() {
+        vector<uint64_t> old(max<size_t>(1024, table.size() * 2), 0);
+        old.swap(table);
+        for (uint64_t value : old) if (value != 0) table[find(value >> 32)] = value;
+    }
+
+    // Function to make room for ids up to id
+    void reserve(uint32_t id) {
+        if (id < signatures.size()) return;
+        signatures.resize(id + 1);
+        links.resize(id + 1);
+        indexed.resize(id + 1, 0);
+    }
+
+    // Function to link a signed id into every band's list
+    void link(uint32_t id) {
+        for (int band = 0; band < MinHashSignature::bands; band++) {
+            if ((entries + 1) * 2 > table.size()) grow();
+            uint64_t key = keyOf(signatures[id], band);
+            size_t at = find(key);
+            uint32_t head = table[at] == 0 ? none : static_cast<uint32_t>(table[at]) - 1u;
+            links[id].prev[band] = none;
+            links[id].next[band] = head;
+            if (head != none) links[head].prev[band] = id;
+            else entries++;
+            table[at] = key << 32 | (id + 1u);
+        }
+        indexed[id] = 1;
+    }
+
+public:
+    bool isEnabled() const { return enabled; }
+
+    // Function to start keeping the index, signing every question already in the store
+    void enable(const QuestionStore& store) {
+        enabled = true;
+        clear();
+        for (int slot = store.nextLive(0); slot != -1; slot = store.nextLive(slot + 1)) add(store, slot);
+    }
+
+    void clear() {
+        signatures.clear();
+        links.clear();
+        indexed.clear();
+        table.clear();
+        entries = 0;
+    }
+
+    // Function to index a question; a question without words is left out
+    void add(const QuestionStore& store, int slot) {
+        if (!enabled) return;
+        uint32_t id = static_cast<uint32_t>(store.row(slot).id);
+        reserve(id);
+        hasher.add(store, slot);
+        if (hasher.finish(signatures[id])) link(id);
+    }
+
+    // Function to index many new questions at once: they are signed in parallel and linked in order
+    void addAll(const QuestionStore& store, const vector<int>& slots, WorkStealingPool& pool) {
+        if (!enabled || slots.empty()) return;
+        for (int slot : slots) reserve(static_cast<uint32_t>(store.row(slot).id));
+        vector<uint8_t> signed_(slots.size(), 0);
+        const size_t chunk = 4096;
+        for (size_t first = 0; first < slots.size(); first += chunk) {
+            pool.submit([&, first] {
+                MinHasher hasher;
+                for (size_t i = first; i < min(slots.size(), first + chunk); i++) {
+                    hasher.add(store, slots[i]);
+                    signed_[i] = hasher.finish(signatures[store.row(slots[i]).id]);
+                }
+            });
+        }
+        pool.wait();
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (signed_[i]) link(static_cast<uint32_t>(store.row(slots[i]).id));
+        }
+    }
+
+    void remove(int id) {
+        if (!enabled || id < 0 || static_cast<size_t>(id) >= indexed.size() || !indexed[id]) return;
+        for (int band = 0; band < MinHashSignature::bands; band++) {
+            uint32_t prev = links[id].prev[band], next = links[id].next[band];
+            if (next != none) links[next].prev[band] = prev;
+            if (prev != none) {
+                links[prev].next[band] = next;
+                continue;
+            }
+            size_t at = find(keyOf(signatures[id], band));
+            if (next == none) erase(at);
+            else table[at] = table[at] >> 32 << 32 | (next + 1u);
+        }
+        indexed[id] = 0;
+    }
+
+    // Function to list indexed questions at least threshold alike to id, most alike first
+    vector<DuplicateMatch> similarTo(int id, double threshold, size_t limit) const {
+        vector<DuplicateMatch> matches;
+        if (id < 0 || static_cast<size_t>(id) >= indexed.size() || !indexed[id]) return matches;
+        const MinHashSignature& signature = signatures[id];
+        vector<uint32_t> candidates;
+        for (int band = 0; band < MinHashSignature::bands; band++) {
+            size_t at = find(keyOf(signature, band));
+            uint32_t other = static_cast<uint32_t>(table[at]) - 1u;
+            for (size_t walked = 0; other != none && walked < maxWalk; other = links[other].next[band], walked++) {
+                if (other != static_cast<uint32_t>(id)) candidates.push_back(other);
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+        for (uint32_t other : candidates) {
+            double similarity = signature.similarity(signatures[other]);
+            if (similarity >= threshold) matches.push_back({static_cast<int>(other), similarity});
+        }
+        sort(matches.begin(), matches.end(), [](const DuplicateMatch& a, const DuplicateMatch& b) {
+            return a.similarity != b.similarity ? a.similarity > b.similarity : a.id < b.id;
+        });
+        if (matches.size() > limit) matches.resize(limit);
+        return matches;
+    }
+
+    size_t memoryBytes() const {
+        return signatures.capacity() * sizeof(MinHashSignature) + links.capacity() * sizeof(Links) + indexed.capacity() +
+               table.capacity() * sizeof(uint64_t);
+    }
+};
+
+
+// Objective answers (a single letter, "true" or "false") are graded as
+// one-byte codes so a whole sheet can be compared 32 questions at a time.
+// Code 0 is a blank answer and answerUnmatchable is any other text; neither
+// is ever a key code, so equal codes mean equal strings.
+const uint8_t answerBlank = 0;
+const uint8_t answerTrue = 27;
+const uint8_t answerFalse = 28;
+const uint8_t answerUnmatchable = 0xFF;
+const uint8_t keyPadding = 0xFE;  // Key code past the last question, never matches
+
+// Function to encode an answer; foldCase lowercases it first, as displayQuestion() does
+uint8_t answerCode(string_view answer, bool foldCase) {
+    if (answer.empty()) return answerBlank;
+    auto lower = [foldCase](char c) { return foldCase ? static_cast<char>(tolower(c)) : c; };
+    if (answer.size() == 1) {
+        char c = lower(answer[0]);
+        return (c >= 'a' && c <= 'z') ? static_cast<uint8_t>(c - 'a' + 1) : answerUnmatchable;
+    }
+    if (answer.size() == 4 || answer.size() == 5) {
+        char folded[5];
+        for (size_t i = 0; i < answer.size(); i++) folded[i] = lower(answer[i]);
+        string_view word(folded, answer.size());
+        if (word == "true") return answerTrue;
+        if (word == "false") return answerFalse;
+    }
+    return answerUnmatchable;
+}
+
+// Function to add up the points of every matching code, one byte at a time
+FixedPoints objectiveScoreScalar(const uint8_t* key, const uint8_t* sheet, const FixedPoints* points, size_t count) {
+    FixedPoints total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (key[i] == sheet[i]) total += points[i];
+    }
+    return total;
+}
+
+// Function to add up the points of every matching code, 32 codes per compare.
+// count must be a multiple of 32. Each compare's byte mask is widened four
+// bytes at a time into 64-bit lane masks that select the points to add.
+__attribute__((target("avx2")))
+FixedPoints objectiveScoreAvx2(const uint8_t* key, const uint8_t* sheet, const FixedPoints* points, size_t count) {
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < count; i += 32) {
+        __m256i matches = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + i)),
+                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sheet + i)));
+        if (_mm256_testz_si256(matches, matches)) continue;
+        alignas(32) int32_t groups[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(groups), matches);
+        for (int g = 0; g < 8; g++) {
+            if (groups[g] == 0) continue;
+            __m256i mask = _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(groups[g]));
+            __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(points + i + g * 4));
+            sum = _mm256_add_epi64(sum, _mm256_and_si256(mask, lanes));
+        }
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+using ObjectiveScoreKernel = FixedPoints (*)(const uint8_t*, const uint8_t*, const FixedPoints*, size_t);
+
+// Function to pick the widest kernel this CPU supports, once
+ObjectiveScoreKernel objectiveScoreKernel() {
+    static const ObjectiveScoreKernel kernel =
+        __builtin_cpu_supports("avx2") ? objectiveScoreAvx2 : objectiveScoreScalar;
+    return kernel;
+}
+
+
+// Written-response answers are compared in canonical form: lowercase, one
+// space between words, punctuation dropped, and numbers rewritten so that
+// "38", "38.0" and "038" are the same answer (commas in "1,000" are
+// dropped). Keys are canonicalized once when a WrKey is built.
+string canonicalAnswer(string_view text) {
+    string canonical;
+    canonical.reserve(text.size());
+    size_t i = 0;
+    auto startToken = [&canonical] {
+        if (!canonical.empty() && canonical.back() != ' ') canonical += ' ';
+    };
+    while (i < text.size()) {
+        unsigned char c = text[i];
+        bool signedNumber = (c == '-' || c == '+' || c == '.') && i + 1 < text.size() && isdigit(static_cast<unsigned char>(text[i + 1]));
+        if (isdigit(c) || signedNumber) {
+            // Read the whole number, then write it back in its shortest form
+            string digits(1, static_cast<char>(c));
+            for (i++; i < text.size(); i++) {
+                unsigned char d = text[i];
+                if (isdigit(d) || d == '.') digits += static_cast<char>(d);
+                else if (d != ',' || i + 1 >= text.size() || !isdigit(static_cast<unsigned char>(text[i + 1]))) break;
+            }
+            while (digits.size() > 1 && digits.back() == '.') digits.pop_back();
+            char* end = nullptr;
+            double value = strtod(digits.c_str(), &end);
+            startToken();
+            if (end == digits.c_str() + digits.size() && std::isfinite(value)) {
+                char formatted[32];
+                snprintf(formatted, sizeof(formatted), "%.15g", value == 0 ? 0.0 : value);
+                canonical += formatted;
+            } else {
+                canonical += digits;
+            }
+            continue;
+        }
+        if (isspace(c) || (ispunct(c) && c != '\'')) {
+            if (!canonical.empty() && canonical.back() != ' ') canonical += ' ';
+        } else if (c != '\'') {
+            if (!canonical.empty() && canonical.back() != ' ' && isdigit(static_cast<unsigned char>(canonical.back()))) canonical += ' ';
+            canonical += static_cast<char>(tolower(c));
+        }
+        i++;
+    }
+    if (!canonical.empty() && canonical.back() == ' ') canonical.pop_back();
+    return canonical;
+}
+
+// Function to test whether two strings are within maxEdits insertions, deletions or
+// substitutions of each other, with a diagonal band of dynamic programming
+bool withinEditsBanded(string_view pattern, string_view text, int maxEdits) {
+    const int m = static_cast<int>(pattern.size()), n = static_cast<int>(text.size());
+    const int outside = maxEdits + 1;
+    vector<int> previous(m + 1), current(m + 1);
+    for (int i = 0; i <= m; i++) previous[i] = i <= maxEdits ? i : outside;
+    for (int j = 1; j <= n; j++) {
+        int low = max(1, j - maxEdits), high = min(m, j + maxEdits);
+        current[0] = j <= maxEdits ? j : outside;
+        if (low > 1) current[low - 1] = outside;
+        int best = current[0];
+        for (int i = low; i <= high; i++) {
+            int cost = previous[i - 1] + (pattern[i - 1] != text[j - 1]);
+            cost = min(cost, min(previous[i], current[i - 1]) + 1);
+            current[i] = min(cost, outside);
+            best = min(best, current[i]);
+        }
+        if (high < m) current[high + 1] = outside;
+        if (best > maxEdits) return false;
+        swap(previous, current);
+    }
+    return previous[m] <= maxEdits;
+}
+
+
+// Policy for how far a written answer may stray from its key
+struct WrPolicy {
+    int maxEdits = 2;            // Never allow more edits than this
+    double editsPerChar = 0.2;   // Allowed edits grow with key length (5 chars -> 1 edit)
+};
+
+
+// Written-response key compiled once for grading many answers. Keys that
+// contain a number must match exactly (after canonicalization); other keys
+// accept answers within a few edits, checked with Myers' bit-parallel
+// edit distance so each answer character costs a handful of word ops.
+class WrKey {
+private:
+    string raw;                          // Key as the author typed it
+    string canonical;                    // canonicalAnswer(raw)
+    int allowedEdits;                    // Edits tolerated for this key
+    vector<pair<uint8_t, uint64_t>> peq; // Per character, bit i set if canonical[i] is that character
+
+    // Function to run Myers' algorithm for a key of at most 64 characters
+    bool withinEditsBitParallel(string_view text) const {
+        thread_local uint64_t table[256] = {};  // Scratch match masks, zero between calls
+        for (auto& entry : peq) table[entry.first] = entry.second;
+        const int m = static_cast<int>(canonical.size()), n = static_cast<int>(text.size());
+        const uint64_t last = 1ull << (m - 1);
+        uint64_t positive = m == 64 ? ~0ull : (1ull << m) - 1, negative = 0;
+        int distance = m;
+        bool within = true;
+        for (int j = 0; j < n; j++) {
+            uint64_t match = table[static_cast<unsigned char>(text[j])];
+            uint64_t vertical = match | negative;
+            uint64_t horizontal = (((match & positive) + positive) ^ positive) | match;
+            uint64_t hPositive = negative | ~(horizontal | positive);
+            uint64_t hNegative = positive & horizontal;
+            if (hPositive & last) distance++;
+            else if (hNegative & last) distance--;
+            // Every remaining character can lower the distance by at most one
+            if (distance - (n - 1 - j) > allowedEdits) { within = false; break; }
+            hPositive = (hPositive << 1) | 1;
+            hNegative <<= 1;
+            positive = hNegative | ~(vertical | hPositive);
+            negative = hPositive & vertical;
+        }
+        for (auto& entry : peq) table[entry.first] = 0;
+        return within && distance <= allowedEdits;
+    }
+
+public:
+    explicit WrKey(string_view key, const WrPolicy& policy = WrPolicy())
+        : raw(key), canonical(canonicalAnswer(key)), allowedEdits(0) {
+        bool numeric = any_of(canonical.begin(), canonical.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); });
+        if (!numeric) {
+            allowedEdits = min(policy.maxEdits, static_cast<int>(canonical.size() * policy.editsPerChar));
+        }
+        if (allowedEdits > 0 && canonical.size() <= 64) {
+            for (size_t i = 0; i < canonical.size(); i++) {
+                uint8_t c = static_cast<uint8_t>(canonical[i]);
+                auto entry = find_if(peq.begin(), peq.end(), [c](const pair<uint8_t, uint64_t>& e) { return e.first == c; });
+                if (entry == peq.end()) peq.emplace_back(c, 1ull << i);
+                else entry->second |= 1ull << i;
+            }
+        }
+    }
+
+    const string& canonicalForm() const { return canonical; }
+    int editsAllowed() const { return allowedEdits; }
+
+    // Function to grade an answer that is already in canonical form
+    bool matchesCanonical(string_view answer) const {
+        if (answer == canonical) return true;
+        if (allowedEdits == 0) return false;
+        if (abs(static_cast<int>(answer.size()) - static_cast<int>(canonical.size())) > allowedEdits) return false;
+        if (canonical.empty()) return false;
+        if (canonical.size() <= 64) return withinEditsBitParallel(answer);
+        return withinEditsBanded(canonical, answer, allowedEdits);
+    }
+
+    // Function to grade an answer as the taker typed it; a blank answer only matches a blank key
+    bool matches(string_view answer) const {
+        if (answer.empty()) return raw.empty();
+        return matchesCanonical(canonicalAnswer(answer));
+    }
+};
+
+
+// Per-thread memo of written answers already graded, since large sittings
+// repeat the same few answers to each question. Entries are tagged with the
+// key they were graded against and the table is dropped when it fills up.
+struct WrAnswerCache {
+    uint64_t owner = 0;                    // Serial of the GradingKey the entries belong to
+    unordered_map<string, bool> verdicts;  // position bytes + raw answer -> correct?
+    string probe;                          // Reused lookup key
+    static const size_t maxEntries = 1 << 16;
+};
+
+atomic<uint64_t> gradingKeySerials{0};  // Hands every GradingKey a new serial each time it changes
+
+
+// Question type policies. Every type provides the same static members, and
+// code that depends on the type is written once as a generic lambda that
+// visitType() instantiates per type, so nothing on the grading path
+// compares type names or makes a virtual call. Adding a type takes a
+// QuestionKind, a policy, a case in visitType() and a GradingKey table.
+//   hasChoices    the question has lettered answer choices
+//   byteCoded     keys may be graded as answerCode() bytes by the vector kernel
+//   costlyGrade   verdicts are worth caching per answer (see WrAnswerCache)
+//   keyPrompt     what authoring asks for as the correct answer
+//   answerHint    shown to takers after "Your answer"
+//   normalizeKey  stores a typed key in its one accepted form
+//   validKey      checks a normalized key
+//   compile       turns a key into what grade() wants, once per key
+//   grade         grades a lowercased answer
+
+// Function to copy text lowercased and without surrounding blanks
+void foldKey(string_view text, string& key) {
+    size_t first = text.find_first_not_of(" \t\r"), last = text.find_last_not_of(" \t\r");
+    key.assign(first == string_view::npos ? string_view() : text.substr(first, last - first + 1));
+    for (auto& c : key) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+}
+
+struct McqType {
+    static constexpr QuestionKind kind = QuestionKind::mcq;
+    static constexpr bool hasChoices = true, byteCoded = true, costlyGrade = false;
+    static constexpr const char* keyPrompt = "Select correct answer: ";
+    static constexpr const char* answerHint = "";
+    using Key = string;
+
+    static void normalizeKey(string_view text, string& key) { foldKey(text, key); }
+    static bool validKey(string_view key) { return !key.empty() && isalpha(static_cast<unsigned char>(key[0])); }
+    static Key compile(string_view key) { return string(key); }
+    static bool grade(string_view key, string_view answer) { return key == answer; }
+};
+
+struct TfType {
+    static constexpr QuestionKind kind = QuestionKind::tf;
+    static constexpr bool hasChoices = false, byteCoded = true, costlyGrade = false;
+    static constexpr const char* keyPrompt = "Select correct answer [true/false]: ";
+    static constexpr const char* answerHint = "";
+    using Key = string;
+
+    static void normalizeKey(string_view text, string& key) { foldKey(text, key); }
+    static bool validKey(string_view key) { return key == "true" || key == "false"; }
+    static Key compile(string_view key) { return string(key); }
+    static bool grade(string_view key, string_view answer) { return key == answer; }
+};
+
+// Written responses keep the key as typed; WrKey forgives case, spacing and typos
+struct WrType {
+    static constexpr QuestionKind kind = QuestionKind::wr;
+    static constexpr bool hasChoices = false, byteCoded = false, costlyGrade = true;
+    static constexpr const char* keyPrompt = "Type correct answer: ";
+    static constexpr const char* answerHint = "";
+    using Key = WrKey;
+
+    static void normalizeKey(string_view text, string& key) { key.assign(text); }
+    static bool validKey(string_view) { return true; }
+    static Key compile(string_view key) { return WrKey(key); }
+    static bool grade(const Key& key, string_view answer) { return key.matches(answer); }
+};
+
+// Numeric keys are "value" or "value~tolerance"; an answer scores when it is a
+// number no further than the tolerance from the value (exactly it if none is given)
+struct NumericKey {
+    double value = 0.0;
+    double tolerance = 0.0;
+    bool valid = false;
+};
+
+struct NumericType {
+    static constexpr QuestionKind kind = QuestionKind::numeric;
+    static constexpr bool hasChoices = false, byteCoded = false, costlyGrade = false;
+    static constexpr const char* keyPrompt = "Type correct answer, optionally with a tolerance (e.g. 3.14~0.01): ";
+    static constexpr const char* answerHint = " (a number)";
+    using Key = NumericKey;
+
+    // Function to read a whole string as a finite number, allowing surrounding blanks
+    static bool parseNumber(string_view text, double& value) {
+        size_t first = text.find_first_not_of(" \t\r"), last = text.find_last_not_of(" \t\r");
+        if (first == string_view::npos) return false;
+        text = text.substr(first, last - first + 1);
+        if (text.size() > 1 && text[0] == '+') text.remove_prefix(1);
+        auto parsed = from_chars(text.data(), text.data() + text.size(), value);
+        return parsed.ec == errc() && parsed.ptr == text.data() + text.size() && std::isfinite(value);
+    }
+
+    static void normalizeKey(string_view text, string& key) {
+        foldKey(text, key);
+        key.erase(remove(key.begin(), key.end(), ' '), key.end());
+    }
+
+    static Key compile(string_view key) {
+        NumericKey compiled;
+        size_t tilde = key.find('~');
+        compiled.valid = parseNumber(key.substr(0, tilde), compiled.value) &&
+                         (tilde == string_view::npos ||
+                          (parseNumber(key.substr(tilde + 1), compiled.tolerance) && compiled.tolerance >= 0));
+        return compiled;
+    }
+
+    static bool validKey(string_view key) { return compile(key).valid; }
+
+    static bool grade(const Key& key, string_view answer) {
+        double value;
+        if (!key.valid || !parseNumber(answer, value)) return false;
+        // Leave room for rounding in the key itself: 3.15 is within 0.01 of 3.14
+        return std::fabs(value - key.value) <= key.tolerance + 1e-9 * max(1.0, std::fabs(key.value));
+    }
+};
+
+// Multi-select keys list every correct letter once, in order ("ac"). Answers are
+// read as a set of letters, so "C, a" answers "ac"; only the exact set scores.
+struct MultiType {
+    static constexpr QuestionKind kind = QuestionKind::multi;
+    static constexpr bool hasChoices = true, byteCoded = false, costlyGrade = false;
+    static constexpr const char* keyPrompt = "Select every correct answer (e.g. ac): ";
+    static constexpr const char* answerHint = " (every correct letter)";
+    using Key = uint32_t;  // Bit i set if letter 'a' + i is correct
+
+    // Function to read letters separated by nothing, blanks or commas; 0 if there is anything else
+    static uint32_t letterSet(string_view text) {
+        uint32_t set = 0;
+        for (char c : text) {
+            char letter = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            if (letter >= 'a' && letter <= 'z') set |= 1u << (letter - 'a');
+            else if (c != ' ' && c != ',' && c != '\t' && c != '\r') return 0;
+        }
+        return set;
+    }
+
+    static void normalizeKey(string_view text, string& key) {
+        uint32_t set = letterSet(text);
+        if (set == 0) {
+            foldKey(text, key);  // Kept as typed, so validKey() turns it down
+            return;
+        }
+        key.clear();
+        for (int i = 0; i < Question::maxChoices; i++) {
+            if (set >> i & 1) key += static_cast<char>('a' + i);
+        }
+    }
+
+    static bool validKey(string_view key) {
+        if (key.empty()) return false;
+        for (size_t i = 0; i < key.size(); i++) {
+            if (key[i] < 'a' || key[i] > 'z' || (i > 0 && key[i] <= key[i - 1])) return false;
+        }
+        return true;
+    }
+
+    static Key compile(string_view key) { return letterSet(key); }
+    static bool grade(Key key, string_view answer) { return key != 0 && letterSet(answer) == key; }
+};
+
+// Function to call visit with the policy of a question type
+template <typename Visitor>
+auto visitType(QuestionKind kind, Visitor&& visit) {
+    switch (kind) {
+        case QuestionKind::tf: return visit(TfType());
+        case QuestionKind::wr: return visit(WrType());
+        case QuestionKind::numeric: return visit(NumericType());
+        case QuestionKind::multi: return visit(MultiType());
+        default: return visit(McqType());
+    }
+}
+
+bool kindHasChoices(QuestionKind kind) {
+    return visitType(kind, [](auto type) { return decltype(type)::hasChoices; });
+}
+
+const char* keyPrompt(QuestionKind kind) {
+    return visitType(kind, [](auto type) { return decltype(type)::keyPrompt; });
+}
+
+// Function to put a typed key into the form stored for a type
+void normalizeKey(QuestionKind kind, string_view text, string& key) {
+    visitType(kind, [&](auto type) { decltype(type)::normalizeKey(text, key); });
+}
+
+// Function to check a normalized key against its type's rules
+bool validKey(QuestionKind kind, string_view key) {
+    return visitType(kind, [key](auto type) { return decltype(type)::validKey(key); });
+}
+
+
+// Answer key compiled from a bank for grading many answer sheets.
+// Questions keep the bank's slot order so scores add up in exactly the
+// order Quiz::submit() adds them. Once pack() has run, questions whose key
+// is an objective answer are also kept as byte codes for the vector kernel.
+struct GradingKey {
+    // One table of compiled keys per question type, in QuestionKind order
+    using CompiledKeys = tuple<vector<McqType::Key>, vector<TfType::Key>, vector<WrType::Key>,
+                               vector<NumericType::Key>, vector<MultiType::Key>>;
+    static_assert(tuple_size<CompiledKeys>::value == questionKindCount, "every question type needs a key table");
+
+    vector<int> ids;                // Question id at each position
+    vector<string> correctAnswers;  // Answer key at each position
+    vector<FixedPoints> points;     // Points at each position
+    vector<int> positionById;       // id -> position, -1 if the id is not in the key
+    vector<QuestionKind> kinds;     // Type of the question at each position
+    vector<int> compiledIndex;      // position -> index into its type's table in compiled
+    CompiledKeys compiled;          // Keys compiled by their type's policy
+    unordered_map<uint64_t, int> compiledByTag[questionKindCount]; // Key tag -> index into compiled, per type
+    double totalPoints = 0.0;       // Denominator reported with every score
+    uint64_t serial = 0;            // Identifies this key to per-thread answer caches
+
+    // Packed section, filled by pack()
+    bool packed = false;            // True once pack() has run
+    vector<int> objectiveIndex;     // position -> index into the packed arrays, -1 if graded as text
+    vector<uint8_t> objectiveKey;   // Key codes, padded to a multiple of 32 with keyPadding
+    vector<FixedPoints> objectivePoints; // Points per key code, padded with 0
+    vector<int> textPositions;      // Positions still graded by their type's policy, in order
+
+    static constexpr uint64_t untagged = UINT64_MAX;
+
+    // Function to add a question. Keys given the same tag (a pool handle, say)
+    // must be equal, and are compiled once and share their compiled key.
+    void add(int id, string_view correctAnswer, double questionPoints, QuestionKind kind = QuestionKind::mcq,
+             uint64_t keyTag = untagged) {
+        serial = ++gradingKeySerials;  // A changed key must not find verdicts cached for what it was, or for another key
+        if (id >= static_cast<int>(positionById.size())) positionById.resize(id + 1, -1);
+        positionById[id] = static_cast<int>(ids.size());
+        ids.push_back(id);
+        correctAnswers.emplace_back(correctAnswer);
+        points.push_back(toFixedPoints(questionPoints));
+        kinds.push_back(kind);
+        visitType(kind, [&](auto type) {
+            using Type = decltype(type);
+            auto& table = get<static_cast<size_t>(Type::kind)>(compiled);
+            int index = static_cast<int>(table.size());
+            if (keyTag != untagged) {
+                auto tagged = compiledByTag[static_cast<int>(Type::kind)].try_emplace(keyTag, index);
+                compiledIndex.push_back(tagged.first->second);
+                if (!tagged.second) return;
+            } else {
+                compiledIndex.push_back(index);
+            }
+            table.push_back(Type::compile(correctAnswer));
+        });
+    }
+
+    // Function to grade one recorded answer with its question type's policy
+    bool isCorrect(size_t position, const string& answer) const {
+        return visitType(kinds[position], [&](auto type) {
+            using Type = decltype(type);
+            const auto& key = get<static_cast<size_t>(Type::kind)>(compiled)[compiledIndex[position]];
+            if constexpr (Type::costlyGrade) {
+                if (!answer.empty()) return cachedVerdict(position, answer, [&] { return Type::grade(key, answer); });
+            }
+            return Type::grade(key, answer);
+        });
+    }
+
+    // Function to look a verdict up in this thread's cache, grading and keeping it on a miss
+    template <typename Grade>
+    bool cachedVerdict(size_t position, const string& answer, Grade grade) const {
+        thread_local WrAnswerCache cache;
+        if (cache.owner != serial || cache.verdicts.size() >= WrAnswerCache::maxEntries) {
+            cache.verdicts.clear();
+            cache.owner = serial;
+        }
+        uint32_t tag = static_cast<uint32_t>(position);
+        cache.probe.assign(reinterpret_cast<const char*>(&tag), sizeof(tag));
+        cache.probe += answer;
+        auto hit = cache.verdicts.find(cache.probe);
+        if (hit != cache.verdicts.end()) return hit->second;
+        bool verdict = grade();
+        cache.verdicts.emplace(cache.probe, verdict);
+        return verdict;
+    }
+
+    int positionOf(int id) const {
+        if (id < 0 || id >= static_cast<int>(positionById.size())) return -1;
+        return positionById[id];
+    }
+
+    size_t size() const { return ids.size(); }
+
+    // Function to compile a key straight from a mapped bank file
+    static GradingKey fromBank(const MappedBank& bank) {
+        GradingKey key;
+        key.ids.reserve(bank.size());
+        key.correctAnswers.reserve(bank.size());
+        key.points.reserve(bank.size());
+        FixedPoints total = 0;
+        for (size_t i = 0; i < bank.size(); i++) {
+            const BankRecord& record = bank.record(i);
+            // save() writes each distinct key once, so records sharing a key share its heap bytes
+            const ArenaString& answer = record.correctAnswer;
+            key.add(record.id, bank.view(answer), record.points, bank.kind(record),
+                    static_cast<uint64_t>(answer.offset) << 32 | answer.length);
+            total += key.points.back();
+        }
+        key.totalPoints = fromFixedPoints(total);
+        key.pack();
+        return key;
+    }
+
+    // Function to score one sheet of answers indexed by position, the same way submit() does
+    FixedPoints score(const vector<string>& answers) const {
+        FixedPoints total = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (isCorrect(i, answers[i])) total += points[i];
+        }
+        return total;
+    }
+
+    // Function to split the key into byte-coded objective questions and text questions.
+    // Packed grading adds points in a different order than submit(), which is safe
+    // because fixed-point sums are exact in any order.
+    void pack() {
+        serial = ++gradingKeySerials;
+        objectiveIndex.assign(size(), -1);
+        objectiveKey.clear();
+        objectivePoints.clear();
+        textPositions.clear();
+        for (size_t i = 0; i < size(); i++) {
+            uint8_t code = answerCode(correctAnswers[i], false);
+            bool byteCoded = visitType(kinds[i], [](auto type) { return decltype(type)::byteCoded; });
+            if (code == answerBlank || code == answerUnmatchable || !byteCoded) {
+                textPositions.push_back(static_cast<int>(i));
+                continue;
+            }
+            objectiveIndex[i] = static_cast<int>(objectiveKey.size());
+            objectiveKey.push_back(code);
+            objectivePoints.push_back(points[i]);
+        }
+        size_t padded = (objectiveKey.size() + 31) / 32 * 32;
+        objectiveKey.resize(padded, keyPadding);
+        objectivePoints.resize(padded, 0);
+        packed = true;
+    }
+
+    // Function to score a packed sheet: objective codes plus the answers of text positions
+    FixedPoints scorePacked(const uint8_t* sheetCodes, const vector<string>& answers) const {
+        FixedPoints total = objectiveScoreKernel()(objectiveKey.data(), sheetCodes, objectivePoints.data(), objectiveKey.size());
+        for (int position : textPositions) {
+            if (isCorrect(position, answers[position])) total += points[position];
+        }
+        return total;
+    }
+};
+
+
+// Totals reported after grading a batch of answer sheets
+struct BatchGradeStats {
+    size_t sheets = 0;          // Sheets graded
+    size_t rejectedLines = 0;   // Lines that were not a valid sheet
+    double seconds = 0.0;       // Wall-clock grading time
+    double sheetsPerSecond() const { return seconds > 0 ? sheets / seconds : 0.0; }
+};
+
+
+// Summary statistics of one question over a sitting
+struct ItemStatistics {
+    int id = 0;
+    double difficulty = 0.0;     // p-value: share of sheets answering correctly
+    double pointBiserial = 0.0;  // Correlation of getting it right with the total score; NaN if undefined
+};
+
+// Summary statistics of a whole sitting
+struct SittingStatistics {
+    size_t sheets = 0;
+    double meanScore = 0.0;
+    double scoreDeviation = 0.0;  // Population standard deviation of the total score
+    double kr20 = 0.0;            // Reliability from right/wrong counts; NaN if undefined
+    double alpha = 0.0;           // Cronbach's alpha with items weighted by points; NaN if undefined
+    vector<ItemStatistics> items; // In key order
+};
+
+
+// Per-question response counts gathered while grading, one flat column per
+// statistic, so a chunk of sheets adds to a few arrays and two
+// accumulators merge by adding their columns. The moments of the total
+// score are kept as a running mean and sum of squared deviations and merged
+// with Chan's formula, which stays accurate over millions of sheets.
+// Responses are bucketed by answerCode (blank, a-z, true, false) plus one
+// bucket for any other text.
+struct ItemAccumulator {
+    static const int categories = answerFalse + 2;
+
+    size_t sheets = 0;
+    double scoreMean = 0.0, scoreSquares = 0.0;  // Weighted total score
+    double rightMean = 0.0, rightSquares = 0.0;  // Number answered correctly, for KR-20
+    vector<uint64_t> correct;           // Per question: sheets answering it correctly
+    vector<double> scoreWhenCorrect;    // Per question: sum of those sheets' total scores
+    vector<uint64_t> responses;         // Per question and category: sheets giving that response
+
+    explicit ItemAccumulator(size_t questions = 0)
+        : correct(questions, 0), scoreWhenCorrect(questions, 0.0), responses(questions * categories, 0) {}
+
+    size_t size() const { return correct.size(); }
+
+    static int category(uint8_t code) { return code <= answerFalse ? code : categories - 1; }
+
+    // Function to add one graded sheet: its score, and per question whether it was right and the answer's code
+    void addSheet(double score, const uint8_t* right, const uint8_t* codes) {
+        size_t rightCount = 0;
+        for (size_t i = 0; i < correct.size(); i++) {
+            correct[i] += right[i];
+            scoreWhenCorrect[i] += right[i] ? score : 0.0;
+            responses[i * categories + category(codes[i])]++;
+            rightCount += right[i];
+        }
+        sheets++;
+        double delta = score - scoreMean;
+        scoreMean += delta / sheets;
+        scoreSquares += delta * (score - scoreMean);
+        delta = rightCount - rightMean;
+        rightMean += delta / sheets;
+        rightSquares += delta * (rightCount - rightMean);
+    }
+
+    // Function to fold another accumulator over the same key into this one
+    void merge(const ItemAccumulator& other) {
+        if (other.sheets == 0) return;
+        for (size_t i = 0; i < correct.size(); i++) {
+            correct[i] += other.correct[i];
+            scoreWhenCorrect[i] += other.scoreWhenCorrect[i];
+        }
+        for (size_t i = 0; i < responses.size(); i++) responses[i] += other.responses[i];
+        double total = static_cast<double>(sheets + other.sheets);
+        auto combine = [&](double& mean, double& squares, double otherMean, double otherSquares) {
+            double delta = otherMean - mean;
+            mean += delta * other.sheets / total;
+            squares += otherSquares + delta * delta * sheets * other.sheets / total;
+        };
+        combine(scoreMean, scoreSquares, other.scoreMean, other.scoreSquares);
+        combine(rightMean, rightSquares, other.rightMean, other.rightSquares);
+        sheets += other.sheets;
+    }
+
+    // Function to turn the counts into difficulty, discrimination and reliability
+    SittingStatistics summarize(const GradingKey& key) const {
+        const double undefined = numeric_limits<double>::quiet_NaN();
+        SittingStatistics result;
+        result.sheets = sheets;
+        result.meanScore = scoreMean;
+        double n = static_cast<double>(sheets);
+        double scoreVariance = sheets ? scoreSquares / n : 0.0;
+        double rightVariance = sheets ? rightSquares / n : 0.0;
+        result.scoreDeviation = sqrt(scoreVariance);
+        double itemVariance = 0.0, weightedVariance = 0.0;
+        for (size_t i = 0; i < size(); i++) {
+            ItemStatistics item;
+            item.id = key.ids[i];
+            double p = sheets ? correct[i] / n : 0.0;
+            item.difficulty = p;
+            item.pointBiserial = undefined;
+            if (correct[i] > 0 && correct[i] < sheets && scoreVariance > 0) {
+                double meanRight = scoreWhenCorrect[i] / correct[i];
+                double meanWrong = (scoreMean * n - scoreWhenCorrect[i]) / (n - correct[i]);
+                item.pointBiserial = (meanRight - meanWrong) / result.scoreDeviation * sqrt(p * (1 - p));
+            }
+            itemVariance += p * (1 - p);
+            double itemPoints = fromFixedPoints(key.points[i]);
+            weightedVariance += itemPoints * itemPoints * p * (1 - p);
+            result.items.push_back(item);
+        }
+        double k = static_cast<double>(size());
+        result.kr20 = k > 1 && rightVariance > 0 ? k / (k - 1) * (1 - itemVariance / rightVariance) : undefined;
+        result.alpha = k > 1 && scoreVariance > 0 ? k / (k - 1) * (1 - weightedVariance / scoreVariance) : undefined;
+        return result;
+    }
+
+    // Function to write the item analysis report: a summary comment, then one tab-separated line per question
+    void writeReport(const GradingKey& key, ostream& out) const {
+        SittingStatistics sitting = summarize(key);
+        auto number = [](double value, int digits) {
+            if (std::isnan(value)) return string("n/a");
+            char text[32];
+            snprintf(text, sizeof(text), "%.*f", digits, value);
+            return string(text);
+        };
+        out << "# sheets " << sitting.sheets << ", mean score " << number(sitting.meanScore, 2) << " of "
+            << number(key.totalPoints, 2) << ", sd " << number(sitting.scoreDeviation, 2) << ", KR-20 "
+            << number(sitting.kr20, 3) << ", alpha " << number(sitting.alpha, 3) << '\n';
+        out << "id\tkey\tp\tpoint_biserial\tresponses\n";
+        for (size_t i = 0; i < size(); i++) {
+            const ItemStatistics& item = sitting.items[i];
+            out << item.id << '\t' << key.correctAnswers[i] << '\t' << number(item.difficulty, 3) << '\t'
+                << number(item.pointBiserial, 3) << '\t';
+            const uint64_t* counts = &responses[i * categories];
+            out << "blank=" << counts[answerBlank];
+            for (int code = 1; code < categories; code++) {
+                if (counts[code] == 0) continue;
+                if (code < answerTrue) out << ' ' << static_cast<char>('a' + code - 1);
+                else if (code == answerTrue) out << " true";
+                else if (code == answerFalse) out << " false";
+                else out << " other";
+                out << '=' << counts[code];
+            }
+            out << '\n';
+        }
+    }
+};
+
+
+// Function to grade a stream of answer sheets across a pool of workers.
+// Each input line is one sheet: the student id, then tab-separated
+// "questionId=answer" fields. Answers are lowercased the way
+// displayQuestion() records them; missing questions count as blank.
+// Each output line is "studentId<TAB>score<TAB>totalPoints", in input order.
+// With items set, every chunk also fills its own ItemAccumulator, and they
+// are merged into items in input order as chunks are written out.
+BatchGradeStats gradeBatch(const GradingKey& key, istream& submissions, ostream& scores,
+                           WorkStealingPool& pool, size_t sheetsPerChunk = 512, ItemAccumulator* items = nullptr) {
+    struct Chunk {
+        vector<string> lines;
+        string output;
+        size_t rejected = 0;
+        bool done = false;
+        ItemAccumulator items;
+    };
+
+    BatchGradeStats stats;
+    auto start = chrono::steady_clock::now();
+    if (items && items->size() != key.size()) *items = ItemAccumulator(key.size());
+    mutex doneLock;
+    condition_variable chunkDone;
+    deque<unique_ptr<Chunk>> inFlight;              // Chunks in input order, oldest first
+    const size_t maxInFlight = 4 * pool.size() + 4; // Bound memory on huge streams
+
+    auto gradeChunk = [&key, items](Chunk& chunk) {
+        vector<string> answers(key.size());
+        vector<uint8_t> codes(key.objectiveKey.size(), answerBlank);
+        vector<int> touched;
+        vector<uint8_t> right, responses;  // Per question, for item analysis
+        if (items) {
+            chunk.items = ItemAccumulator(key.size());
+            right.resize(key.size());
+            responses.resize(key.size());
+        }
+        ostringstream out;
+        out << fixed << setprecision(2);
+        for (const string& line : chunk.lines) {
+            string_view rest(line);
+            size_t tab = rest.find('\t');
+            string_view student = rest.substr(0, tab);
+            if (student.empty()) { chunk.rejected++; continue; }
+            rest = tab == string_view::npos ? string_view() : rest.substr(tab + 1);
+            while (!rest.empty()) {
+                tab = rest.find('\t');
+                string_view field = rest.substr(0, tab);
+                rest = tab == string_view::npos ? string_view() : rest.substr(tab + 1);
+                size_t equals = field.find('=');
+                if (equals == string_view::npos) continue;
+                int id = -1;
+                from_chars(field.data(), field.data() + equals, id);
+                int position = key.positionOf(id);
+                if (position == -1) continue;
+                if (key.packed && key.objectiveIndex[position] != -1) {
+                    codes[key.objectiveIndex[position]] = answerCode(field.substr(equals + 1), true);
+                    continue;
+                }
+                string& answer = answers[position];
+                answer.assign(field.substr(equals + 1));
+                for (auto& c : answer) c = tolower(c);
+                touched.push_back(position);
+            }
+            double sheetScore = fromFixedPoints(key.packed ? key.scorePacked(codes.data(), answers) : key.score(answers));
+            out << student << '\t' << sheetScore << '\t' << key.totalPoints << '\n';
+            if (items) {
+                for (size_t i = 0; i < key.size(); i++) {
+                    int objective = key.packed ? key.objectiveIndex[i] : -1;
+                    if (objective != -1) {
+                        responses[i] = codes[objective];
+                        right[i] = codes[objective] == key.objectiveKey[objective];
+                    } else {
+                        responses[i] = answerCode(answers[i], false);
+                        right[i] = key.isCorrect(i, answers[i]);
+                    }
+                }
+                chunk.items.addSheet(sheetScore, right.data(), responses.data());
+            }
+            for (int position : touched) answers[position].clear();
+            touched.clear();
+            if (key.packed) fill(codes.begin(), codes.end(), answerBlank);
+        }
+        chunk.output = out.str();
+    };
+
+    // Function to write out finished chunks from the front, keeping input order
+    auto flushDone = [&](bool all) {
+        unique_lock<mutex> guard(doneLock);
+        while (!inFlight.empty()) {
+            if (!inFlight.front()->done) {
+                if (!all && inFlight.size() < maxInFlight) break;
+                chunkDone.wait(guard, [&] { return inFlight.front()->done; });
+            }
+            unique_ptr<Chunk> chunk = std::move(inFlight.front());
+            inFlight.pop_front();
+            guard.unlock();
+            scores << chunk->output;
+            if (items) items->merge(chunk->items);
+            stats.sheets += chunk->lines.size() - chunk->rejected;
+            stats.rejectedLines += chunk->rejected;
+            guard.lock();
+        }
+    };
+
+    string line;
+    bool more = true;
+    while (more) {
+        auto chunk = make_unique<Chunk>();
+        chunk->lines.reserve(sheetsPerChunk);
+        while (chunk->lines.size() < sheetsPerChunk && (more = static_cast<bool>(getline(submissions, line)))) {
+            if (!line.empty()) chunk->lines.push_back(std::move(line));
+        }
+        if (chunk->lines.empty()) break;
+        Chunk* work = chunk.get();
+        {
+            lock_guard<mutex> guard(doneLock);
+            inFlight.push_back(std::move(chunk));
+        }
+        pool.submit([&, work] {
+            gradeChunk(*work);
+            lock_guard<mutex> guard(doneLock);
+            work->done = true;
+            chunkDone.notify_all();
+        });
+        flushDone(false);
+    }
+    flushDone(true);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+
+// Mergeable sketch of a score distribution, for ranking. The buckets are
+// log-linear like LatencyHistogram's but 1024 to a power of two, so a bucket
+// spans at most 0.1% of the scores in it, and each bucket also keeps the
+// lowest and highest score it has seen. Scores are sums of point values, so
+// most buckets hold a single score and rank exactly; only buckets holding
+// several are interpolated. A sketch of changes may hold negative counts (a
+// student's old best leaving), which merging adds up like any other.
+struct ScoreSketch {
+    static constexpr int subBucketBits = 10;
+    static constexpr int maxExponent = 52;  // Scores from 2^52 millionths of a point up share the last bucket
+    static constexpr size_t bucketCount = static_cast<size_t>(maxExponent - subBucketBits + 1) << subBucketBits;
+
+    vector<int64_t> counts = vector<int64_t>(bucketCount);
+    vector<FixedPoints> lows = vector<FixedPoints>(bucketCount, numeric_limits<FixedPoints>::max());
+    vector<FixedPoints> highs = vector<FixedPoints>(bucketCount, numeric_limits<FixedPoints>::min());
+    int64_t total = 0;
+
+    // Function to find the bucket holding a score; negative scores share bucket 0
+    static size_t bucketOf(FixedPoints score) {
+        uint64_t value = score < 0 ? 0 : static_cast<uint64_t>(score);
+        if (value < (1u << subBucketBits)) return value;
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent >= maxExponent) return bucketCount - 1;
+        return (static_cast<size_t>(exponent - subBucketBits + 1) << subBucketBits) +
+               (value >> (exponent - subBucketBits)) - (1u << subBucketBits);
+    }
+
+    void add(FixedPoints score, int64_t count = 1) {
+        size_t bucket = bucketOf(score);
+        counts[bucket] += count;
+        lows[bucket] = min(lows[bucket], score);
+        highs[bucket] = max(highs[bucket], score);
+        total += count;
+    }
+
+    void merge(const ScoreSketch& other) {
+        for (size_t bucket = 0; bucket < bucketCount; bucket++) {
+            if (other.lows[bucket] > other.highs[bucket]) continue;  // Never touched
+            counts[bucket] += other.counts[bucket];
+            lows[bucket] = min(lows[bucket], other.lows[bucket]);
+            highs[bucket] = max(highs[bucket], other.highs[bucket]);
+        }
+        total += other.total;
+    }
+};
+
+
+// A student and their best score
+struct LeaderboardEntry {
+    string student;
+    FixedPoints score;
+};
+
+// Where a student stands among everyone's best scores
+struct Standing {
+    double score = 0.0;       // The student's best score
+    uint64_t rank = 0;        // 1 + students with a higher best score; ties share a rank
+    double percentile = 0.0;  // Percent of students below, counting those tied as half
+};
+
+
+// The best few students, one entry each. Entries are kept unordered and
+// weakest indexes the one the next better student replaces. Ties go to the
+// lower student id, so every way of splitting the input gives the same list.
+class TopScores {
+private:
+    size_t capacity;
+    vector<LeaderboardEntry> entries;
+    size_t weakest = 0;
+
+    static bool ranksAbove(FixedPoints score, string_view student, const LeaderboardEntry& other) {
+        return score != other.score ? score > other.score : student < other.student;
+    }
+
+    void findWeakest() {
+        weakest = 0;
+        for (size_t i = 1; i < entries.size(); i++) {
+            if (ranksAbove(entries[weakest].score, entries[weakest].student, entries[i])) weakest = i;
+        }
+    }
+
+public:
+    explicit TopScores(size_t count) : capacity(count) {}
+
+    // Function to consider a student's score, keeping only their best
+    void offer(string_view student, FixedPoints score) {
+        if (capacity == 0) return;
+        if (entries.size() == capacity && !ranksAbove(score, student, entries[weakest])) return;
+        for (LeaderboardEntry& entry : entries) {
+            if (entry.student != student) continue;
+            if (score > entry.score) {
+                entry.score = score;
+                findWeakest();
+            }
+            return;
+        }
+        if (entries.size() < capacity) entries.push_back({string(student), score});
+        else entries[weakest] = {string(student), score};
+        findWeakest();
+    }
+
+    void merge(const TopScores& other) {
+        for (const LeaderboardEntry& entry : other.entries) offer(entry.student, entry.score);
+    }
+
+    size_t size() const { return capacity; }
+
+    // Function to list the entries best first
+    vector<LeaderboardEntry> sorted() const {
+        vector<LeaderboardEntry> list = entries;
+        sort(list.begin(), list.end(), [](const LeaderboardEntry& a, const LeaderboardEntry& b) {
+            return ranksAbove(a.score, a.student, b);
+        });
+        return list;
+    }
+};
+
+
+// Live ranking of graded attempts, where each student stands by their best
+// attempt. Attempts come in through Writers, one per ingesting thread: a
+// writer checks the student against one of 64 locked shards of best scores
+// and keeps its own sketch of the changes and its own top list, which
+// flush() merges in under one lock. Queries read the merged sketch through
+// a table of how many students lie below each bucket, rebuilt the first
+// time it is needed after a flush, so ranking a student costs a shard lookup
+// and a few array reads however many attempts have come in.
+class Leaderboard {
+private:
+    struct Shard {
+        mutable mutex lock;
+        unordered_map<string, FixedPoints> best;  // Student -> best score so far
+    };
+    static const size_t shardCount = 64;
+
+    Shard shards[shardCount];
+    mutable mutex lock;              // Guards everything below
+    ScoreSketch sketch;              // Every student once, at their best score
+    TopScores top;
+    uint64_t attemptCount = 0;
+    mutable vector<int64_t> below;   // below[b]: students in buckets before b; empty once stale
+
+    static size_t shardOf(string_view student) { return hash<string_view>()(student) % shardCount; }
+
+    // Function to make an attempt the student's best if it is; previous gets the best it replaces
+    bool improve(string_view student, FixedPoints score, FixedPoints& previous, bool& hadPrevious) {
+        Shard& shard = shards[shardOf(student)];
+        thread_local string key;
+        key.assign(student);
+        lock_guard<mutex> guard(shard.lock);
+        auto found = shard.best.find(key);
+        hadPrevious = found != shard.best.end();
+        if (!hadPrevious) {
+            shard.best.emplace(key, score);
+            return true;
+        }
+        if (score <= found->second) return false;
+        previous = found->second;
+        found->second = score;
+        return true;
+    }
+
+    // Function to rebuild the table of students below each bucket if it is stale; lock must be held
+    void refreshBelow() const {
+        if (!below.empty()) return;
+        below.resize(ScoreSketch::bucketCount + 1);
+        below[0] = 0;
+        for (size_t bucket = 0; bucket < ScoreSketch::bucketCount; bucket++) {
+            below[bucket + 1] = below[bucket] + sketch.counts[bucket];
+        }
+    }
+
+public:
+    // Batch of attempts recorded by one thread; merged into the leaderboard by flush() or on destruction
+    class Writer {
+    private:
+        Leaderboard& board;
+        ScoreSketch changes;
+        TopScores top;
+        uint64_t attempts = 0;
+
+    public:
+        explicit Writer(Leaderboard& leaderboard) : board(leaderboard), top(leaderboard.top.size()) {}
+        ~Writer() { flush(); }
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void record(string_view student, FixedPoints score) {
+            attempts++;
+            FixedPoints previous = 0;
+            bool hadPrevious = false;
+            if (!board.improve(student, score, previous, hadPrevious)) return;
+            if (hadPrevious) changes.add(previous, -1);
+            changes.add(score);
+            top.offer(student, score);
+        }
+
+        void flush() {
+            if (attempts == 0) return;
+            {
+                lock_guard<mutex> guard(board.lock);
+                board.sketch.merge(changes);
+                board.top.merge(top);
+                board.attemptCount += attempts;
+                board.below.clear();
+            }
+            changes = ScoreSketch();
+            top = TopScores(board.top.size());
+            attempts = 0;
+        }
+    };
+
+    explicit Leaderboard(size_t topCount = 10) : top(topCount) {}
+
+    // Function to read graded attempts, "student<TAB>score" lines as gradeBatch() writes them,
+    // on the pool's threads, a block of whole lines per task; returns the number of lines
+    // that were not an attempt
+    size_t ingest(istream& attempts, WorkStealingPool& pool, size_t bytesPerChunk = 1 << 20) {
+        atomic<size_t> rejected{0};
+        auto submit = [this, &pool, &rejected](string&& text) {
+            auto chunk = make_shared<string>(std::move(text));
+            pool.submit([this, &rejected, chunk] {
+                Writer writer(*this);
+                string_view lines(*chunk);
+                while (!lines.empty()) {
+                    size_t end = lines.find('\n');
+                    string_view line = lines.substr(0, end);
+                    lines = end == string_view::npos ? string_view() : lines.substr(end + 1);
+                    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                    if (line.empty()) continue;
+                    size_t tab = line.find('\t');
+                    string_view student = line.substr(0, tab);
+                    string_view field = tab == string_view::npos ? string_view() : line.substr(tab + 1);
+                    field = field.substr(0, field.find('\t'));
+                    double score = 0;
+                    auto parsed = from_chars(field.data(), field.data() + field.size(), score);
+                    if (student.empty() || field.empty() || parsed.ec != errc() || parsed.ptr != field.data() + field.size() ||
+                        !(score >= 0 && score <= 1e12)) {  // Bounded to stay well inside FixedPoints
+                        rejected++;
+                        continue;
+                    }
+                    writer.record(student, toFixedPoints(score));
+                }
+            });
+        };
+        string carry;  // Start of a line cut off by the previous block
+        size_t inFlight = 0;
+        while (attempts) {
+            string block = std::move(carry);
+            size_t kept = block.size();
+            block.resize(kept + bytesPerChunk);
+            attempts.read(&block[kept], bytesPerChunk);
+            block.resize(kept + attempts.gcount());
+            size_t lastNewline = block.rfind('\n');
+            carry = lastNewline == string::npos ? std::move(block) : block.substr(lastNewline + 1);
+            if (lastNewline == string::npos) continue;
+            block.resize(lastNewline + 1);
+            submit(std::move(block));
+            if (++inFlight == 2 * pool.size()) {  // Bound how much input is held at once
+                pool.wait();
+                inFlight = 0;
+            }
+        }
+        if (!carry.empty()) submit(std::move(carry));
+        pool.wait();
+        return rejected;
+    }
+
+    // Function to find where a student stands; false if they have no attempts
+    bool standing(string_view student, Standing& result) const {
+        const Shard& shard = shards[shardOf(student)];
+        FixedPoints score;
+        {
+            thread_local string key;
+            key.assign(student);
+            lock_guard<mutex> guard(shard.lock);
+            auto found = shard.best.find(key);
+            if (found == shard.best.end()) return false;
+            score = found->second;
+        }
+        lock_guard<mutex> guard(lock);
+        refreshBelow();
+        size_t bucket = ScoreSketch::bucketOf(score);
+        double total = static_cast<double>(sketch.total), inBucket = static_cast<double>(sketch.counts[bucket]);
+        double lower = static_cast<double>(below[bucket]), tied = inBucket;
+        if (sketch.lows[bucket] != sketch.highs[bucket]) {
+            // Several scores share the bucket: place the others in it evenly between its ends
+            double at = static_cast<double>(score - sketch.lows[bucket]) / static_cast<double>(sketch.highs[bucket] - sketch.lows[bucket]);
+            lower += (inBucket - 1) * min(1.0, max(0.0, at));
+            tied = 1;
+        }
+        result.score = fromFixedPoints(score);
+        result.rank = 1 + static_cast<uint64_t>(llround(max(0.0, total - lower - tied)));
+        result.percentile = total > 0 ? 100 * (lower + tied / 2) / total : 0.0;
+        return true;
+    }
+
+    // Function to estimate the best score below which a fraction q of students lie
+    double quantile(double q) const {
+        lock_guard<mutex> guard(lock);
+        if (sketch.total <= 0) return 0.0;
+        refreshBelow();
+        int64_t rank = max<int64_t>(1, static_cast<int64_t>(ceil(q * sketch.total)));
+        size_t bucket = lower_bound(below.begin() + 1, below.end(), rank) - below.begin() - 1;
+        bucket = min(bucket, ScoreSketch::bucketCount - 1);
+        FixedPoints low = sketch.lows[bucket], high = sketch.highs[bucket];
+        if (low >= high) return fromFixedPoints(low);
+        double at = static_cast<double>(rank - below[bucket]) / static_cast<double>(sketch.counts[bucket]);
+        return fromFixedPoints(low) + at * (fromFixedPoints(high) - fromFixedPoints(low));
+    }
+
+    // Function to list the best students, best first
+    vector<LeaderboardEntry> leaders() const {
+        lock_guard<mutex> guard(lock);
+        return top.sorted();
+    }
+
+    uint64_t students() const {
+        lock_guard<mutex> guard(lock);
+        return static_cast<uint64_t>(sketch.total);
+    }
+
+    uint64_t attempts() const {
+        lock_guard<mutex> guard(lock);
+        return attemptCount;
+    }
+};
+
+
+// Function to grade one answer against the key of a slot's question
+bool isCorrectAnswer(const QuestionStore& questions, int slot, string_view answer) {
+    return visitType(questions.type(slot), [&](auto type) {
+        using Type = decltype(type);
+        if constexpr (is_same_v<typename Type::Key, string>) return Type::grade(questions.correctAnswer(slot), answer);
+        else {
+            if constexpr (is_same_v<Type, WrType>) {
+                if (const WrKey* compiled = questions.compiledKey(slot)) return Type::grade(*compiled, answer);
+            }
+            return Type::grade(Type::compile(questions.correctAnswer(slot)), answer);
+        }
+    });
+}
+
+// Function to compile a store's written-response keys once for grading; unchanged pages are skipped
+void compileAnswerKeys(QuestionStore& questions) {
+    questions.compileKeys([](string_view key) { return make_shared<const WrKey>(WrType::compile(key)); });
+}
+
+// Function to grade every answer on a sheet; the result is also kept in sheet.score
+FixedPoints gradeSheet(const QuestionStore& questions, AnswerSheet& sheet) {
+    METRIC_TIME(submit);
+    METRIC_COUNT(submits);
+    sheet.score = 0;
+    for (int slot = questions.nextLive(0); slot != -1; slot = questions.nextLive(slot + 1)) {
+        if (isCorrectAnswer(questions, slot, sheet.answer(questions, slot))) sheet.score += questions.points(slot);
+    }
+    return sheet.score;
+}
+
+// Function to append text to a protocol line; tabs and line breaks (imported text can
+// hold them) would split the line, so they are sent as spaces
+void appendProtocolText(string& line, string_view text) {
+    size_t start = line.size();
+    line += text;
+    for (size_t i = start; i < line.size(); i++) {
+        if (line[i] == '\t' || line[i] == '\n' || line[i] == '\r') line[i] = ' ';
+    }
+}
+
+// Function to render a question as one protocol line: "Q id<TAB>type<TAB>text<TAB>A. choice..."
+bool renderQuestion(const QuestionStore& questions, int id, string& line) {
+    METRIC_TIME(displayQuestion);
+    int slot = questions.slotOf(id);
+    if (slot == -1) return false;
+    METRIC_COUNT(questionsDisplayed);
+    const Question& question = questions.row(slot);
+    thread_local string scratch;
+    line = "Q " + to_string(id) + '\t' + kindName(questions.type(slot)) + '\t';
+    appendProtocolText(line, question.text(questions.strings(), scratch));
+    for (int i = 0; i < question.choiceCount; i++) {
+        line += '\t';
+        line += question.choiceLetter(i);
+        line += ". ";
+        appendProtocolText(line, question.choiceText(questions.strings(), i));
+    }
+    return true;
+}
+
+
+// Time limits for a sitting; a zero limit means untimed
+struct ExamTiming {
+    chrono::milliseconds exam{0};         // From the start of the sitting to automatic submission
+    chrono::milliseconds question{0};     // Total time each question may be on screen before it closes
+    chrono::milliseconds warning{60000};  // Warn this long before either limit runs out
+
+    bool timed() const { return exam.count() > 0 || question.count() > 0; }
+};
+
+
+// Class representing the quiz and containing operations to manage questions
+class Quiz {
+private:
+    QuestionStore store;        // Contiguous storage of the quiz's questions
+    TextIndex textIndex;        // Search index over question and choice text
+    NearDuplicateIndex duplicates; // MinHash signatures for checking new questions, built on first use
+    AnswerSheet attempt;        // Answers of the attempt taken through the menu
+    int questionCount;          // Counter for the number of questions in the quiz
+    FixedPoints totalPoints;    // Sum of all points for all questions
+    EditJournal* journal = nullptr; // Where changes are recorded, if authoring is journaled
+    ExamTiming timing;          // Limits for conductQuiz(); the console enforces the exam limit
+    chrono::steady_clock::time_point examDue;  // When the sitting under way runs out of time
+    bool examWarned = false;    // The warning for the sitting under way has been shown
+    bool timeUp = false;        // The sitting ran out of time and is submitted without asking
+
+    friend struct QuizBenchmark; // Benchmarks time the private lookup and scan helpers
+
+public:
+    // Constructor initializing the quiz with no questions
+    Quiz() : questionCount(0), totalPoints(0) {}
+    bool errorMessage = false;
+    static constexpr const char* journalFailedMessage = "edit journal write failed; the change is not saved";
+    // Function to set the time limits of the next conductQuiz(). Timed sittings need
+    // ios::sync_with_stdio(false) called before any console I/O, or awaitInput() cannot
+    // see lines cin has already buffered.
+    void setTiming(const ExamTiming& limits) {
+        timing = limits;
+    }
+    double getScore() {
+        return fromFixedPoints(attempt.score);
+    }
+    // Function to clear the input stream, handling input errors
+    void clearInput() {
+        cin.clear();
+        if (cin.peek() == '\n') {
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+    }
+    //check if no questions submitted
+    bool check1() {
+        if(questionCount == 0) {
+            cout << "Warning - the number of questions to be asked must equal to or be larger than 1." << endl;
+            return false;
+        }
+        return true;
+    }
+    //check the question store was emptied;
+    bool check2() {
+       if(!check1()) {
+           if(store.empty()) {
+               cout << "[Question store empty]" << endl;
+               return false;
+           }
+           cout << "[Question store not empty]" << endl;
+           return true;
+
+       }
+        return true;
+    }
+
+private:
+    // Helper function to get validated input from the user; the word typed is
+    // lowercased for case-insensitive comparison before valid() checks it
+    template <typename Valid>
+    string getInput(const string& prompt, Valid valid) {
+        string input;
+        while (true) {
+            cout << prompt;
+            cin >> input;
+            clearInput();
+
+            for (auto& c : input) c = tolower(c);
+            if (valid(input)) {
+                return input;
+            }
+
+            cout << "[Invalid input, please try again!]" << endl;
+        }
+    }
+
+    // Function to ask for a question type by name
+    QuestionKind getKindInput() {
+        QuestionKind kind = QuestionKind::mcq;
+        getInput("Type of question [" + kindChoices() + "]: ", [&kind](string_view name) { return parseKind(name, kind); });
+        return kind;
+    }
+
+    // Function to ask for a correct answer until it is one the question's type accepts
+    string getKeyInput(QuestionKind kind, const char* prompt) {
+        string input, key;
+        while (true) {
+            cout << prompt;
+            getline(cin, input);  // Whole line, so written responses keep every word
+            normalizeKey(kind, input, key);
+            if (validKey(kind, key)) return key;
+            cout << "[Invalid input, please try again!]" << endl;
+        }
+    }
+
+    // Function to wait for the taker to type, warning once as the exam's time limit
+    // nears; false once its time is up. Untimed sittings never wait here.
+    bool awaitInput() {
+        if (timeUp) return false;
+        if (timing.exam.count() == 0) return true;
+        while (true) {
+            auto now = chrono::steady_clock::now();
+            if (now >= examDue) {  // Before looking at input, so nothing typed after the deadline counts
+                timeUp = true;
+                cout << "\n[Time is up - submitting your answers]" << endl;
+                return false;
+            }
+            // Typed-ahead input can already sit in cin's buffer, where poll() cannot see it. That buffer
+            // only exists once cin is no longer synced with stdio, which timed sittings arrange.
+            if (cin.rdbuf()->in_avail() > 0) return true;
+            auto wake = examDue;
+            if (!examWarned && now >= examDue - timing.warning) {
+                examWarned = true;
+                cout << "\n[Time is nearly up: " << chrono::ceil<chrono::seconds>(examDue - now).count() << " s left] " << flush;
+            } else if (!examWarned) {
+                wake = examDue - timing.warning;
+            }
+            pollfd input{STDIN_FILENO, POLLIN, 0};
+            if (poll(&input, 1, static_cast<int>(chrono::ceil<chrono::milliseconds>(wake - now).count())) > 0) return true;
+        }
+    }
+
+    // Modified getInput function to handle integer actions
+    int getActionInput(const string& prompt) {
+        string input;
+        int action;
+        while (true) {
+            cout << prompt;
+            getline(cin, input);  // Use getline to avoid newline issues
+            try {
+                action = stoi(input);  // Convert string to integer
+                return action;
+            } catch (const invalid_argument&) {
+                cout << "[Unknown input, please try again]" << endl;
+            }
+        }
+    }
+
+    // Helper function to get a validated point value for the question
+    double getPointsInput() {
+        double points;
+        while (true) {
+            cout << "Enter point value: ";
+            cin >> points;
+            if (!cin.fail() && points >= 0 && points <= maxQuestionPoints) break;
+            cout << "[Invalid input, please try again!]" << endl;
+            clearInput();
+        }
+        clearInput();
+        return points;
+    }
+
+    // Function to count a question filled in at the end of the store; a bulk
+    // append leaves indexing to indexQuestions()
+    void addQuestionNode(int slot, bool indexText = true) {
+        questionCount++;            // Increment question count
+        totalPoints += store.points(slot);  // Add to total points
+        if (indexText) indexQuestion(slot);
+    }
+
+    // Function to index a question's text for search and near-duplicate checks
+    void indexQuestion(int slot) {
+        textIndex.add(store, slot);
+        duplicates.add(store, slot);
+    }
+
+    // Function to take a question's text out of the indexes, e.g. before it changes
+    void unindexQuestion(int slot) {
+        textIndex.remove(store, slot);
+        duplicates.remove(as_const(store).row(slot).id);
+    }
+
+    // Function to journal a question's new state; interactive edits wait until it is on disk.
+    // Returns false if the change cannot be made durable because the journal has failed.
+    bool journalPut(int slot, bool waitDurable = false) {
+        if (!journal) return true;
+        uint64_t sequence = journal->put(store, slot);
+        return waitDurable ? journal->waitDurable(sequence) : !journal->hasFailed();
+    }
+
+    // Function to journal a deleted question; false if the journal has failed
+    bool journalErase(int id, bool waitDurable = false) {
+        if (!journal) return true;
+        uint64_t sequence = journal->erase(id);
+        return waitDurable ? journal->waitDurable(sequence) : !journal->hasFailed();
+    }
+
+    // Function to drop every question and answer
+    void reset() {
+        store.clear();
+        textIndex.clear();
+        duplicates.clear();
+        attempt.clear();
+        questionCount = 0;
+        totalPoints = 0;
+    }
+
+    // Function to replay one journaled change, without journaling it again
+    void applyJournalRecord(const JournalRecord& record) {
+        if (record.kind == JournalRecord::clear) {
+            reset();
+            return;
+        }
+        int slot = store.slotOf(record.id);
+        if (record.kind == JournalRecord::erase) {
+            if (slot != -1) removeQuestion(record.id);
+            return;
+        }
+        QuestionKind kind;
+        if (!parseKind(record.type, kind) || !(record.points >= 0 && record.points <= maxQuestionPoints) ||
+            !validItemParameters(record.parameters)) {
+            return;  // Not a question this build can grade
+        }
+        bool created = slot == -1;
+        if (created) {
+            slot = store.emplace(record.id);
+        } else {
+            unindexQuestion(slot);
+            totalPoints -= store.points(slot);
+        }
+        Question& question = store.row(slot);
+        store.type(slot) = kind;
+        question.setText(store.strings(), record.text);
+        store.setCorrectAnswer(slot, record.answer);
+        store.points(slot) = toFixedPoints(record.points);
+        store.parameters(slot) = record.parameters;
+        question.resetAnswers();
+        for (uint32_t i = 0; i < record.choiceCount; i++) question.addChoice(store.strings(), record.choices[i]);
+        if (created) {
+            addQuestionNode(slot);
+        } else {
+            totalPoints += store.points(slot);
+            indexQuestion(slot);
+        }
+    }
+
+    // Function to build a journal snapshot from an older one and the journals written since
+    static bool compactJournal(const string& snapshotIn, const vector<string>& journals, const string& snapshotOut) {
+        Quiz scratch;
+        if (!snapshotIn.empty() && !scratch.open(snapshotIn)) return false;
+        for (const string& path : journals) {
+            EditJournal::replay(path, [&scratch](const JournalRecord& record) { scratch.applyJournalRecord(record); });
+        }
+        return scratch.save(snapshotOut);
+    }
+
+    // Function to retrieve the slot of a question by its ID
+    int getQuestionById(int id) {
+        METRIC_COUNT(lookups);
+        METRIC_TIME_SAMPLED(getQuestionById);
+        int slot = store.slotOf(id);  // -1 if question not found
+        if (slot == -1) METRIC_COUNT(lookupMisses);
+        return slot;
+    }
+
+    // Function to read a question id. Anything other than a number is taken as
+    // a search: the best matches are listed and the id is asked for again.
+    int readQuestionId() {
+        string entry;
+        if (!awaitInput() || !(cin >> entry)) return -1;
+        int id = -1;
+        auto parsed = from_chars(entry.data(), entry.data() + entry.size(), id);
+        if (parsed.ec == errc() && parsed.ptr == entry.data() + entry.size()) return id;
+        if (entry == "quit()") return -1;
+        string rest;
+        getline(cin, rest);
+        vector<int> matches = searchQuestions(entry + rest, 10);
+        if (matches.empty()) {
+            cout << "[No matching questions]" << endl;
+            return -1;
+        }
+        for (int match : matches) cout << "  " << match << ": " << as_const(store).row(store.slotOf(match)).text(store.strings()) << endl;
+        cout << "Select a question id: ";
+        return readQuestionId();
+    }
+
+
+    // Function to collect lettered answer choices until quit() or Z
+    void readChoices(int slot) {
+        Question& question = store.row(slot);
+        string choice;
+        for (char option = 'A'; option <= 'Z'; ++option) {
+            cout << "Enter choice " << option << ": ";
+            getline(cin, choice);
+            if (choice == "quit()") break;
+            question.addChoice(store.strings(), choice);
+        }
+    }
+
+    // Function to create a question of one type: its text, its choices if the
+    // type has them, then a correct answer the type accepts and a point value
+    template <typename Type>
+    void createQuestionOfType(int slot) {
+        Question& question = store.row(slot);
+        store.type(slot) = Type::kind;
+        cout << "Enter a question: ";
+        string text;
+        getline(cin, text);
+        question.setText(store.strings(), text);
+        if constexpr (Type::hasChoices) readChoices(slot);
+
+        // Get the correct answer and point value
+        store.setCorrectAnswer(slot, getKeyInput(Type::kind, Type::keyPrompt));
+        store.points(slot) = toFixedPoints(getPointsInput());
+        cout << "Question saved." << endl;
+    }
+
+    // Function to print a question's lettered answer choices
+    void printChoices(int slot) {
+        const Question& question = as_const(store).row(slot);
+        const StringPool& pool = as_const(store).strings();
+        for (int i = 0; i < question.choiceCount; i++) {
+            std::cout << question.choiceLetter(i) << ". " << question.choiceText(pool, i) << std::endl;
+        }
+    }
+
+    // Function to edit an existing question's properties
+    void editQuestion(int slot) {
+        Question& question = store.row(slot);
+        unindexQuestion(slot);  // Re-indexed once editing is done
+        cout << "===============================\n";
+        cout << "=== QUESTION " << question.id << " SAVED VALUES ===\n";
+        cout << "===============================\n";
+        cout << "1. Type: " << kindName(store.type(slot)) << "\n";
+        cout << "2. Question: " << question.text(store.strings()) << "\n";
+
+        // Display choices if the question's type has them
+        if (kindHasChoices(store.type(slot))) {
+            cout << "3. Answer choices:\n";
+            printChoices(slot);
+            cout << "4. Correct answer: " << store.correctAnswer(slot) << "\n";
+        } else {
+            cout << "3. Correct answer: " << store.correctAnswer(slot) << "\n";
+        }
+
+        // Edit specific properties based on user input
+        int option;
+        do {
+            cout << "Type a number to edit, or type -1 to quit: ";
+            if (!(cin >> option)) { clearInput(); option = -1; }
+            clearInput();
+            QuestionKind kind = store.type(slot);
+            switch (option) {
+                case 1: {
+                    kind = getKindInput();
+                    store.type(slot) = kind;
+                    // Keep what still fits the new type and ask again for what does not
+                    if (!kindHasChoices(kind)) question.resetAnswers();
+                    else if (question.choiceCount == 0) readChoices(slot);
+                    string key;
+                    normalizeKey(kind, as_const(store).correctAnswer(slot), key);
+                    store.setCorrectAnswer(slot, validKey(kind, key) ? key : getKeyInput(kind, keyPrompt(kind)));
+                    break;
+                }
+                case 2: {
+                    cout << "Enter a new question: ";
+                    string text;
+                    getline(cin, text);
+                    question.setText(store.strings(), text);
+                break;
+                }
+                case 3:
+                    if (kindHasChoices(kind)) {
+                        question.resetAnswers();
+                        readChoices(slot);
+                    } else {
+                        store.setCorrectAnswer(slot, getKeyInput(kind, "Enter correct answer: "));
+                    }
+                break;
+                case 4:
+                    if (kindHasChoices(kind)) {
+                        store.setCorrectAnswer(slot, getKeyInput(kind, keyPrompt(kind)));
+                    }
+                break;
+                default:
+                    if (option != -1) cout << "[Unknown option, please try again]" << endl;
+            }
+        } while (option != -1);
+        indexQuestion(slot);
+        if (!journalPut(slot, true)) cout << "[" << journalFailedMessage << "]" << endl;
+    }
+
+    // Function to delete a question by its ID
+    void deleteQuestion(int id) {
+        // Look up the question to delete
+        int slot = getQuestionById(id);
+
+        // Handle case where question is not found
+        if (slot == -1) {
+            cout << "[Question not found]" << endl;
+            return;
+        }
+
+        // Remove question from the store
+        totalPoints -= store.points(slot);
+        attempt.forget(id);
+        unindexQuestion(slot);
+        store.erase(slot);
+        questionCount--;
+        if (!journalErase(id, true)) {
+            cout << "[" << journalFailedMessage << "]" << endl;
+            return;
+        }
+        cout << "Question " << id << " deleted." << endl;
+    }
+
+    void displayQuestion(int slot) {
+        {
+            METRIC_TIME(displayQuestion);
+            METRIC_COUNT(questionsDisplayed);
+            const Question& question = as_const(store).row(slot);
+            cout << "Question " << question.id << ": " << question.text(store.strings()) << endl;
+            if(kindHasChoices(as_const(store).type(slot))) {
+                //if mcq or multi, must also display the answer choices
+
+                printChoices(slot);
+                /*
+                for(const auto& choice : question -> choices) {
+                    cout << choice << endl;
+                }*/
+            }
+        }
+        string answer;
+        cout << "Your answer" << visitType(as_const(store).type(slot), [](auto type) { return decltype(type)::answerHint; }) << ": ";
+        [[maybe_unused]] auto shownAt = chrono::steady_clock::now();  // Think time runs while the taker types
+        if (!awaitInput()) return;
+        clearInput();  // Drop the newline left behind by the action or id prompt
+        getline(cin, answer);  // Whole line, so written responses keep every word
+        METRIC_RECORD(thinkTime, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - shownAt).count());
+        // Convert input to lowercase for case-insensitive comparison
+        for (auto& c : answer) c = tolower(c);
+        attempt.setAnswer(store, slot, answer);
+
+    }
+
+    bool allQuestionAnswer() {
+        return attempt.unansweredCount(store) == 0;  // The sheet keeps a running count of answers
+    }
+
+    //return the slot of the next unanswered question, -1 if there is none
+    int getNextUnansweredQuestion() {
+        return attempt.firstUnanswered(store);
+    }
+
+    // Function to grade the recorded answer of one question
+    bool answerIsCorrect(int slot) {
+        return isCorrectAnswer(store, slot, attempt.answer(store, slot));
+    }
+
+public:
+    void auto_createQuestion(bool correct, bool answered) {
+        int slot = store.emplace(1);
+        Question& newQuestion = store.row(slot);
+        store.type(slot) = QuestionKind::wr;
+        newQuestion.setText(store.strings(), "How long was the shortest war on record?");
+        store.setCorrectAnswer(slot, "38");
+        store.points(slot) = toFixedPoints(100);
+        if (correct && answered) {
+            attempt.setAnswer(store, slot, "38");
+        }
+        else if (answered) {
+            attempt.setAnswer(store, slot, "85");
+        }
+        addQuestionNode(slot);
+
+    }
+    // Public interface for creating a question based on type
+    void createQuestion() {
+        int slot = store.emplace();
+        cout << "=== Question " << store.row(slot).id << " ===" << endl;
+
+        QuestionKind kind = getKindInput();
+        visitType(kind, [this, slot](auto type) { createQuestionOfType<decltype(type)>(slot); });
+        addQuestionNode(slot);
+        if (!journalPut(slot, true)) cout << "[" << journalFailedMessage << "]" << endl;
+        for (const DuplicateMatch& match : similarQuestions(as_const(store).row(slot).id)) {
+            cout << "[Similar to question " << match.id << ": " << lround(match.similarity * 100) << "% alike]" << endl;
+        }
+    }
+
+    // Public interface to edit an existing question
+    void editQuestion() {
+        int id;
+        cout << "Select a question to edit, or type quit() or search words [" << 1 << "-" << questionCount << "]: ";
+        id = readQuestionId();
+        int slot = getQuestionById(id);
+        if (slot != -1) editQuestion(slot);
+        else cout << "[Question not found]" << endl;
+    }
+
+    // Public interface to delete a question by its ID
+    void deleteQuestion() {
+        int id;
+        cout << "Select a question to delete [" << 1 << "-" << questionCount << "]: ";
+        cin >> id;
+        deleteQuestion(id);
+    }
+
+    // Public interface to delete all questions
+    void deleteQuestionTest() {
+        store.clear();
+        textIndex.clear();
+        duplicates.clear();
+        attempt.clear();
+        questionCount = 0;
+        if (journal) journal->clear();
+    }
+
+
+    // Displays a summary log of the quiz session
+    void displaySessionLog() {
+        cout << "=== SESSION LOG ===" << endl;
+        cout << "Total questions: " << questionCount << endl;
+        cout << fixed << setprecision(2) << "Total point values: " << fromFixedPoints(totalPoints) << endl;
+    }
+
+    // Non-interactive interface, used by the script driver. Each call applies
+    // the same validation as the matching prompt and reports failures through
+    // its return value (and error, where there is more than one reason).
+
+    // Function to check a question against the create prompts' rules; the answer must
+    // already be in its type's normalized form. Returns nullptr if it is valid, otherwise
+    // what is wrong with it
+    static const char* questionProblem(QuestionKind kind, string_view correctAnswer, double points, size_t choiceCount) {
+        if (!validKey(kind, correctAnswer)) return "invalid correct answer";
+        if (!(points >= 0 && points <= maxQuestionPoints)) return "invalid point value";
+        if (kindHasChoices(kind) && choiceCount > Question::maxChoices) return "too many choices";
+        return nullptr;
+    }
+
+    // Function to append a question that questionProblem() has passed; returns its id.
+    // With indexText false it is not searchable until indexQuestions() is called.
+    int appendQuestion(QuestionKind kind, string_view text, const string_view* choices, size_t choiceCount,
+                       string_view correctAnswer, double points, bool indexText = true) {
+        int slot = store.emplace();
+        Question& question = store.row(slot);
+        store.type(slot) = kind;
+        question.setText(store.strings(), text);
+        if (kindHasChoices(kind)) {
+            for (size_t i = 0; i < choiceCount; i++) question.addChoice(store.strings(), choices[i]);
+        }
+        store.setCorrectAnswer(slot, correctAnswer);
+        store.points(slot) = toFixedPoints(points);
+        addQuestionNode(slot, indexText);
+        journalPut(slot);
+        return question.id;
+    }
+
+    // Function to index questions appended without indexing, all at once on the pool
+    void indexQuestions(const vector<int>& ids, WorkStealingPool& pool) {
+        vector<int> slots;
+        slots.reserve(ids.size());
+        for (int id : ids) {
+            int slot = store.slotOf(id);
+            if (slot != -1) slots.push_back(slot);
+        }
+        textIndex.addAll(store, slots, pool);
+        duplicates.addAll(store, slots, pool);
+    }
+
+    // Function to make room for count more questions, e.g. before a bulk import
+    void reserveQuestions(size_t count) {
+        store.reserve(store.slotCount() + count);
+    }
+
+    // Function to add a fully specified question; returns its id, or -1 with error set
+    int addQuestion(string type, const string& text, const vector<string>& choices,
+                    const string& correctAnswer, double points, string& error) {
+        for (auto& c : type) c = tolower(c);
+        QuestionKind kind;
+        if (!parseKind(type, kind)) {
+            error = "invalid question type";
+            return -1;
+        }
+        string key;
+        normalizeKey(kind, correctAnswer, key);
+        if (const char* problem = questionProblem(kind, key, points, choices.size())) {
+            error = problem;
+            return -1;
+        }
+        if (!journalWorking()) {
+            error = journalFailedMessage;
+            return -1;
+        }
+        vector<string_view> choiceViews(choices.begin(), choices.end());
+        int id = appendQuestion(kind, text, choiceViews.data(), choiceViews.size(), key, points);
+        if (!journalWorking()) {
+            error = journalFailedMessage;  // Added here, but lost if the process stops
+            return -1;
+        }
+        return id;
+    }
+
+    // Function to change one field (type, text, choices or answer) the way editQuestion() does,
+    // or set the IRT parameters ("irt" with discrimination, difficulty and optionally guessing)
+    bool setQuestionField(int id, const string& field, const vector<string>& values, string& error) {
+        int slot = getQuestionById(id);
+        if (slot == -1) { error = "question not found"; return false; }
+        if (values.empty() && field != "choices") { error = "missing value"; return false; }
+        if (!journalWorking()) { error = journalFailedMessage; return false; }
+        Question& question = store.row(slot);
+        if (field == "type") {
+            string name = values[0], key;
+            for (auto& c : name) c = tolower(c);
+            QuestionKind kind;
+            if (!parseKind(name, kind)) { error = "invalid question type"; return false; }
+            normalizeKey(kind, as_const(store).correctAnswer(slot), key);
+            if (!validKey(kind, key)) { error = "correct answer does not fit " + name; return false; }
+            store.type(slot) = kind;
+            store.setCorrectAnswer(slot, key);
+            if (!kindHasChoices(kind) && question.choiceCount > 0) {
+                unindexQuestion(slot);
+                question.resetAnswers();
+                indexQuestion(slot);
+            }
+        }
+        else if (field == "answer") {
+            string key;
+            normalizeKey(store.type(slot), values[0], key);
+            if (!validKey(store.type(slot), key)) { error = "invalid correct answer"; return false; }
+            store.setCorrectAnswer(slot, key);
+        }
+        else if (field == "text") {
+            unindexQuestion(slot);
+            question.setText(store.strings(), values[0]);
+            indexQuestion(slot);
+        }
+        else if (field == "choices" && kindHasChoices(store.type(slot)) && values.size() <= Question::maxChoices) {
+            unindexQuestion(slot);
+            question.resetAnswers();
+            for (const string& choice : values) question.addChoice(store.strings(), choice);
+            indexQuestion(slot);
+        }
+        else if (field == "irt" && values.size() <= 3) {
+            double numbers[3] = {1, 0, 0};
+            for (size_t i = 0; i < values.size(); i++) {
+                const char* first = values[i].data();
+                auto parsed = from_chars(first, first + values[i].size(), numbers[i]);
+                if (parsed.ec != errc() || parsed.ptr != first + values[i].size()) { error = "invalid IRT parameters"; return false; }
+            }
+            ItemParameters parameters;
+            parameters.discrimination = static_cast<float>(numbers[0]);
+            parameters.difficulty = static_cast<float>(numbers[1]);
+            parameters.guessing = static_cast<float>(numbers[2]);
+            if (!validItemParameters(parameters)) { error = "invalid IRT parameters"; return false; }
+            store.parameters(slot) = parameters;
+        }
+        else { error = "cannot edit " + field; return false; }
+        if (!journalPut(slot)) { error = journalFailedMessage; return false; }
+        return true;
+    }
+
+    // Function to list the questions at least threshold alike to question id, most alike first.
+    // The first call signs every question; the index is kept up to date from then on.
+    vector<DuplicateMatch> similarQuestions(int id, double threshold = 0.8, size_t limit = 5) {
+        if (!duplicates.isEnabled()) duplicates.enable(store);
+        return duplicates.similarTo(id, threshold, limit);
+    }
+
+    // Function to find every cluster of near-duplicate questions in the quiz, in parallel
+    DuplicateReport findDuplicates(double threshold, WorkStealingPool& pool) const {
+        auto source = [this](size_t slot, MinHasher& hasher) {
+            if (!store.isLive(static_cast<int>(slot))) return -1;
+            hasher.add(store, static_cast<int>(slot));
+            return store.row(static_cast<int>(slot)).id;
+        };
+        return findNearDuplicates(store.slotCount(), source, threshold, pool);
+    }
+
+    // Function to account for the bytes the bank's strings take, per field
+    StringMemory stringMemory() const { return store.stringMemory(); }
+
+    // Function to search question and choice text; returns up to limit ids, best match first
+    vector<int> searchQuestions(const string& query, size_t limit) {
+        return textIndex.search(store, query, limit);
+    }
+
+    // Function to delete a question without printing; returns false if the id is unknown
+    // or the deletion cannot be journaled
+    bool removeQuestion(int id) {
+        int slot = getQuestionById(id);
+        if (slot == -1 || !journalWorking()) return false;
+        totalPoints -= store.points(slot);
+        attempt.forget(id);
+        unindexQuestion(slot);
+        store.erase(slot);
+        questionCount--;
+        return journalErase(id);
+    }
+
+    // Function to check that changes can still be journaled, so edits are refused before they are made
+    bool journalWorking() const { return !journal || !journal->hasFailed(); }
+
+    // Function to wait until every journaled change is on disk; false if some never will be
+    bool syncJournal() { return !journal || journal->sync(); }
+
+    // Function to record a taker's answer, lowercased as displayQuestion() does
+    bool recordAnswer(int id, string answer) {
+        int slot = getQuestionById(id);
+        if (slot == -1) return false;
+        for (auto& c : answer) c = tolower(c);
+        attempt.setAnswer(store, slot, answer);
+        return true;
+    }
+
+    // Function to count questions without a recorded answer
+    int unansweredCount() {
+        return attempt.unansweredCount(store);
+    }
+
+    // Function to grade every recorded answer without prompting; the result also becomes getScore()
+    double gradeAnswers() {
+        compileAnswerKeys(store);
+        return fromFixedPoints(gradeSheet(store, attempt));
+    }
+
+    double getTotalPoints() {
+        return fromFixedPoints(totalPoints);
+    }
+
+    int getQuestionCount() {
+        return questionCount;
+    }
+
+    // Function to find the id of the next unanswered question, -1 if there is none
+    int nextUnansweredId() {
+        int slot = getNextUnansweredQuestion();
+        return slot == -1 ? -1 : as_const(store).row(slot).id;
+    }
+
+    // Function to render a question as one protocol line: "Q id<TAB>type<TAB>text<TAB>A. choice..."
+    bool renderQuestion(int id, string& line) {
+        return ::renderQuestion(store, id, line);
+    }
+
+    // Function to freeze the current questions into a bank that concurrent attempts can share
+    shared_ptr<const QuestionBank> publish() {
+        compileAnswerKeys(store);  // Every version grades against keys compiled once, not per answer
+        auto bank = make_shared<QuestionBank>();
+        bank->questions = store;  // Shares every page; the quiz copies a page before its next write to it
+        bank->totalPoints = fromFixedPoints(totalPoints);
+        return bank;
+    }
+
+    // Function to compile the current bank into an answer key for batch grading
+    GradingKey gradingKey() const {
+        GradingKey key;
+        for (int slot = store.nextLive(0); slot != -1; slot = store.nextLive(slot + 1)) {
+            key.add(store.row(slot).id, store.correctAnswer(slot), fromFixedPoints(store.points(slot)), store.type(slot),
+                    store.answerKey(slot));
+        }
+        key.totalPoints = fromFixedPoints(totalPoints);
+        key.pack();
+        return key;
+    }
+
+    // Function to write the question bank to a file, replacing it atomically
+    bool save(const string& path) {
+        vector<BankRecord> records;
+        vector<BankParameters> calibration;
+        vector<ArenaString> choiceRefs;
+        StringArena heap;
+        ArenaString typeRefs[questionKindCount] = {};  // Types repeat, store each name once
+        const QuestionStore& questions = store;
+        // Keys and choices are interned, so each distinct one goes into the heap once too
+        vector<ArenaString> pooledRefs(questions.strings().size(), ArenaString{UINT32_MAX, 0});
+        auto pooled = [&](StringHandle handle) {
+            ArenaString& ref = pooledRefs[handle];
+            if (ref.offset == UINT32_MAX) ref = heap.add(questions.strings().view(handle));
+            return ref;
+        };
+        string scratch;
+        records.reserve(questionCount);
+        calibration.reserve(questionCount);
+        for (int slot = questions.nextLive(0); slot != -1; slot = questions.nextLive(slot + 1)) {
+            const Question& question = questions.row(slot);
+            BankRecord record{};
+            record.id = question.id;
+            record.firstChoice = static_cast<uint32_t>(choiceRefs.size());
+            record.choiceCount = question.choiceCount;
+            record.points = fromFixedPoints(questions.points(slot));
+            ArenaString& type = typeRefs[static_cast<int>(questions.type(slot))];
+            if (type.length == 0) type = heap.add(kindName(questions.type(slot)));
+            record.type = type;
+            record.text = heap.add(question.text(questions.strings(), scratch));
+            record.correctAnswer = pooled(questions.answerKey(slot));
+            for (int i = 0; i < question.choiceCount; i++) choiceRefs.push_back(pooled(question.choices[i]));
+            records.push_back(record);
+            const ItemParameters& parameters = questions.parameters(slot);
+            calibration.push_back(BankParameters{parameters.discrimination, parameters.difficulty, parameters.guessing, 0});
+        }
+
+        // References are 32-bit, so a heap or choice table past that would be written with wrapped offsets
+        if (heap.size() > UINT32_MAX || choiceRefs.size() > UINT32_MAX) {
+            cout << "[Could not write quiz bank " << path << ": its text passes the 4 GiB the file format can address]" << endl;
+            return false;
+        }
+        string body;
+        body.reserve(records.size() * (sizeof(BankRecord) + sizeof(BankParameters)) + choiceRefs.size() * sizeof(ArenaString) + heap.size());
+        body.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(BankRecord));
+        body.append(reinterpret_cast<const char*>(calibration.data()), calibration.size() * sizeof(BankParameters));
+        body.append(reinterpret_cast<const char*>(choiceRefs.data()), choiceRefs.size() * sizeof(ArenaString));
+        body.append(heap.view(ArenaString{0, static_cast<uint32_t>(heap.size())}));
+
+        BankHeader header{};
+        memcpy(header.magic, bankMagic, sizeof(bankMagic));
+        header.version = bankVersion;
+        header.recordSize = sizeof(BankRecord);
+        header.questionCount = records.size();
+        header.choiceCount = choiceRefs.size();
+        header.heapSize = heap.size();
+        header.nextId = store.nextId();
+        header.checksum = bankChecksum(body.data(), body.size());
+
+        // Write to a temporary file first so a crash never leaves a half-written bank
+        string tempPath = path + ".tmp";
+        {
+            ofstream out(tempPath, ios::binary | ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(body.data(), body.size());
+            if (!out.flush()) {
+                cout << "[Could not write quiz bank " << path << "]" << endl;
+                return false;
+            }
+        }
+        // Sync before renaming, or the rename could reach the disk before the data does
+        int written = ::open(tempPath.c_str(), O_RDONLY | O_CLOEXEC);
+        bool synced = written >= 0 && fsync(written) == 0;
+        if (written >= 0) ::close(written);
+        if (!synced || rename(tempPath.c_str(), path.c_str()) != 0) {
+            cout << "[Could not write quiz bank " << path << "]" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Function to replace the question bank with one read from a file. Records are checked before
+    // anything is replaced (the checksum is left to --verify), so a damaged file leaves the quiz as it was.
+    bool open(const string& path) {
+        MappedBank bank;
+        if (!bank.open(path) || !bank.checkRecords()) {
+            cout << "[Could not open quiz bank: " << bank.lastError() << "]" << endl;
+            return false;
+        }
+        reset();
+        store.reserve(bank.size());
+        for (size_t i = 0; i < bank.size(); i++) {
+            const BankRecord& record = bank.record(i);
+            int slot = store.emplace(record.id);
+            Question& question = store.row(slot);
+            store.type(slot) = bank.kind(record);
+            question.setText(store.strings(), bank.view(record.text));
+            store.setCorrectAnswer(slot, bank.view(record.correctAnswer));
+            store.points(slot) = toFixedPoints(record.points);
+            store.parameters(slot) = bank.parameters(i);
+            for (uint32_t c = 0; c < record.choiceCount; c++) {
+                question.addChoice(store.strings(), bank.choiceText(record, c));
+            }
+            addQuestionNode(slot);
+        }
+        store.reserveIds(bank.nextId());
+        if (journal) {
+            // The journal replaces its questions with the opened bank's
+            journal->clear();
+            for (int slot = store.nextLive(0); slot != -1; slot = store.nextLive(slot + 1)) journalPut(slot);
+            if (!journal->sync()) {
+                cout << "[" << journalFailedMessage << "]" << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Function to recover the bank kept at base (snapshot plus journal) and journal every later change
+    bool openJournal(EditJournal& editJournal, const string& base, string& error) {
+        journal = nullptr;
+        reset();
+        bool opened = editJournal.open(base, [this](const string& snapshot) { return open(snapshot); },
+                                       [this](const JournalRecord& record) { applyJournalRecord(record); },
+                                       compactJournal, error);
+        if (opened) journal = &editJournal;
+        return opened;
+    }
+
+    bool promptUserEmpty(int slot) {
+
+        do{cout << "Do you want to?\n";
+            cout << "\t1. Go to next question\n";
+            cout << "\t2. Jump to question\n";
             cout << "\t3. Submit\n";
             cout << "Select an action: ";
             int action;
             //getline(cin, user_answer);
+            if (!awaitInput()) return false;
             cin >> action;
             clearInput();
             // Execute action based on user's choice
             switch (action) {
                 case 1:
                     // Move to the next unanswered question
-                        question = getNextUnansweredQuestion();
-                if (!question) {return false;}//if question still null, break loop
+                        slot = getNextUnansweredQuestion();
+                if (slot == -1) {return false;}//if question still null, break loop
+
+                displayQuestion(slot);
+
+
+                return true;
+
+                case 2:
+                    int id;
+                cout << "Jump to question, or type search words [" << 1 << "-" << questionCount << "]: ";
+                id = readQuestionId();
+                slot = getQuestionById(id);
+                if (slot != -1) {
+                    displayQuestion(slot);
+                    return true;
+                }
+                cout << "[Question not found]" << endl;
+
+                break;
+                case 3:
+                    return false;
+                default:
+                    cout << "[Unknown input, please try again]" << endl;
+            }
+        }while(true);
+
+
+    }
+
+    bool promptUser(int slot) {
+        string newAnswer;
+    do {
+        cout << "Do you want to?\n";
+        cout << "\t1. Edit this Answer\n";
+        cout << "\t2. Go to next question\n";
+        cout << "\t3. Jump to question\n";
+        cout << "\t4. Submit\n";
+        cout << "Select an action: ";
+        int action;
+        if (!awaitInput()) return false;
+        cin >> action;
+        clearInput();
+        // Execute action based on user's choice
+        switch (action) {
+            case 1:
+                cout << "Your new answer: ";
+                if (!awaitInput()) return false;
+                getline(cin, newAnswer);
+                // Convert input to lowercase for case-insensitive comparison
+                for (auto& c : newAnswer) c = tolower(c);
+                attempt.setAnswer(store, slot, newAnswer);
+                return true;
+            case 2:
+                // Move to the next unanswered question
+                slot = getNextUnansweredQuestion();
+                if (slot == -1) {return false;}//if question still null, break loop
+
+                displayQuestion(slot);
+
+
+                return true;
+                break;
+            case 3:
+                int id;
+                cout << "Jump to question, or type search words [" << 1 << "-" << questionCount << "]: ";
+                id = readQuestionId();
+                slot = getQuestionById(id);
+                if (slot != -1) {
+                    displayQuestion(slot);
+                    return true;
+                }
+                cout << "[Question not found]" << endl;
+
+                break;
+            case 4:
+                return false;
+
+            default:
+                cout << "[Unknown input, please try again]" << endl;
+        }
+    }while(true);
+
+
+    }
+
+    void conductQuiz(){
+        int slot = store.nextLive(0);
+        bool cont = true;
+        examDue = chrono::steady_clock::now() + timing.exam;
+        examWarned = timeUp = false;
+
+        while(cont && !timeUp) {
+            if(allQuestionAnswer()) {
+               cout << "All questions answered. ";
+            }
+            if(slot != -1 && attempt.answer(store, slot).empty()) {
+               cont = promptUserEmpty(slot);
+            }
+            else {
+               cont = promptUser(slot);
+            }
+        }
+    }
+
+    void submitTest() {
+        if (!allQuestionAnswer()) {
+            cout << "[Unanswered questions detected. Submit anyway? (y/n)] ";
+            errorMessage = true;
+        }
+    }
+
+    void submit() {
+        if (!allQuestionAnswer() && !timeUp) {
+            cout << "[Unanswered questions detected. Submit anyway? (y/n)] ";
+            errorMessage = true;
+            string choice;
+            cin >> choice;
+            if (choice == "n") return;
+        }
+
+        //double score = 0;
+        METRIC_TIME(submit);
+        METRIC_COUNT(submits);
+        cout << "\n/!\\ Assessment Complete.\n=== SESSION LOG ===" << endl;
+        compileAnswerKeys(store);
+        const QuestionStore& questions = store;
+        for (int slot = questions.nextLive(0); slot != -1; slot = questions.nextLive(slot + 1)) {
+            const Question& question = questions.row(slot);
+            cout << "Question " << question.id << ": " << questions.correctAnswer(slot) << endl;
+            cout << "Your answer: " << attempt.answer(store, slot) << endl;
+            if (answerIsCorrect(slot)) attempt.score += questions.points(slot);
+        }
+        cout << fixed << setprecision(2) << "Final score: " << fromFixedPoints(attempt.score) << "/" << fromFixedPoints(totalPoints) << endl;
+    }
+
+};
+
+// Problem with one line of an imported bank
+struct ImportError {
+    size_t line;          // 1-based line the record starts on
+    const char* message;  // Same wording as the script driver's create errors
+};
+
+
+// Totals reported after importing a bank
+struct ImportStats {
+    size_t bytes = 0;           // Size of the input
+    size_t questions = 0;       // Questions added to the quiz
+    size_t rejected = 0;        // Records skipped because of an error
+    double parseSeconds = 0.0;  // Wall-clock time to tokenize and validate
+    double indexSeconds = 0.0;  // Wall-clock time to index the added questions for search
+    double seconds = 0.0;       // Wall-clock time including adding to the quiz
+    double megabytesPerSecond() const { return seconds > 0 ? bytes / seconds / 1e6 : 0.0; }
+};
+
+
+// Bulk importer for question banks kept as CSV or JSON Lines. The file is
+// mapped and split into chunks that workers tokenize and validate in
+// parallel; fields are string_views into the mapping, so the only copies
+// are of fields whose quotes or escapes had to be undone. Records are then
+// added to the quiz in file order, so ids follow the file, and indexed for
+// search together on the pool once they are all in.
+//   CSV:   type,text,answer,points[,choice A,choice B...]   RFC 4180 quoting,
+//          an optional header row starting with "type", trailing empty choices ignored
+//   JSONL: {"type": "mcq", "text": "...", "answer": "a", "points": 2, "choices": ["...", ...]}
+// The format is taken from the first character: '{' means JSON Lines.
+// Records are checked with Quiz::questionProblem(), the create prompts'
+// rules, and a bad record is skipped and reported with its line number.
+class BankImporter {
+private:
+    static constexpr size_t chunkBytes = 1 << 20;  // Input handed to one task
+    static constexpr size_t maxFields = 4 + Question::maxChoices;
+
+    // Fields whose quotes or escapes were undone, kept in blocks that never move
+    class DecodedText {
+    private:
+        vector<unique_ptr<char[]>> blocks;
+        size_t used = 0, capacity = 0;
+
+    public:
+        string_view add(string_view text) {
+            if (text.empty()) return string_view();
+            if (text.size() > capacity - used) {
+                capacity = max<size_t>(64 << 10, text.size());
+                blocks.emplace_back(new char[capacity]);
+                used = 0;
+            }
+            char* out = blocks.back().get() + used;
+            memcpy(out, text.data(), text.size());
+            used += text.size();
+            return string_view(out, text.size());
+        }
+    };
+
+    // One validated question, with its answer already normalized for its type
+    struct Record {
+        QuestionKind kind;
+        string_view text, answer;
+        double points;
+        uint32_t firstChoice;  // Index into the chunk's choices
+        uint32_t choiceCount;
+    };
+
+    // One slice of the input and everything parsed from it
+    struct Chunk {
+        size_t begin = 0, end = 0;   // Records starting in [begin, end) belong to this chunk
+        size_t quotes = 0;           // '"' bytes in [begin, end), CSV only
+        size_t newlines = 0;         // '\n' bytes in [begin, end)
+        size_t firstLine = 1;        // Line number at begin
+        bool insideQuotes = false;   // Whether begin falls inside a quoted CSV field
+        vector<Record> records;
+        vector<string_view> choices;
+        vector<ImportError> errors;
+        DecodedText decoded;
+        string scratch;              // Reused while undoing escapes
+    };
+
+    const char* data = nullptr;  // Input text (the mapping, or caller-owned memory)
+    size_t length = 0;
+    size_t textStart = 0;        // Where the first record starts, past any byte order mark
+    bool mapped = false;
+    bool jsonLines = false;
+    string error;                // Why the last open failed
+    vector<ImportError> problems;
+
+    // Function to count newlines and double quotes in one pass, 16 bytes per compare. Matches are
+    // summed in byte lanes and widened every 255 steps, before a lane can overflow.
+    static void countBreaks(const char* begin, const char* end, size_t& newlines, size_t& quotes) {
+        const __m128i newline = _mm_set1_epi8('\n'), quote = _mm_set1_epi8('"'), zero = _mm_setzero_si128();
+        __m128i newlineTotal = zero, quoteTotal = zero;
+        while (end - begin >= 16) {
+            __m128i newlineLanes = zero, quoteLanes = zero;
+            for (int step = 0; step < 255 && end - begin >= 16; step++, begin += 16) {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                newlineLanes = _mm_sub_epi8(newlineLanes, _mm_cmpeq_epi8(bytes, newline));
+                quoteLanes = _mm_sub_epi8(quoteLanes, _mm_cmpeq_epi8(bytes, quote));
+            }
+            newlineTotal = _mm_add_epi64(newlineTotal, _mm_sad_epu8(newlineLanes, zero));
+            quoteTotal = _mm_add_epi64(quoteTotal, _mm_sad_epu8(quoteLanes, zero));
+        }
+        newlines = _mm_cvtsi128_si64(newlineTotal) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(newlineTotal, newlineTotal));
+        quotes = _mm_cvtsi128_si64(quoteTotal) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(quoteTotal, quoteTotal));
+        for (; begin < end; begin++) {
+            newlines += *begin == '\n';
+            quotes += *begin == '"';
+        }
+    }
+
+    static string_view trim(string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+        return text;
+    }
+
+    // Function to lowercase text, copying it only if it has capitals
+    static string_view lowered(string_view text, Chunk& chunk) {
+        auto capital = find_if(text.begin(), text.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
+        if (capital == text.end()) return text;
+        chunk.scratch.assign(text);
+        for (auto& c : chunk.scratch) c = tolower(c);
+        return chunk.decoded.add(chunk.scratch);
+    }
+
+    static bool parsePoints(string_view text, double& points) {
+        text = trim(text);
+        auto parsed = from_chars(text.data(), text.data() + text.size(), points);
+        return !text.empty() && parsed.ec == errc() && parsed.ptr == text.data() + text.size();
+    }
+
+    // Function to validate a record's fields and keep it, or note why it was rejected
+    static void accept(Chunk& chunk, size_t line, string_view type, string_view text, string_view answer,
+                       string_view points, uint32_t firstChoice) {
+        Record record{};
+        record.text = text;
+        record.firstChoice = firstChoice;
+        record.choiceCount = static_cast<uint32_t>(chunk.choices.size() - firstChoice);
+        const char* problem = parsePoints(points, record.points) ? nullptr : "invalid point value";
+        if (!problem && !parseKind(lowered(trim(type), chunk), record.kind)) problem = "invalid question type";
+        if (!problem) {
+            // Most keys are already normalized, or only need trimming, so copy the rest only
+            normalizeKey(record.kind, answer, chunk.scratch);
+            string_view trimmed = trim(answer);
+            record.answer = chunk.scratch == answer ? answer : chunk.scratch == trimmed ? trimmed : chunk.decoded.add(chunk.scratch);
+            problem = Quiz::questionProblem(record.kind, record.answer, record.points, record.choiceCount);
+        }
+        if (problem) {
+            chunk.choices.resize(firstChoice);
+            chunk.errors.push_back({line, problem});
+            return;
+        }
+        chunk.records.push_back(record);
+    }
+
+    // Function to find where a record starting at p ends (its '\n', or the end of the input),
+    // counting the newlines inside quoted fields it spans
+    size_t recordEnd(size_t p, size_t& innerNewlines) const {
+        auto find = [this](size_t from, char c) {
+            const char* found = static_cast<const char*>(memchr(data + from, c, length - from));
+            return found ? static_cast<size_t>(found - data) : length;
+        };
+        size_t end = find(p, '\n');
+        if (jsonLines) return end;
+        // Jump from quote to quote; a newline only ends the record outside them
+        while (true) {
+            const char* open = static_cast<const char*>(memchr(data + p, '"', end - p));
+            if (!open) return end;
+            size_t close = find(open - data + 1, '"');
+            if (close >= end) {
+                innerNewlines += count(data + end, data + min(close, length), '\n');
+                if (close == length) return length;
+                end = find(close, '\n');
+            }
+            p = close + 1;
+        }
+    }
+
+    // Function to split one CSV record [p, end) into fields and validate it
+    void parseCsv(size_t p, size_t end, size_t line, Chunk& chunk) const {
+        if (end > p && data[end - 1] == '\r') end--;
+        if (p == end) return;  // Blank line
+        string_view fields[maxFields];
+        size_t count = 0;
+        uint32_t firstChoice = static_cast<uint32_t>(chunk.choices.size());
+        while (true) {
+            string_view field;
+            size_t next;
+            if (data[p] == '"') {
+                size_t close = p + 1;
+                bool escaped = false;
+                while (true) {
+                    const char* quote = static_cast<const char*>(memchr(data + close, '"', end - close));
+                    if (!quote) { chunk.errors.push_back({line, "unterminated quoted field"}); return; }
+                    close = quote - data;
+                    if (close + 1 < end && data[close + 1] == '"') {
+                        escaped = true;
+                        close += 2;
+                        continue;
+                    }
+                    break;
+                }
+                field = string_view(data + p + 1, close - p - 1);
+                if (escaped) {
+                    chunk.scratch.clear();
+                    for (size_t i = 0; i < field.size(); i++) {
+                        chunk.scratch += field[i];
+                        if (field[i] == '"') i++;
+                    }
+                    field = chunk.decoded.add(chunk.scratch);
+                }
+                next = close + 1;
+                if (next < end && data[next] != ',') { chunk.errors.push_back({line, "text after a closing quote"}); return; }
+            } else {
+                const char* comma = static_cast<const char*>(memchr(data + p, ',', end - p));
+                next = comma ? comma - data : end;
+                field = string_view(data + p, next - p);
+                if (field.find('"') != string_view::npos) { chunk.errors.push_back({line, "quote inside an unquoted field"}); return; }
+            }
+            if (count == maxFields) {
+                if (!field.empty()) { chunk.errors.push_back({line, "too many choices"}); return; }
+            } else {
+                fields[count++] = field;
+            }
+            if (next >= end) break;
+            p = next + 1;
+            if (p == end) {  // Trailing comma: one more, empty, field
+                if (count < maxFields) fields[count++] = string_view();
+                break;
+            }
+        }
+        if (line == 1 && trim(fields[0]).size() == 4 && lowered(trim(fields[0]), chunk) == "type") return;  // Header row
+        while (count > 4 && fields[count - 1].empty()) count--;  // Spreadsheets pad rows with empty cells
+        if (count < 4) { chunk.errors.push_back({line, "expected type, text, answer and points"}); return; }
+        for (size_t i = 4; i < count; i++) chunk.choices.push_back(fields[i]);
+        accept(chunk, line, fields[0], fields[1], fields[2], fields[3], firstChoice);
+    }
+
+    // Function to read a JSON string starting at the opening quote; copies only if it has escapes
+    static bool readJsonString(const char*& p, const char* end, string_view& out, Chunk& chunk) {
+        const char* start = ++p;
+        while (p < end && *p != '"' && *p != '\\') p++;
+        if (p < end && *p == '"') {
+            out = string_view(start, p++ - start);
+            return true;
+        }
+        chunk.scratch.assign(start, p);
+        while (p < end && *p != '"') {
+            if (*p != '\\') { chunk.scratch += *p++; continue; }
+            if (++p == end) return false;
+            char escape = *p++;
+            switch (escape) {
+                case '"': case '\\': case '/': chunk.scratch += escape; break;
+                case 'b': chunk.scratch += '\b'; break;
+                case 'f': chunk.scratch += '\f'; break;
+                case 'n': chunk.scratch += '\n'; break;
+                case 'r': chunk.scratch += '\r'; break;
+                case 't': chunk.scratch += '\t'; break;
+                case 'u': {
+                    auto hex = [&](uint32_t& value) {
+                        if (end - p < 4) return false;
+                        auto parsed = from_chars(p, p + 4, value, 16);
+                        p += 4;
+                        return parsed.ptr == p;
+                    };
+                    uint32_t code = 0;
+                    if (!hex(code)) return false;
+                    if (code >= 0xD800 && code < 0xDC00) {  // High surrogate: the low half must follow
+                        uint32_t low = 0;
+                        if (end - p < 6 || p[0] != '\\' || p[1] != 'u') return false;
+                        p += 2;
+                        if (!hex(low) || low < 0xDC00 || low >= 0xE000) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    if (code < 0x80) {
+                        chunk.scratch += static_cast<char>(code);
+                    } else if (code < 0x800) {
+                        chunk.scratch += static_cast<char>(0xC0 | code >> 6);
+                        chunk.scratch += static_cast<char>(0x80 | (code & 0x3F));
+                    } else if (code < 0x10000) {
+                        chunk.scratch += static_cast<char>(0xE0 | code >> 12);
+                        chunk.scratch += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+                        chunk.scratch += static_cast<char>(0x80 | (code & 0x3F));
+                    } else {
+                        chunk.scratch += static_cast<char>(0xF0 | code >> 18);
+                        chunk.scratch += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+                        chunk.scratch += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+                        chunk.scratch += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: return false;
+            }
+        }
+        if (p == end) return false;
+        p++;
+        out = chunk.decoded.add(chunk.scratch);
+        return true;
+    }
+
+    // Function to step over any JSON value, for fields the importer does not use
+    static bool skipJsonValue(const char*& p, const char* end, Chunk& chunk) {
+        int depth = 0;
+        string_view ignored;
+        do {
+            while (p < end && isspace(static_cast<unsigned char>(*p))) p++;
+            if (p == end) return false;
+            if (*p == '"') {
+                if (!readJsonString(p, end, ignored, chunk)) return false;
+            } else if (*p == '{' || *p == '[') {
+                depth++;
+                p++;
+            } else if (*p == '}' || *p == ']') {
+                if (--depth < 0) return false;
+                p++;
+            } else if (depth > 0 && (*p == ',' || *p == ':')) {
+                p++;
+            } else {
+                const char* start = p;
+                while (p < end && (isalnum(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.')) p++;
+                if (p == start) return false;
+            }
+        } while (depth > 0);
+        return true;
+    }
+
+    // Function to read one JSON object record [p, end) and validate it
+    void parseJson(size_t p, size_t end, size_t line, Chunk& chunk) const {
+        const char* at = data + p;
+        const char* stop = data + end;
+        auto space = [&] { while (at < stop && isspace(static_cast<unsigned char>(*at))) at++; };
+        auto fail = [&](const char* message) { chunk.errors.push_back({line, message}); };
+        space();
+        if (at == stop) return;  // Blank line
+        if (*at != '{') return fail("expected a JSON object");
+        at++;
+        string_view type, text, answer, points;
+        bool haveType = false, haveText = false, haveAnswer = false, havePoints = false;
+        uint32_t firstChoice = static_cast<uint32_t>(chunk.choices.size());
+        space();
+        if (at < stop && *at == '}') {
+            at++;
+        } else {
+            while (true) {
+                space();
+                string_view key;
+                if (at == stop || *at != '"' || !readJsonString(at, stop, key, chunk)) return fail("malformed JSON");
+                space();
+                if (at == stop || *at++ != ':') return fail("malformed JSON");
+                space();
+                if (at == stop) return fail("malformed JSON");
+                if (key == "type" || key == "text" || key == "answer") {
+                    string_view& field = key == "type" ? type : key == "text" ? text : answer;
+                    if (*at != '"' || !readJsonString(at, stop, field, chunk)) return fail("expected a string");
+                    (key == "type" ? haveType : key == "text" ? haveText : haveAnswer) = true;
+                } else if (key == "points") {
+                    const char* start = at;
+                    while (at < stop && (isalnum(static_cast<unsigned char>(*at)) || *at == '-' || *at == '+' || *at == '.')) at++;
+                    points = string_view(start, at - start);
+                    havePoints = true;
+                } else if (key == "choices") {
+                    if (*at++ != '[') return fail("expected a list of choices");
+                    space();
+                    if (at < stop && *at == ']') {
+                        at++;
+                    } else {
+                        while (true) {
+                            space();
+                            string_view choice;
+                            if (at == stop || *at != '"' || !readJsonString(at, stop, choice, chunk)) return fail("expected a string");
+                            if (chunk.choices.size() - firstChoice == Question::maxChoices) return fail("too many choices");
+                            chunk.choices.push_back(choice);
+                            space();
+                            if (at < stop && *at == ',') { at++; continue; }
+                            if (at < stop && *at == ']') { at++; break; }
+                            chunk.choices.resize(firstChoice);
+                            return fail("malformed JSON");
+                        }
+                    }
+                } else if (!skipJsonValue(at, stop, chunk)) {
+                    chunk.choices.resize(firstChoice);
+                    return fail("malformed JSON");
+                }
+                space();
+                if (at < stop && *at == ',') { at++; continue; }
+                if (at < stop && *at == '}') { at++; break; }
+                chunk.choices.resize(firstChoice);
+                return fail("malformed JSON");
+            }
+        }
+        space();
+        if (at != stop) {
+            chunk.choices.resize(firstChoice);
+            return fail("text after the JSON object");
+        }
+        if (!haveType || !haveText || !haveAnswer || !havePoints) {
+            chunk.choices.resize(firstChoice);
+            return fail("expected type, text, answer and points");
+        }
+        accept(chunk, line, type, text, answer, points, firstChoice);
+    }
+
+    // Function to parse every record starting in a chunk; one may run on past its end
+    void parseChunk(Chunk& chunk) const {
+        size_t p = chunk.begin, line = chunk.firstLine;
+        // Skip to the first record boundary: a newline outside quotes
+        if (p > textStart && !(data[p - 1] == '\n' && !chunk.insideQuotes)) {
+            bool inside = chunk.insideQuotes;
+            for (; p < chunk.end; p++) {
+                if (data[p] == '"' && !jsonLines) inside = !inside;
+                else if (data[p] == '\n') {
+                    line++;
+                    if (!inside) break;
+                }
+            }
+            p++;
+        }
+        while (p < chunk.end) {
+            size_t innerNewlines = 0;
+            size_t end = recordEnd(p, innerNewlines);
+            if (jsonLines) parseJson(p, end, line, chunk);
+            else parseCsv(p, end, line, chunk);
+            line += innerNewlines + 1;
+            p = end + 1;
+        }
+    }
+
+public:
+    BankImporter() {}
+    ~BankImporter() { close(); }
+    BankImporter(const BankImporter&) = delete;
+    BankImporter& operator=(const BankImporter&) = delete;
+
+    // Function to map a CSV or JSONL file for importing
+    bool open(const string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { error = "cannot open " + path; return false; }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            error = "cannot read " + path;
+            return false;
+        }
+        if (info.st_size > 0) {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                error = "mmap failed";
+                return false;
+            }
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+            data = static_cast<const char*>(mapping);
+            length = info.st_size;
+            mapped = true;
+        }
+        ::close(fd);
+        error.clear();
+        return true;
+    }
+
+    // Function to import from text in memory instead; it must outlive run()
+    void setText(string_view text) {
+        close();
+        data = text.data();
+        length = text.size();
+    }
+
+    // Function to unmap the input
+    void close() {
+        if (mapped) munmap(const_cast<char*>(data), length);
+        data = nullptr;
+        length = 0;
+        mapped = false;
+    }
+
+    const string& lastError() const { return error; }
+    // Problems found by the last run, in line order
+    const vector<ImportError>& errors() const { return problems; }
+
+    // Function to parse the input on the pool and add every valid record to the quiz
+    ImportStats run(Quiz& quiz, WorkStealingPool& pool) {
+        ImportStats stats;
+        auto start = chrono::steady_clock::now();
+        problems.clear();
+        stats.bytes = length;
+        textStart = length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;  // UTF-8 byte order mark
+        size_t first = textStart;
+        while (first < length && isspace(static_cast<unsigned char>(data[first]))) first++;
+        jsonLines = first < length && data[first] == '{';
+
+        vector<Chunk> chunks((length - textStart + chunkBytes - 1) / chunkBytes);
+        for (size_t i = 0; i < chunks.size(); i++) {
+            chunks[i].begin = textStart + i * chunkBytes;
+            chunks[i].end = min(length, chunks[i].begin + chunkBytes);
+        }
+        // Pass 1: count newlines and quotes, so each chunk learns its first line and quote state
+        for (Chunk& chunk : chunks) {
+            pool.submit([this, &chunk] {
+                countBreaks(data + chunk.begin, data + chunk.end, chunk.newlines, chunk.quotes);
+                if (jsonLines) chunk.quotes = 0;
+            });
+        }
+        pool.wait();
+        for (size_t i = 1; i < chunks.size(); i++) {
+            chunks[i].firstLine = chunks[i - 1].firstLine + chunks[i - 1].newlines;
+            chunks[i].insideQuotes = chunks[i - 1].insideQuotes != (chunks[i - 1].quotes % 2 == 1);
+        }
+        // Pass 2: tokenize and validate each chunk's records
+        for (Chunk& chunk : chunks) pool.submit([this, &chunk] { parseChunk(chunk); });
+        pool.wait();
+        stats.parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t total = 0;
+        for (const Chunk& chunk : chunks) total += chunk.records.size();
+        quiz.reserveQuestions(total);
+        vector<int> ids;
+        ids.reserve(total);
+        for (Chunk& chunk : chunks) {
+            for (const Record& record : chunk.records) {
+                ids.push_back(quiz.appendQuestion(record.kind, record.text, chunk.choices.data() + record.firstChoice,
+                                                  record.choiceCount, record.answer, record.points, false));
+            }
+            stats.questions += chunk.records.size();
+            stats.rejected += chunk.errors.size();
+            problems.insert(problems.end(), chunk.errors.begin(), chunk.errors.end());
+        }
+        auto indexStart = chrono::steady_clock::now();
+        quiz.indexQuestions(ids, pool);
+        stats.indexSeconds = chrono::duration<double>(chrono::steady_clock::now() - indexStart).count();
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+};
+
+
+// Small, fast, seedable random number generator (SplitMix64), so synthetic
+// banks and benchmark runs are reproducible from a seed.
+struct SplitMix64 {
+    uint64_t state;
+
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Function to draw a number in [0, bound)
+    uint64_t below(uint64_t bound) {
+        return bound == 0 ? 0 : next() % bound;
+    }
+
+    // Function to draw a number in [0, 1)
+    double unit() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+
+// Shape of a synthetic question bank
+struct SyntheticBankSpec {
+    size_t questions = 10000;  // Number of questions to create
+    double mcqShare = 0.5;     // Fraction of questions that are mcq
+    double tfShare = 0.3;      // Fraction that are tf
+    double numericShare = 0.0; // Fraction that are numeric
+    double multiShare = 0.0;   // Fraction that are multi; the rest are wr
+    int minChoices = 2;        // Choices per mcq, drawn from [minChoices, maxChoices]
+    int maxChoices = 5;
+    int textLength = 80;       // Characters of question text
+    int choiceLength = 20;     // Characters of each choice
+    int answerLength = 12;     // Characters of each wr key
+    uint64_t seed = 1;         // Same seed, same bank
+    size_t vocabulary = 0;     // Draw words Zipf-style from this many distinct words; 0 for random letters
+    bool calibrated = false;   // Give every question random IRT parameters, so takers find some harder than others
+};
+
+// Function to make lowercase words filling roughly length characters. With a
+// vocabulary, word r (r = 1..vocabulary) is drawn with probability about 1/r,
+// like word frequencies in real text, and always spells the same letters.
+string syntheticText(SplitMix64& random, int length, size_t vocabulary = 0) {
+    string text;
+    text.reserve(length);
+    while (static_cast<int>(text.size()) < length) {
+        if (!text.empty()) text += ' ';
+        if (vocabulary > 0) {
+            uint64_t rank = static_cast<uint64_t>(exp(random.unit() * log(static_cast<double>(vocabulary))));
+            SplitMix64 spelling(rank * 0x2545F4914F6CDD1Dull);
+            int word = 2 + static_cast<int>(spelling.below(8));
+            for (int i = 0; i < word && static_cast<int>(text.size()) < length; i++) text += static_cast<char>('a' + spelling.below(26));
+            continue;
+        }
+        int word = 2 + static_cast<int>(random.below(8));
+        for (int i = 0; i < word && static_cast<int>(text.size()) < length; i++) text += static_cast<char>('a' + random.below(26));
+    }
+    return text;
+}
+
+// Function to fill a quiz with a reproducible mix of question types
+void buildSyntheticBank(Quiz& quiz, const SyntheticBankSpec& spec) {
+    SplitMix64 random(spec.seed);
+    vector<string> choices;
+    string error;
+    auto drawChoices = [&] {
+        int count = spec.minChoices + static_cast<int>(random.below(spec.maxChoices - spec.minChoices + 1));
+        for (int c = 0; c < count; c++) choices.push_back(syntheticText(random, spec.choiceLength, spec.vocabulary));
+        return count;
+    };
+    for (size_t i = 0; i < spec.questions; i++) {
+        double pick = random.unit();
+        string text = syntheticText(random, spec.textLength, spec.vocabulary);
+        double points = 1 + random.below(4);
+        choices.clear();
+        int id;
+        double guessing = 0.0;  // Chance of a blind guess being right
+        if (pick < spec.mcqShare) {
+            int count = drawChoices();
+            string key(1, static_cast<char>('a' + random.below(count)));
+            id = quiz.addQuestion("mcq", text, choices, key, points, error);
+            guessing = 1.0 / count;
+        } else if (pick < spec.mcqShare + spec.tfShare) {
+            id = quiz.addQuestion("tf", text, choices, random.below(2) ? "true" : "false", points, error);
+            guessing = 0.5;
+        } else if (pick < spec.mcqShare + spec.tfShare + spec.numericShare) {
+            char key[32];
+            snprintf(key, sizeof(key), random.below(2) ? "%.2f~0.5" : "%.2f", random.below(100000) / 100.0);
+            id = quiz.addQuestion("numeric", text, choices, key, points, error);
+        } else if (pick < spec.mcqShare + spec.tfShare + spec.numericShare + spec.multiShare) {
+            int count = drawChoices();
+            uint64_t letters = 1 + random.below((1u << count) - 1);
+            string key;
+            for (int c = 0; c < count; c++) if (letters >> c & 1) key += static_cast<char>('a' + c);
+            id = quiz.addQuestion("multi", text, choices, key, points, error);
+            guessing = 1.0 / ((1u << count) - 1);
+        } else {
+            id = quiz.addQuestion("wr", text, choices, syntheticText(random, spec.answerLength), points, error);
+        }
+        if (spec.calibrated) {
+            char discrimination[16], difficulty[16], chance[16];
+            snprintf(discrimination, sizeof(discrimination), "%.3f", 0.5 + 1.5 * random.unit());
+            snprintf(difficulty, sizeof(difficulty), "%.3f", 6 * random.unit() - 3);
+            snprintf(chance, sizeof(chance), "%.3f", guessing);
+            quiz.setQuestionField(id, "irt", {discrimination, difficulty, chance}, error);
+        }
+    }
+}
+
+
+// Stateless random numbers for exam forms: the value drawn at a counter
+// depends only on (exam seed, student id, counter), so any thread can
+// rebuild any part of any student's form without generating the rest.
+struct CounterRandom {
+    uint64_t key;
+
+    CounterRandom(uint64_t seed, uint64_t student) : key(SplitMix64(seed ^ SplitMix64(student).next()).next()) {}
+
+    // Function to read the value at a counter (the counter-th output of a SplitMix64 seeded with key)
+    uint64_t at(uint64_t counter) const {
+        return SplitMix64(key + counter * 0x9E3779B97F4A7C15ull).next();
+    }
+
+    // Function to draw a number in [0, bound) at a counter
+    uint64_t below(uint64_t counter, uint64_t bound) const {
+        return bound == 0 ? 0 : at(counter) % bound;
+    }
+};
+
+// How exam forms are drawn from a bank
+struct FormSpec {
+    enum Strata { none, byType, byPoints };
+
+    size_t questions = 0;     // Questions per form, 0 for the whole bank
+    Strata stratify = none;   // Keep each type's (or point value's) share of the bank on every form
+    uint64_t seed = 1;        // Exam seed; the same seed and student always give the same form
+    bool shuffleChoices = true; // Permute MCQ choice letters per student
+};
+
+// Function to group a bank's live slots by stratum (all in one when stratify is none), in slot order
+vector<vector<int>> stratifySlots(const QuestionStore& store, FormSpec::Strata stratify) {
+    vector<vector<int>> strata;
+    map<string, size_t> strataByKey;
+    for (int slot = store.nextLive(0); slot != -1; slot = store.nextLive(slot + 1)) {
+        string key;
+        if (stratify == FormSpec::byType) key = kindName(store.type(slot));
+        else if (stratify == FormSpec::byPoints) key = to_string(fromFixedPoints(store.points(slot)));
+        auto found = strataByKey.emplace(key, strata.size()).first;
+        if (found->second == strata.size()) strata.emplace_back();
+        strata[found->second].push_back(slot);
+    }
+    return strata;
+}
+
+// Function to share count questions among strata in proportion to their sizes
+// (largest remainder, ties broken by stratum order so quotas are deterministic)
+vector<size_t> apportion(const vector<vector<int>>& strata, size_t count) {
+    size_t total = 0;
+    for (const vector<int>& members : strata) total += members.size();
+    vector<size_t> quotas(strata.size(), 0);
+    vector<pair<double, size_t>> remainders;
+    size_t assigned = 0;
+    for (size_t s = 0; s < strata.size(); s++) {
+        double exact = static_cast<double>(count) * strata[s].size() / total;
+        quotas[s] = static_cast<size_t>(exact);
+        assigned += quotas[s];
+        remainders.push_back({exact - quotas[s], s});
+    }
+    stable_sort(remainders.begin(), remainders.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t i = 0; assigned < count; i = (i + 1) % remainders.size()) {
+        size_t s = remainders[i].second;
+        if (quotas[s] < strata[s].size()) { quotas[s]++; assigned++; }
+    }
+    return quotas;
+}
+
+// One student's form: the bank slots to ask, in presentation order. Choice
+// orders are not stored; FormGenerator recomputes them when a question is
+// rendered or graded.
+struct ExamForm {
+    uint64_t student = 0;
+    vector<int> slots;
+};
+
+// Draws randomized exam forms from a published bank. Strata and their quotas
+// are worked out once, so a form costs O(questions per form): a Floyd sample
+// from each stratum followed by a shuffle of the picks. Nothing in the bank is
+// copied; a form's answer key is the bank's key with MCQ letters remapped.
+class FormGenerator {
+private:
+    shared_ptr<const QuestionBank> bank;
+    FormSpec spec;
+    vector<vector<int>> strata;  // Live slots of each stratum, in slot order
+    vector<size_t> quotas;       // Questions drawn from each stratum per form
+    size_t formSize = 0;
+
+    static const uint64_t choiceCounters = 1ull << 63;  // Choice shuffles count from here, selection from 0
+
+public:
+    FormGenerator(shared_ptr<const QuestionBank> questions, const FormSpec& formSpec)
+        : bank(std::move(questions)), spec(formSpec) {
+        strata = stratifySlots(bank->questions, spec.stratify);
+        size_t total = bank->questions.size();
+        formSize = spec.questions == 0 ? total : min(spec.questions, total);
+        quotas = apportion(strata, formSize);
+    }
+
+    size_t questionsPerForm() const { return formSize; }
+    const QuestionStore& questions() const { return bank->questions; }
+
+    // Function to draw a student's form into form, reusing its storage
+    void generate(uint64_t student, ExamForm& form) const {
+        // Marks of slots already drawn, by position within the stratum; a new stamp per draw avoids clearing
+        static thread_local vector<uint32_t> marks;
+        static thread_local uint32_t stamp = 0;
+        CounterRandom random(spec.seed, student);
+        uint64_t counter = 0;
+        form.student = student;
+        form.slots.clear();
+        for (size_t s = 0; s < strata.size(); s++) {
+            const vector<int>& members = strata[s];
+            size_t n = members.size(), k = quotas[s];
+            if (k == 0) continue;
+            if (marks.size() < n) marks.resize(n, 0);
+            if (++stamp == 0) {
+                fill(marks.begin(), marks.end(), 0);
+                stamp = 1;
+            }
+            // Floyd's algorithm: k distinct positions out of n in k draws
+            for (size_t j = n - k; j < n; j++) {
+                size_t pick = random.below(counter++, j + 1);
+                if (marks[pick] == stamp) pick = j;
+                marks[pick] = stamp;
+                form.slots.push_back(members[pick]);
+            }
+        }
+        for (size_t i = form.slots.size(); i > 1; i--) {
+            swap(form.slots[i - 1], form.slots[random.below(counter++, i)]);
+        }
+    }
+
+    // Function to fill order with a question's choice order for a student: order[shown] = original index
+    int choiceOrder(uint64_t student, int slot, uint8_t order[Question::maxChoices]) const {
+        const Question& question = bank->questions.row(slot);
+        int count = question.choiceCount;
+        for (int i = 0; i < count; i++) order[i] = static_cast<uint8_t>(i);
+        if (!spec.shuffleChoices) return count;
+        CounterRandom random(spec.seed, student);
+        uint64_t base = choiceCounters | (static_cast<uint64_t>(static_cast<uint32_t>(question.id)) << 5);
+        for (int i = count; i > 1; i--) swap(order[i - 1], order[random.below(base + i, i)]);
+        return count;
+    }
+
+    // Function to check whether an answer to a slot's question is given in choice letters
+    bool lettered(int slot, string_view answer) const {
+        QuestionKind kind = bank->questions.type(slot);
+        return kind == QuestionKind::multi || (kind == QuestionKind::mcq && answer.size() == 1);
+    }
+
+    // Function to give a question's answer key as the student sees it (MCQ and multi letters remapped)
+    string formAnswer(uint64_t student, int slot) const {
+        string key(bank->questions.correctAnswer(slot));
+        if (!lettered(slot, key)) return key;
+        uint8_t order[Question::maxChoices];
+        int count = choiceOrder(student, slot, order);
+        for (char& letter : key) {
+            for (int shown = 0; shown < count; shown++) {
+                if ('a' + order[shown] == letter) {
+                    letter = static_cast<char>('a' + shown);
+                    break;
+                }
+            }
+        }
+        sort(key.begin(), key.end());  // Multi keys list letters in order
+        return key;
+    }
+
+    // Function to translate an answer given on the student's form back to the bank's lettering
+    string bankAnswer(uint64_t student, int slot, string_view answer) const {
+        string mapped(answer);
+        if (!lettered(slot, answer)) return mapped;
+        uint8_t order[Question::maxChoices];
+        int count = choiceOrder(student, slot, order);
+        for (char& letter : mapped) {
+            int shown = tolower(static_cast<unsigned char>(letter)) - 'a';
+            if (shown >= 0 && shown < count) letter = static_cast<char>('a' + order[shown]);
+        }
+        return mapped;
+    }
+
+    // Function to render a form question as a protocol line, with choices in the student's order
+    bool renderQuestion(uint64_t student, int slot, string& line) const {
+        const QuestionStore& store = bank->questions;
+        const Question& question = store.row(slot);
+        uint8_t order[Question::maxChoices];
+        int count = choiceOrder(student, slot, order);
+        thread_local string scratch;
+        line = "Q " + to_string(question.id) + '\t' + kindName(store.type(slot)) + '\t';
+        appendProtocolText(line, question.text(store.strings(), scratch));
+        for (int shown = 0; shown < count; shown++) {
+            line += '\t';
+            line += question.choiceLetter(shown);
+            line += ". ";
+            appendProtocolText(line, question.choiceText(store.strings(), order[shown]));
+        }
+        return true;
+    }
+
+    // Function to fingerprint a form, so a handed-out form can be checked later
+    uint64_t digest(const ExamForm& form) const {
+        uint64_t hash = SplitMix64(spec.seed ^ form.student).next();
+        for (int slot : form.slots) {
+            hash = SplitMix64(hash ^ static_cast<uint32_t>(bank->questions.row(slot).id)).next();
+        }
+        return hash;
+    }
+
+    // Function to check that a digest matches the form a student should have received
+    bool verify(uint64_t student, uint64_t expected) const {
+        static thread_local ExamForm form;
+        generate(student, form);
+        return digest(form) == expected;
+    }
+
+    // Function to generate the forms of students firstStudent.. in parallel, one digest each
+    void generateDigests(uint64_t firstStudent, vector<uint64_t>& digests, WorkStealingPool& pool) const {
+        const size_t chunk = 4096;
+        for (size_t begin = 0; begin < digests.size(); begin += chunk) {
+            pool.submit([this, &digests, firstStudent, begin, chunk] {
+                ExamForm form;
+                size_t end = min(digests.size(), begin + chunk);
+                for (size_t i = begin; i < end; i++) {
+                    generate(firstStudent + i, form);
+                    digests[i] = digest(form);
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    // Function to verify the digests of students firstStudent.. in parallel; returns the number that do not match
+    size_t verifyDigests(uint64_t firstStudent, const vector<uint64_t>& digests, WorkStealingPool& pool) const {
+        const size_t chunk = 4096;
+        atomic<size_t> mismatches{0};
+        for (size_t begin = 0; begin < digests.size(); begin += chunk) {
+            pool.submit([this, &digests, &mismatches, firstStudent, begin, chunk] {
+                size_t bad = 0, end = min(digests.size(), begin + chunk);
+                for (size_t i = begin; i < end; i++) bad += !verify(firstStudent + i, digests[i]);
+                mismatches += bad;
+            });
+        }
+        pool.wait();
+        return mismatches.load();
+    }
+};
+
+
+// How adaptive tests are given from a bank
+struct AdaptiveSpec {
+    size_t questions = 20;      // Questions per test, at most
+    double targetError = 0;     // Stop sooner once the ability's standard error is below this; 0 never stops sooner
+    FormSpec::Strata contentAreas = FormSpec::byType; // Every test keeps each area's share of the bank
+    double maxExposure = 0.2;   // Pass over questions already given in more than this share of the tests started
+    int randomesque = 4;        // Pick at random among this many most informative eligible questions
+    size_t tableDepth = 256;    // Questions listed per ability bucket and content area
+    uint64_t seed = 1;          // Seeds each taker's random picks
+};
+
+// Computerized adaptive testing over a published bank. Each question's
+// information is worked out once for every ability on a grid, and for each
+// grid point and content area the tableDepth most informative questions are
+// listed best first. Choosing the next question walks the list at the
+// taker's current estimate past questions already asked, over their exposure
+// limit or in an area whose quota is filled, so a step costs a few dozen
+// reads however large the bank is; only a list walked to its end falls back
+// to scanning its area. Exposure counts are shared by every session.
+class AdaptiveTest {
+public:
+    static constexpr int gridPoints = 81;  // Abilities -4, -3.9, ..., 4: estimation quadrature and table buckets
+    static constexpr double gridLow = -4.0, gridStep = 0.1;
+
+    static double gridAbility(int point) { return gridLow + point * gridStep; }
+
+private:
+    struct Item {
+        int slot;
+        uint32_t area;
+        ItemParameters parameters;
+    };
+
+    shared_ptr<const QuestionBank> bank;
+    AdaptiveSpec spec;
+    vector<Item> items;            // Live questions, grouped by content area
+    vector<uint32_t> areaBegin;    // Area a holds items [areaBegin[a], areaBegin[a + 1])
+    vector<size_t> quotas;         // Questions from each area per test
+    size_t testLength = 0;
+    vector<uint32_t> tables;       // Item indices by information, best first, per (grid point, area)
+    vector<uint32_t> tableBegin;   // Table of (point, area) is [tableBegin[i], tableBegin[i + 1]), i = point * areas + area
+    unique_ptr<atomic<uint32_t>[]> exposures;  // Tests each item has been given in
+    atomic<uint64_t> started{0};
+
+    friend class AdaptiveSession;
+
+    size_t areaCount() const { return quotas.size(); }
+
+    static int nearestPoint(double theta) {
+        return static_cast<int>(min<long>(gridPoints - 1, max<long>(0, lround((theta - gridLow) / gridStep))));
+    }
+
+    // Function to choose the next item for a taker at ability theta; -1 once every quota is filled
+    int choose(double theta, const vector<uint32_t>& given, const vector<size_t>& areaCounts, SplitMix64& random) {
+        thread_local vector<pair<double, uint32_t>> candidates;
+        candidates.clear();
+        const size_t wanted = static_cast<size_t>(max(1, spec.randomesque));
+        const double limit = spec.maxExposure * started.load(memory_order_relaxed) + 1;
+        auto asked = [&given](uint32_t item) { return find(given.begin(), given.end(), item) != given.end(); };
+        int point = nearestPoint(theta);
+        for (size_t area = 0; area < areaCount(); area++) {
+            if (areaCounts[area] >= quotas[area]) continue;
+            size_t first = candidates.size();
+            size_t index = point * areaCount() + area;
+            for (uint32_t at = tableBegin[index]; at < tableBegin[index + 1] && candidates.size() - first < wanted; at++) {
+                uint32_t item = tables[at];
+                if (exposures[item].load(memory_order_relaxed) >= limit || asked(item)) continue;
+                candidates.push_back({items[item].parameters.information(theta), item});
+            }
+            if (candidates.size() - first == wanted) continue;
+            // The list ran out: scan the whole area, letting exposure go only if nothing else is left
+            size_t listed = candidates.size();
+            for (int relaxed = 0; relaxed < 2 && (relaxed == 0 || candidates.size() == first); relaxed++) {
+                for (uint32_t item = areaBegin[area]; item < areaBegin[area + 1]; item++) {
+                    if ((!relaxed && exposures[item].load(memory_order_relaxed) >= limit) || asked(item)) continue;
+                    auto seen = find_if(candidates.begin() + first, candidates.begin() + listed,
+                                        [item](const auto& candidate) { return candidate.second == item; });
+                    if (seen == candidates.begin() + listed) candidates.push_back({items[item].parameters.information(theta), item});
+                }
+            }
+        }
+        if (candidates.empty()) return -1;
+        size_t pool = min(wanted, candidates.size());
+        partial_sort(candidates.begin(), candidates.begin() + pool, candidates.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+        uint32_t pick = candidates[random.below(pool)].second;
+        exposures[pick].fetch_add(1, memory_order_relaxed);
+        return static_cast<int>(pick);
+    }
+
+public:
+    AdaptiveTest(shared_ptr<const QuestionBank> questions, const AdaptiveSpec& adaptiveSpec)
+        : bank(std::move(questions)), spec(adaptiveSpec) {
+        const QuestionStore& store = bank->questions;
+        vector<vector<int>> areas = stratifySlots(store, spec.contentAreas);
+        testLength = min(spec.questions, static_cast<size_t>(store.size()));
+        quotas = apportion(areas, testLength);
+        for (size_t area = 0; area < areas.size(); area++) {
+            areaBegin.push_back(static_cast<uint32_t>(items.size()));
+            for (int slot : areas[area]) items.push_back(Item{slot, static_cast<uint32_t>(area), store.parameters(slot)});
+        }
+        areaBegin.push_back(static_cast<uint32_t>(items.size()));
+        exposures.reset(new atomic<uint32_t>[items.size()]());
+
+        vector<pair<float, uint32_t>> ranked;
+        tableBegin.push_back(0);
+        for (int point = 0; point < gridPoints; point++) {
+            double theta = gridAbility(point);
+            for (size_t area = 0; area < areaCount(); area++) {
+                ranked.clear();
+                for (uint32_t item = areaBegin[area]; item < areaBegin[area + 1]; item++) {
+                    ranked.push_back({static_cast<float>(items[item].parameters.information(theta)), item});
+                }
+                size_t depth = min(spec.tableDepth, ranked.size());
+                partial_sort(ranked.begin(), ranked.begin() + depth, ranked.end(),
+                             [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+                for (size_t i = 0; i < depth; i++) tables.push_back(ranked[i].second);
+                tableBegin.push_back(static_cast<uint32_t>(tables.size()));
+            }
+        }
+    }
+
+    size_t questionsPerTest() const { return testLength; }
+    const QuestionStore& questions() const { return bank->questions; }
+    uint64_t testsStarted() const { return started.load(memory_order_relaxed); }
+
+    // Function to read how many tests the question in a slot has been given in
+    uint32_t exposure(int slot) const {
+        for (size_t item = 0; item < items.size(); item++) {
+            if (items[item].slot == slot) return exposures[item].load(memory_order_relaxed);
+        }
+        return 0;
+    }
+};
+
+// One taker's adaptive test. The ability estimate is the mean of the
+// posterior over AdaptiveTest's grid (a standard normal prior times the
+// chance of each response so far), which stays finite even when every
+// answer so far is right or every one wrong.
+class AdaptiveSession {
+private:
+    AdaptiveTest& test;
+    SplitMix64 random;
+    vector<uint32_t> given;        // Items asked, in order
+    vector<size_t> areaCounts;     // Items asked from each content area
+    double logPosterior[AdaptiveTest::gridPoints];
+    double estimate = 0.0;
+    double error = 1.0;
+    int pending = -1;              // Item asked and not yet answered
+
+    // Function to update the estimate after the pending item is answered
+    void update(bool correct) {
+        const ItemParameters& parameters = test.items[pending].parameters;
+        double highest = -numeric_limits<double>::infinity();
+        for (int point = 0; point < AdaptiveTest::gridPoints; point++) {
+            double p = min(1 - 1e-12, max(1e-12, parameters.probability(AdaptiveTest::gridAbility(point))));
+            logPosterior[point] += log(correct ? p : 1 - p);
+            highest = max(highest, logPosterior[point]);
+        }
+        double mass = 0, mean = 0, square = 0;
+        for (int point = 0; point < AdaptiveTest::gridPoints; point++) {
+            double weight = exp(logPosterior[point] - highest), theta = AdaptiveTest::gridAbility(point);
+            mass += weight;
+            mean += weight * theta;
+            square += weight * theta * theta;
+        }
+        estimate = mean / mass;
+        error = sqrt(max(0.0, square / mass - estimate * estimate));
+        pending = -1;
+    }
+
+public:
+    AdaptiveSession(AdaptiveTest& adaptiveTest, uint64_t taker)
+        : test(adaptiveTest), random(SplitMix64(adaptiveTest.spec.seed ^ SplitMix64(taker).next()).next()),
+          areaCounts(adaptiveTest.areaCount(), 0) {
+        test.started.fetch_add(1, memory_order_relaxed);
+        given.reserve(test.testLength);
+        for (int point = 0; point < AdaptiveTest::gridPoints; point++) {
+            double theta = AdaptiveTest::gridAbility(point);
+            logPosterior[point] = -0.5 * theta * theta;
+        }
+    }
+
+    // Function to give the slot of the question to ask now, -1 once the test is over
+    int next() {
+        if (pending != -1) return test.items[pending].slot;
+        if (given.size() >= test.testLength || (test.spec.targetError > 0 && error < test.spec.targetError)) return -1;
+        pending = test.choose(estimate, given, areaCounts, random);
+        if (pending == -1) return -1;
+        given.push_back(static_cast<uint32_t>(pending));
+        areaCounts[test.items[pending].area]++;
+        return test.items[pending].slot;
+    }
+
+    // Function to grade a response to the question next() gave and update the estimate; returns whether it was right
+    bool answer(string_view response) {
+        if (pending == -1) return false;
+        string lowered(response);
+        for (auto& c : lowered) c = tolower(c);
+        bool correct = isCorrectAnswer(test.bank->questions, test.items[pending].slot, lowered);
+        update(correct);
+        return correct;
+    }
+
+    // Function to record a response already graded elsewhere, e.g. by a simulated taker
+    void record(bool correct) {
+        if (pending != -1) update(correct);
+    }
+
+    double ability() const { return estimate; }
+    double standardError() const { return error; }
+    size_t asked() const { return given.size() - (pending != -1); }
+};
+
+
+// How simulated takers sit an exam. Every taker's ability and every step
+// they take are drawn from a stream keyed by (seed, taker), so any taker's
+// session can be rebuilt alone and the whole run is the same on any number
+// of threads.
+struct TakerSpec {
+    size_t takers = 1000;
+    uint64_t seed = 1;
+    double abilityMean = 0.0;    // Abilities are drawn from a normal distribution on the IRT scale
+    double abilitySpread = 1.0;
+    double jumpRate = 0.1;       // Chance of JUMPing ahead to a later question instead of taking NEXT
+    double reviseRate = 0.05;    // Chance, after an answer, of going back and changing an earlier one
+    double partialRate = 0.1;    // Chance of giving up part way and forcing the submit
+};
+
+struct SimulationStats {
+    size_t takers = 0;
+    size_t events = 0;     // Protocol commands sent, SUBMITs included
+    size_t answers = 0;    // ANSWER commands, revisions included
+    size_t partial = 0;    // Takers who forced a submit with questions unanswered
+    double meanScore = 0.0;
+    double seconds = 0.0;
+
+    double eventsPerSecond() const { return seconds > 0 ? events / seconds : 0.0; }
+};
+
+// Synthetic exam takers. Each question's right answer and some wrong ones
+// are worked out once (and checked against the grader), so a step costs a
+// few random draws and an append. A run writes, per taker and in taker
+// order: the protocol commands a QuizSession would receive ("student<TAB>
+// command"), the final answer sheet in gradeBatch()'s input format, and the
+// score both of them should come to, in gradeBatch()'s output format.
+class TakerSimulator {
+private:
+    struct Item {
+        int id;
+        FixedPoints points;
+        ItemParameters parameters;
+        string correct;          // Lowercased, as sessions and gradeBatch() record answers
+        vector<string> wrong;    // Answers that grade wrong; just the right answer if there are none
+        bool rightScores;        // Whether correct grades right (false only for an unusable key)
+        bool wrongScores;        // Whether the wrong answers grade right (no wrong answer exists)
+    };
+
+    vector<Item> items;
+    double totalPoints = 0.0;
+
+    // Function to work out a question's answers and check them with its type's grader
+    void addItem(int id, QuestionKind kind, string_view key, int choiceCount, FixedPoints points, const ItemParameters& parameters) {
+        Item item{id, points, parameters, string(), {}, false, false};
+        string lowered(key);
+        for (auto& c : lowered) c = tolower(c);
+        item.correct = kind == QuestionKind::numeric ? lowered.substr(0, lowered.find('~')) : lowered;
+        vector<string> candidates;
+        if (kind == QuestionKind::mcq) {
+            for (int c = 0; c < max(choiceCount, 2); c++) candidates.push_back(string(1, static_cast<char>('a' + c)));
+        } else if (kind == QuestionKind::tf) {
+            candidates = {"true", "false"};
+        } else if (kind == QuestionKind::multi) {
+            // Toggle a, or b if that would leave nothing selected
+            uint32_t set = MultiType::letterSet(item.correct), toggled = set ^ 1u ? set ^ 1u : set ^ 2u;
+            string letters;
+            for (int c = 0; c < Question::maxChoices; c++) if (toggled >> c & 1) letters += static_cast<char>('a' + c);
+            candidates.push_back(letters);
+        } else if (kind == QuestionKind::numeric) {
+            NumericKey compiled = NumericType::compile(key);
+            char text[64];
+            snprintf(text, sizeof(text), "%.6g", compiled.value + compiled.tolerance + max(1.0, fabs(compiled.value)));
+            candidates.push_back(text);
+        } else {
+            string garbled = item.correct;
+            for (auto& c : garbled) {
+                if (c >= 'a' && c <= 'z') c = static_cast<char>('a' + (c - 'a' + 13) % 26);
+                else if (c >= '0' && c <= '9') c = static_cast<char>('0' + (c - '0' + 5) % 10);
+            }
+            candidates.push_back(garbled + "x");
+        }
+        visitType(kind, [&](auto type) {
+            using Type = decltype(type);
+            auto compiled = Type::compile(key);
+            item.rightScores = Type::grade(compiled, item.correct);
+            for (const string& candidate : candidates) {
+                if (candidate != item.correct && !Type::grade(compiled, candidate)) item.wrong.push_back(candidate);
+            }
+        });
+        if (item.wrong.empty()) {
+            item.wrong.push_back(item.correct);
+            item.wrongScores = item.rightScores;
+        }
+        totalPoints += fromFixedPoints(points);
+        items.push_back(std::move(item));
+    }
+
+    // Function to draw a standard normal number (Box-Muller)
+    static double normal(SplitMix64& random) {
+        double u = 1.0 - random.unit();  // In (0, 1], so the log is finite
+        return sqrt(-2.0 * log(u)) * cos(2 * M_PI * random.unit());
+    }
+
+    // Function to play one taker, appending their commands, sheet and score; returns the events sent
+    size_t play(const TakerSpec& spec, size_t taker, string& trace, string& sheet, string& score, SimulationStats& stats) const {
+        SplitMix64 random(CounterRandom(spec.seed, taker).key);
+        const double theta = spec.abilityMean + spec.abilitySpread * normal(random);
+        const size_t count = items.size();
+        thread_local vector<int32_t> chosen;  // Per question: -1 blank, 0 the right answer, 1 + i wrong[i]
+        thread_local vector<uint32_t> answered;
+        chosen.assign(count, -1);
+        answered.clear();
+        char student[24];
+        int studentLength = snprintf(student, sizeof(student), "s%zu\t", taker);
+        size_t events = 0;
+        auto command = [&](const char* name, string_view argument) {
+            trace.append(student, studentLength);
+            trace += name;
+            if (!argument.empty()) {
+                trace += ' ';
+                trace.append(argument.data(), argument.size());
+            }
+            trace += '\n';
+            events++;
+        };
+        auto jump = [&](size_t question) {
+            char id[16];
+            int length = snprintf(id, sizeof(id), "%d", items[question].id);
+            command("JUMP", string_view(id, length));
+        };
+        auto respond = [&](size_t question) {
+            const Item& item = items[question];
+            bool right = random.unit() < item.parameters.probability(theta);
+            int32_t choice = right ? 0 : 1 + static_cast<int32_t>(random.below(item.wrong.size()));
+            if (chosen[question] == -1) answered.push_back(static_cast<uint32_t>(question));
+            chosen[question] = choice;
+            command("ANSWER", choice == 0 ? item.correct : item.wrong[choice - 1]);
+            stats.answers++;
+        };
+
+        size_t goal = count;  // Questions this taker answers before submitting
+        if (count > 0 && random.unit() < spec.partialRate) goal = random.below(count);
+        size_t cursor = 0;    // First question NEXT can show: every one before it is answered
+        while (answered.size() < goal) {
+            while (chosen[cursor] != -1) cursor++;
+            size_t question = cursor;
+            if (cursor + 1 < count && random.unit() < spec.jumpRate) {
+                question = cursor + 1 + random.below(count - cursor - 1);
+                jump(question);
+            } else {
+                command("NEXT", string_view());
+            }
+            if (chosen[question] != -1) continue;  // Jumped to one already answered: just look at it
+            respond(question);
+            if (answered.size() > 1 && random.unit() < spec.reviseRate) {
+                size_t earlier = answered[random.below(answered.size())];
+                jump(earlier);
+                respond(earlier);
+            }
+        }
+        command("SUBMIT", string_view());
+        if (answered.size() < count) {
+            command("SUBMIT", "FORCE");
+            stats.partial++;
+        }
+
+        FixedPoints total = 0;
+        sheet.append(student, studentLength - 1);
+        for (size_t question = 0; question < count; question++) {
+            if (chosen[question] == -1) continue;
+            const Item& item = items[question];
+            const string& answer = chosen[question] == 0 ? item.correct : item.wrong[chosen[question] - 1];
+            if (chosen[question] == 0 ? item.rightScores : item.wrongScores) total += item.points;
+            char id[16];
+            sheet.append(id, snprintf(id, sizeof(id), "\t%d=", item.id));
+            sheet += answer;
+        }
+        sheet += '\n';
+        char line[96];
+        double points = fromFixedPoints(total);
+        score.append(line, snprintf(line, sizeof(line), "%.*s\t%.2f\t%.2f\n", studentLength - 1, student, points, totalPoints));
+        stats.meanScore += points;
+        return events;
+    }
+
+public:
+    // Function to take the live questions of a store, in slot order as sessions show them
+    explicit TakerSimulator(const QuestionStore& store) {
+        for (int slot = store.nextLive(0); slot != -1; slot = store.nextLive(slot + 1)) {
+            addItem(store.row(slot).id, store.type(slot), store.correctAnswer(slot), store.row(slot).choiceCount,
+                    store.points(slot), store.parameters(slot));
+        }
+    }
+
+    // Function to take the questions of a mapped bank file, in file order
+    explicit TakerSimulator(const MappedBank& bank) {
+        for (size_t i = 0; i < bank.size(); i++) {
+            const BankRecord& record = bank.record(i);
+            addItem(record.id, bank.kind(record), bank.view(record.correctAnswer), static_cast<int>(record.choiceCount),
+                    toFixedPoints(record.points), bank.parameters(i));
+        }
+    }
+
+    size_t size() const { return items.size(); }
+
+    // Function to play spec.takers takers across a pool, writing each output that is not null in taker order.
+    // Blocks of takers are played in parallel a round at a time, and each round is written before the next starts.
+    SimulationStats run(const TakerSpec& spec, ostream* submissions, ostream* traces, ostream* scores, WorkStealingPool& pool) const {
+        struct Block {
+            string trace, sheets, scores;
+            SimulationStats stats;
+        };
+        const size_t takersPerBlock = 256;
+        SimulationStats stats;
+        auto start = chrono::steady_clock::now();
+        vector<Block> blocks(4 * pool.size());
+        for (size_t first = 0; first < spec.takers; first += takersPerBlock * blocks.size()) {
+            size_t used = 0;
+            for (; used < blocks.size() && first + used * takersPerBlock < spec.takers; used++) {
+                Block& block = blocks[used];
+                size_t begin = first + used * takersPerBlock, end = min(spec.takers, begin + takersPerBlock);
+                pool.submit([this, &spec, &block, begin, end] {
+                    block.trace.clear();
+                    block.sheets.clear();
+                    block.scores.clear();
+                    block.stats = SimulationStats();
+                    for (size_t taker = begin; taker < end; taker++) {
+                        block.stats.events += play(spec, taker, block.trace, block.sheets, block.scores, block.stats);
+                    }
+                });
+            }
+            pool.wait();
+            for (size_t b = 0; b < used; b++) {
+                const Block& block = blocks[b];
+                if (traces) traces->write(block.trace.data(), block.trace.size());
+                if (submissions) submissions->write(block.sheets.data(), block.sheets.size());
+                if (scores) scores->write(block.scores.data(), block.scores.size());
+                stats.events += block.stats.events;
+                stats.answers += block.stats.answers;
+                stats.partial += block.stats.partial;
+                stats.meanScore += block.stats.meanScore;
+            }
+        }
+        stats.takers = spec.takers;
+        if (stats.takers) stats.meanScore /= stats.takers;
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+};
 
-                displayQuestion(question);
 
+// Output buffer for machine-readable transcripts. Lines are collected in
+// memory and written in 64 KB blocks, so replaying many sessions is never
+// held up by a flush per line.
+class TranscriptWriter {
+private:
+    FILE* file;
+    string buffer;
 
-                return true;
+public:
+    explicit TranscriptWriter(FILE* output) : file(output) { buffer.reserve(1 << 17); }
+    ~TranscriptWriter() { flush(); }
+    TranscriptWriter(const TranscriptWriter&) = delete;
+    TranscriptWriter& operator=(const TranscriptWriter&) = delete;
 
-                case 2:
-                    int id;
-                cout << "Jump to question [" << 1 << "-" << questionCount << "]: ";
-                cin >> id;
-                question = getQuestionById(id);
-                if (question) {
-                    displayQuestion(question);
-                    return true;
+    TranscriptWriter& operator<<(string_view text) { buffer += text; return *this; }
+    TranscriptWriter& operator<<(char c) {
+        buffer += c;
+        if (c == '\n' && buffer.size() >= (1 << 16)) flush();
+        return *this;
+    }
+    TranscriptWriter& operator<<(long long value) {
+        char digits[24];
+        auto result = to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+    TranscriptWriter& operator<<(int value) { return *this << static_cast<long long>(value); }
+    TranscriptWriter& operator<<(size_t value) { return *this << static_cast<long long>(value); }
+    // Doubles are written with two decimals, like the interactive session log
+    TranscriptWriter& operator<<(double value) {
+        char digits[64];
+        int length = snprintf(digits, sizeof(digits), "%.2f", value);
+        buffer.append(digits, length);
+        return *this;
+    }
+
+    void flush() {
+        if (!buffer.empty()) fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+        fflush(file);
+    }
+};
+
+
+// Headless driver that replays authoring and test-taking sessions from a
+// script instead of prompts. One command per line, fields separated by tabs:
+//   session [name]                            start over with an empty quiz
+//   create  mcq|tf|wr  text  answer  points  [choice A]  [choice B] ...
+//                                             the new id, and id:similarity of near duplicates
+//   edit    id  type|text|answer|choices|irt  value...
+//   delete  id
+//   answer  id  answer
+//   search  query  [limit]                    ids of matching questions, best first
+//   duplicates  [threshold]                   clusters of near-duplicate questions (default 0.8)
+//   submit                                    grade the recorded answers
+// Blank lines and lines starting with # are skipped. Every command writes
+// one transcript line: "<line>\t<command>\tok|error\t<detail>", and the run
+// ends with a "final" line holding the last session's score and totals.
+class ScriptDriver {
+private:
+    Quiz quiz;
+    TranscriptWriter& out;
+    size_t sessions = 1;
+    size_t commands = 0;
+    size_t errors = 0;
+
+    static int parseId(string_view field) {
+        int id = -1;
+        from_chars(field.data(), field.data() + field.size(), id);
+        return id;
+    }
+
+    void ok(size_t line, string_view command) {
+        out << static_cast<long long>(line) << '\t' << command << "\tok";
+    }
+
+    void fail(size_t line, string_view command, string_view reason) {
+        errors++;
+        out << static_cast<long long>(line) << '\t' << command << "\terror\t" << reason << '\n';
+    }
+
+public:
+    explicit ScriptDriver(TranscriptWriter& transcript) : out(transcript) {}
+
+    // Function to run one script line
+    void execute(size_t line, string_view text) {
+        if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+        if (text.empty() || text[0] == '#') return;
+        vector<string_view> fields;
+        while (true) {
+            size_t tab = text.find('\t');
+            fields.push_back(text.substr(0, tab));
+            if (tab == string_view::npos) break;
+            text.remove_prefix(tab + 1);
+        }
+        string_view command = fields[0];
+        commands++;
+        string error;
+
+        if (command == "session") {
+            quiz = Quiz();
+            sessions++;
+            ok(line, command);
+            out << '\n';
+        } else if (command == "create") {
+            if (fields.size() < 5) return fail(line, command, "expected type, text, answer and points");
+            double points = -1;
+            from_chars(fields[4].data(), fields[4].data() + fields[4].size(), points);
+            vector<string> choices(fields.begin() + 5, fields.end());
+            int id = quiz.addQuestion(string(fields[1]), string(fields[2]), choices, string(fields[3]), points, error);
+            if (id == -1) return fail(line, command, error);
+            ok(line, command);
+            out << "\tid=" << id;
+            vector<DuplicateMatch> similar = quiz.similarQuestions(id);
+            if (!similar.empty()) out << "\tsimilar=";
+            for (size_t i = 0; i < similar.size(); i++) out << (i ? "," : "") << similar[i].id << ':' << similar[i].similarity;
+            out << '\n';
+        } else if (command == "edit") {
+            if (fields.size() < 3) return fail(line, command, "expected id and field");
+            vector<string> values(fields.begin() + 3, fields.end());
+            if (!quiz.setQuestionField(parseId(fields[1]), string(fields[2]), values, error)) return fail(line, command, error);
+            ok(line, command);
+            out << '\n';
+        } else if (command == "delete") {
+            if (fields.size() < 2 || !quiz.removeQuestion(parseId(fields[1]))) {
+                return fail(line, command, quiz.journalWorking() ? "question not found" : Quiz::journalFailedMessage);
+            }
+            ok(line, command);
+            out << '\n';
+        } else if (command == "answer") {
+            if (fields.size() < 3) return fail(line, command, "expected id and answer");
+            if (!quiz.recordAnswer(parseId(fields[1]), string(fields[2]))) return fail(line, command, "question not found");
+            ok(line, command);
+            out << '\n';
+        } else if (command == "search") {
+            if (fields.size() < 2) return fail(line, command, "expected query");
+            int limit = fields.size() > 2 ? parseId(fields[2]) : 10;
+            if (limit < 0) return fail(line, command, "invalid limit");
+            vector<int> matches = quiz.searchQuestions(string(fields[1]), limit);
+            ok(line, command);
+            out << "\tids=";
+            for (size_t i = 0; i < matches.size(); i++) out << (i ? "," : "") << matches[i];
+            out << '\n';
+        } else if (command == "duplicates") {
+            double threshold = 0.8;
+            if (fields.size() > 1) from_chars(fields[1].data(), fields[1].data() + fields[1].size(), threshold);
+            if (!(threshold > 0 && threshold <= 1)) return fail(line, command, "invalid threshold");
+            WorkStealingPool pool;
+            DuplicateReport report = quiz.findDuplicates(threshold, pool);
+            ok(line, command);
+            out << "\tclusters=";
+            for (size_t i = 0; i < report.clusters.size(); i++) {
+                for (size_t j = 0; j < report.clusters[i].members.size(); j++) {
+                    out << (j ? "," : i ? ";" : "") << report.clusters[i].members[j].id;
                 }
-                cout << "[Question not found]" << endl;
+            }
+            out << '\n';
+        } else if (command == "submit") {
+            int unanswered = quiz.unansweredCount();
+            double score = quiz.gradeAnswers();
+            ok(line, command);
+            out << "\tscore=" << score << "\ttotal=" << quiz.getTotalPoints() << "\tunanswered=" << unanswered << '\n';
+        } else {
+            fail(line, command, "unknown command");
+        }
+    }
 
-                break;
-                case 3:
-                    return false;
-                default:
-                    cout << "[Unknown input, please try again]" << endl;
+    // Function to run a whole script, then write the final line
+    void run(istream& script) {
+        string text;
+        size_t line = 0;
+        while (getline(script, text)) execute(++line, text);
+        out << "final\tscore=" << quiz.gradeAnswers() << "\ttotal=" << quiz.getTotalPoints()
+            << "\tsessions=" << sessions << "\tcommands=" << commands << "\terrors=" << errors << '\n';
+    }
+
+    size_t errorCount() const { return errors; }
+};
+
+
+// Hierarchical timing wheel for large numbers of deadlines counted in
+// ticks. Four levels of 256 slots cover 2^32 ticks ahead (about 50 days of
+// milliseconds); a timer sits in the level whose span first reaches its
+// deadline and moves down a level each time the level below wraps, so
+// scheduling and cancelling are O(1) and a timer is moved at most three
+// times before it fires. Timers live in one node array linked into their
+// slots by index, and a bitmap of busy slots per level lets advance() and
+// nextDue() jump straight to the next tick with work, however far off.
+// Not thread-safe: each QuizServer worker keeps its own.
+class TimingWheel {
+public:
+    using Handle = uint64_t;  // Timer generation and node; 0 never names a timer
+
+private:
+    static constexpr int levelBits = 8, levels = 4;
+    static constexpr uint32_t slots = 1u << levelBits, none = UINT32_MAX;
+    static constexpr uint16_t unused = UINT16_MAX;
+
+    struct Node {
+        uint64_t deadline;
+        uint64_t payload;
+        uint32_t prev, next;   // Neighbours in the slot's list
+        uint32_t generation;   // Bumped when the node is freed, so stale handles miss
+        uint16_t bucket;       // level * slots + slot, or unused while free
+    };
+
+    vector<Node> nodes;
+    uint32_t freeNodes = none;       // Free list threaded through next
+    uint32_t heads[levels * slots];
+    uint64_t busy[levels][slots / 64] = {};  // Slots holding timers
+    uint64_t current;                // Every timer due before this tick has fired
+    size_t count = 0;
+
+    void link(uint32_t index) {
+        Node& node = nodes[index];
+        uint64_t delta = node.deadline > current ? node.deadline - current : 0;
+        int level = 0;
+        while (level < levels - 1 && delta >= (1ull << (levelBits * (level + 1)))) level++;
+        // Past the top level's reach, park in its furthest slot; cascading will place it again
+        uint64_t when = current + min<uint64_t>(delta, (1ull << (levelBits * levels)) - 1);
+        uint32_t slot = (when >> (levelBits * level)) & (slots - 1);
+        node.bucket = static_cast<uint16_t>(level * slots + slot);
+        node.prev = none;
+        node.next = heads[node.bucket];
+        if (node.next != none) nodes[node.next].prev = index;
+        heads[node.bucket] = index;
+        busy[level][slot / 64] |= 1ull << (slot % 64);
+    }
+
+    void unlink(uint32_t index) {
+        Node& node = nodes[index];
+        if (node.prev != none) nodes[node.prev].next = node.next;
+        else heads[node.bucket] = node.next;
+        if (node.next != none) nodes[node.next].prev = node.prev;
+        if (heads[node.bucket] == none) busy[node.bucket / slots][node.bucket % slots / 64] &= ~(1ull << (node.bucket % 64));
+    }
+
+    void release(uint32_t index) {
+        Node& node = nodes[index];
+        node.bucket = unused;
+        node.generation++;
+        node.next = freeNodes;
+        freeNodes = index;
+        count--;
+    }
+
+    // Function to move the timers of every upper-level slot that starts at current one level down
+    void cascade() {
+        int top = 1;
+        while (top < levels - 1 && ((current >> (levelBits * top)) & (slots - 1)) == 0) top++;
+        for (int level = top; level >= 1; level--) {
+            uint32_t slot = (current >> (levelBits * level)) & (slots - 1);
+            uint32_t index = heads[level * slots + slot];
+            heads[level * slots + slot] = none;
+            busy[level][slot / 64] &= ~(1ull << (slot % 64));
+            while (index != none) {
+                uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
             }
-        }while(true);
+        }
+    }
+
+    // Function to find a level's first busy slot at or after from, slots if none
+    uint32_t busySlot(int level, uint32_t from) const {
+        for (uint32_t word = from / 64; word < slots / 64; word++) {
+            uint64_t bits = busy[level][word];
+            if (word == from / 64) bits &= ~0ull << (from % 64);
+            if (bits) return word * 64 + __builtin_ctzll(bits);
+        }
+        return slots;
+    }
+
+    // Function to find the next tick after current at which a timer fires or moves down a level:
+    // the start of the next busy slot of some level in its current turn, or, for a level whose
+    // busy slots all come round in its next turn, the tick that turn starts
+    uint64_t nextEvent() const {
+        uint64_t next = UINT64_MAX;
+        for (int level = 0; level < levels; level++) {
+            int shift = levelBits * level;
+            uint64_t turnStart = current >> (shift + levelBits) << (shift + levelBits);
+            uint32_t slot = busySlot(level, ((current >> shift) & (slots - 1)) + 1);
+            if (slot < slots) next = min(next, turnStart + (static_cast<uint64_t>(slot) << shift));
+            else if (busySlot(level, 0) < slots) next = min(next, turnStart + (uint64_t{1} << (shift + levelBits)));
+        }
+        return next;
+    }
+
+public:
+    explicit TimingWheel(uint64_t now = 0) : current(now) { fill(begin(heads), end(heads), none); }
+
+    // Function to schedule payload for a tick; a deadline already passed fires on the next advance()
+    Handle schedule(uint64_t deadline, uint64_t payload) {
+        uint32_t index;
+        if (freeNodes != none) {
+            index = freeNodes;
+            freeNodes = nodes[index].next;
+        } else {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node{});
+        }
+        nodes[index].deadline = deadline;
+        nodes[index].payload = payload;
+        link(index);
+        count++;
+        return (static_cast<uint64_t>(nodes[index].generation) << 32) | (index + 1ull);
+    }
+
+    // Function to cancel a timer; false if it already fired or was cancelled
+    bool cancel(Handle handle) {
+        uint32_t index = static_cast<uint32_t>(handle) - 1;
+        if (handle == 0 || index >= nodes.size() || nodes[index].bucket == unused ||
+            nodes[index].generation != static_cast<uint32_t>(handle >> 32)) {
+            return false;
+        }
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    // Function to fire, in deadline order by tick, every timer due by now, calling fire(payload) for each.
+    // Stops after budget timers, leaving the rest due for the next call. fire may schedule and
+    // cancel timers. Returns the number fired.
+    template <typename Fire>
+    size_t advance(uint64_t now, Fire&& fire, size_t budget = SIZE_MAX) {
+        size_t fired = 0;
+        while (true) {
+            uint32_t bucket = current & (slots - 1);
+            while (heads[bucket] != none) {
+                if (fired == budget) return fired;
+                uint32_t index = heads[bucket];
+                uint64_t payload = nodes[index].payload;
+                unlink(index);
+                release(index);
+                fired++;
+                fire(payload);
+            }
+            if (current >= now) return fired;
+            current = min(now, nextEvent());
+            if ((current & (slots - 1)) == 0) cascade();
+        }
+    }
+
+    // Function to give the earliest tick advance() has work at (a timer to fire, or timers
+    // to move down a level); UINT64_MAX when nothing is scheduled
+    uint64_t nextDue() const {
+        if (count == 0) return UINT64_MAX;
+        return heads[current & (slots - 1)] != none ? current : nextEvent();
+    }
+
+    size_t size() const { return count; }
+    uint64_t now() const { return current; }
+};
+
+
+// One taker's walk through the quiz over the server's line protocol. It
+// follows conductQuiz(): move to the next unanswered question or jump to
+// one by id, answer or re-answer the current question, and submit, with
+// the same "submit anyway?" check when answers are missing.
+//   NEXT              -> "Q ..." for the next unanswered question, or "NONE"
+//   JUMP <id>         -> "Q ...", "ERR question not found" or "ERR time is up for question <id>"
+//   ANSWER <text>     -> "OK" (answers the current question)
+//   SUBMIT            -> "CONFIRM <n> unanswered" if any are blank, else "SCORE <score> <total>"
+//   SUBMIT FORCE      -> "SCORE <score> <total>" and the session ends
+//   QUIT              -> "BYE" and the session ends
+// A timed session greets with "READY <questions> TIMED <exam ms> <question ms>"
+// (0 for no limit) and the server also sends lines of its own between replies:
+//   WARN EXAM <seconds> / WARN QUESTION <id> <seconds>   a limit is near
+//   EXPIRED <id>      the question's time is used up; it can no longer be shown or answered
+//   TIMEOUT           the exam's time is up; the sheet is submitted as it stands and
+//                     the SCORE line follows
+// Limits are also checked on every request, so none is overrun while an
+// alarm is still on its way.
+// Sessions share one published bank and keep only their own AnswerSheet.
+class QuizSession {
+public:
+    using Clock = chrono::steady_clock;
+    enum Alarm { examAlarm, questionAlarm, alarmCount };
+
+private:
+    shared_ptr<const QuestionBank> bank;
+    AnswerSheet sheet;
+    int current = -1;  // Id of the question being answered, -1 before the first NEXT/JUMP
+#ifdef METRICS
+    chrono::steady_clock::time_point shownAt;  // When current was sent, for think time
+#endif
+    ExamTiming timing;
+    Clock::time_point examDue = Clock::time_point::max();
+    Clock::time_point questionDue = Clock::time_point::max();  // When current's time runs out
+    Clock::time_point shownSince;                  // When current was shown
+    bool warned[alarmCount] = {};                  // Warning sent for the exam, for current
+    vector<pair<int, Clock::duration>> timeUsed;   // Time each question has been on screen before
+    vector<int> closedIds;                         // Questions whose time is up
+    int closedUnanswered = 0;                      // Of those, how many have no answer
+
+    static string formatScore(double score, double total) {
+        char text[96];
+        snprintf(text, sizeof(text), "SCORE %.2f %.2f", score, total);
+        return text;
+    }
+
+    static long secondsLeft(Clock::time_point due, Clock::time_point now) {
+        return static_cast<long>(chrono::ceil<chrono::seconds>(due - now).count());
+    }
+
+    bool isClosed(int id) const { return find(closedIds.begin(), closedIds.end(), id) != closedIds.end(); }
+
+    Clock::duration& usedBy(int id) {
+        for (auto& entry : timeUsed) if (entry.first == id) return entry.second;
+        timeUsed.push_back({id, Clock::duration::zero()});
+        return timeUsed.back().second;
+    }
+
+    // Function to stop the clock on the question being shown
+    void leaveQuestion(Clock::time_point now) {
+        if (current != -1 && timing.question.count() > 0) usedBy(current) += now - shownSince;
+        current = -1;
+        questionDue = Clock::time_point::max();
+    }
+
+    // Function to make id the question being shown and start its clock
+    void showQuestion(int id, Clock::time_point now) {
+        current = id;
+        shownSince = now;
+        warned[questionAlarm] = false;
+        if (timing.question.count() > 0) questionDue = now + (timing.question - usedBy(id));
+    }
+
+    // Function to close the question being shown because its time is up; returns the EXPIRED line
+    string closeQuestion(Clock::time_point now) {
+        int id = current;
+        leaveQuestion(now);
+        closedIds.push_back(id);
+        const QuestionStore& questions = bank->questions;
+        if (sheet.answer(questions, questions.slotOf(id)).empty()) closedUnanswered++;
+        return "EXPIRED " + to_string(id);
+    }
+
+    string submit() {
+        return formatScore(fromFixedPoints(gradeSheet(bank->questions, sheet)), bank->totalPoints);
+    }
+
+public:
+    QuizSession(shared_ptr<const QuestionBank> questions, const ExamTiming& limits = ExamTiming(), Clock::time_point now = Clock::now())
+        : bank(std::move(questions)), timing(limits) {
+        if (timing.exam.count() > 0) examDue = now + timing.exam;
+    }
+
+    string greeting() {
+        string line = "READY " + to_string(bank->questions.size());
+        if (timing.timed()) line += " TIMED " + to_string(timing.exam.count()) + ' ' + to_string(timing.question.count());
+        return line;
+    }
+
+    // Function to report the heap bytes this session's answers hold
+    size_t memoryBytes() const {
+        return sheet.memoryBytes() + timeUsed.capacity() * sizeof(timeUsed[0]) + closedIds.capacity() * sizeof(int);
+    }
+
+    // Function to give when the session next wants alarm called: a warning or a limit. max() if never.
+    Clock::time_point alarmTime(Alarm alarm) const {
+        Clock::time_point due = alarm == examAlarm ? examDue : questionDue;
+        if (due == Clock::time_point::max() || warned[alarm]) return due;
+        return due - timing.warning;
+    }
+
+    // Function to act on an alarm that has come due: the line(s) to send, empty if there is nothing
+    // to say. close is set when the exam's time is up and the sheet has been submitted.
+    string alarm(Alarm alarm, Clock::time_point now, bool& close) {
+        close = false;
+        if (alarm == examAlarm) {
+            if (now >= examDue) {
+                close = true;
+                return "TIMEOUT\n" + submit();
+            }
+            if (warned[examAlarm] || now < alarmTime(examAlarm)) return string();
+            warned[examAlarm] = true;
+            return "WARN EXAM " + to_string(secondsLeft(examDue, now));
+        }
+        if (current == -1) return string();
+        if (now >= questionDue) return closeQuestion(now);
+        if (warned[questionAlarm] || now < alarmTime(questionAlarm)) return string();
+        warned[questionAlarm] = true;
+        return "WARN QUESTION " + to_string(current) + ' ' + to_string(secondsLeft(questionDue, now));
+    }
+
+    // Function to run one protocol line and return the reply; close is set when the session ends
+    string handle(string_view line, bool& close, Clock::time_point now = Clock::now()) {
+        close = false;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t space = line.find(' ');
+        string_view command = line.substr(0, space);
+        string_view argument = space == string_view::npos ? string_view() : line.substr(space + 1);
+        const QuestionStore& questions = bank->questions;
+        string reply;
+        // Limits hold even if the alarm has not been delivered yet
+        if (now >= examDue && command != "QUIT") return alarm(examAlarm, now, close);
+        if (current != -1 && now >= questionDue) reply = closeQuestion(now) + '\n';
+        if (command == "NEXT") {
+            leaveQuestion(now);
+            int slot = sheet.firstUnanswered(questions);
+            while (slot != -1 && isClosed(questions.row(slot).id)) {
+                do slot = questions.nextLive(slot + 1);
+                while (slot != -1 && !sheet.answer(questions, slot).empty());
+            }
+            string shown;
+            if (slot == -1 || !renderQuestion(questions, questions.row(slot).id, shown)) return reply + "NONE";
+            showQuestion(questions.row(slot).id, now);
+#ifdef METRICS
+            shownAt = chrono::steady_clock::now();
+#endif
+            return reply + shown;
+        }
+        if (command == "JUMP") {
+            int id = -1;
+            from_chars(argument.data(), argument.data() + argument.size(), id);
+            string shown;
+            if (isClosed(id)) return reply + "ERR time is up for question " + to_string(id);
+            if (!renderQuestion(questions, id, shown)) return reply + "ERR question not found";
+            leaveQuestion(now);
+            showQuestion(id, now);
+#ifdef METRICS
+            shownAt = chrono::steady_clock::now();
+#endif
+            return reply + shown;
+        }
+        if (command == "ANSWER") {
+            if (current == -1) return reply + "ERR no current question";
+            METRIC_RECORD(thinkTime, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - shownAt).count());
+            string answer(argument);
+            for (auto& c : answer) c = tolower(c);  // Lowercased as Quiz::recordAnswer does
+            sheet.setAnswer(questions, questions.slotOf(current), answer);
+            return reply + "OK";
+        }
+        if (command == "SUBMIT") {
+            int unanswered = sheet.unansweredCount(questions) - closedUnanswered;
+            if (unanswered > 0 && argument != "FORCE") return reply + "CONFIRM " + to_string(unanswered) + " unanswered";
+            close = true;
+            return reply + submit();
+        }
+        if (command == "QUIT") {
+            close = true;
+            return "BYE";
+        }
+        return reply + "ERR unknown command";
+    }
+};
+
+
+// Function to parse "unix:/path", "tcp:host:port" or "tcp:port" into a socket address
+bool parseSocketAddress(const string& text, sockaddr_storage& address, socklen_t& length) {
+    memset(&address, 0, sizeof(address));
+    if (text.rfind("unix:", 0) == 0) {
+        string path = text.substr(5);
+        sockaddr_un* local = reinterpret_cast<sockaddr_un*>(&address);
+        if (path.empty() || path.size() >= sizeof(local->sun_path)) return false;
+        local->sun_family = AF_UNIX;
+        memcpy(local->sun_path, path.c_str(), path.size() + 1);
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+    if (text.rfind("tcp:", 0) == 0) {
+        string rest = text.substr(4), host = "127.0.0.1";
+        size_t colon = rest.rfind(':');
+        if (colon != string::npos) {
+            host = rest.substr(0, colon);
+            rest = rest.substr(colon + 1);
+        }
+        int port = -1;
+        from_chars(rest.data(), rest.data() + rest.size(), port);
+        sockaddr_in* inet = reinterpret_cast<sockaddr_in*>(&address);
+        inet->sin_family = AF_INET;
+        inet->sin_port = htons(static_cast<uint16_t>(port));
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &inet->sin_addr) != 1) return false;
+        length = sizeof(sockaddr_in);
+        return true;
+    }
+    return false;
+}
+
+
+// Event-driven server running many QuizSessions in one process. Each worker
+// thread owns an epoll set holding the shared listening socket (registered
+// with EPOLLEXCLUSIVE so one worker wakes per new connection) and the
+// connections it accepted, so a connection is only ever touched by one
+// thread and needs no locking. A new connection pins the current bank
+// version; publishing a new version affects only sessions started after it.
+// Time limits run on a millisecond TimingWheel per worker holding its
+// connections' alarms; epoll_wait sleeps until the wheel's next due tick,
+// and at most alarmBudget alarms are handled between rounds of socket
+// events, so a burst of deadlines never holds up takers who are answering.
+class QuizServer {
+private:
+    struct Connection {
+        int fd;
+        string input;
+        string output;
+        size_t sent = 0;
+        bool closing = false;
+        uint32_t events = EPOLLIN | EPOLLRDHUP;  // What epoll is watching for
+        QuizSession session;
+        TimingWheel::Handle alarms[QuizSession::alarmCount] = {};         // Scheduled alarms, 0 if none
+        QuizSession::Clock::time_point armedFor[QuizSession::alarmCount]; // When each is scheduled for
+        Connection(int socket, shared_ptr<const QuestionBank> bank, const ExamTiming& timing)
+            : fd(socket), session(std::move(bank), timing) {
+            fill(begin(armedFor), end(armedFor), QuizSession::Clock::time_point::max());
+        }
+    };
+    static_assert((QuizSession::alarmCount & (QuizSession::alarmCount - 1)) == 0 && alignof(Connection) >= QuizSession::alarmCount,
+                  "alarm numbers must fit in the low bits of a Connection pointer");
+
+    BankPublisher versions;
+    ExamTiming timing;
+    QuizSession::Clock::time_point epoch = QuizSession::Clock::now();  // Tick 0 of the workers' wheels
+    static const size_t alarmBudget = 1024;
+    int listenFd = -1;
+    string unixPath;              // Socket file to remove on stop
+    vector<int> wakeFds;          // One eventfd per worker, written to stop it
+    vector<thread> workers;
+    atomic<bool> stopping{false};
+    atomic<size_t> sessionsServed{0};
+    static const size_t maxLineLength = 1 << 16;
+    char listenTag = 0, wakeTag = 0;  // Addresses mark non-connection epoll entries
+
+    // Function to send pending output; returns false if the connection broke
+    bool flushOutput(Connection& connection) {
+        while (connection.sent < connection.output.size()) {
+            ssize_t n = send(connection.fd, connection.output.data() + connection.sent,
+                             connection.output.size() - connection.sent, MSG_NOSIGNAL);
+            if (n > 0) { connection.sent += n; continue; }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        connection.output.clear();
+        connection.sent = 0;
+        return true;
+    }
+
+    // Function to give the first tick at or after a time, so an alarm never fires early;
+    // times before the server started are tick 0, due at once
+    uint64_t tickOf(QuizSession::Clock::time_point time) const {
+        if (time <= epoch) return 0;
+        return static_cast<uint64_t>(chrono::ceil<chrono::milliseconds>(time - epoch).count());
+    }
+
+    // Function to give the last tick that has fully begun
+    uint64_t currentTick() const {
+        return static_cast<uint64_t>(chrono::floor<chrono::milliseconds>(QuizSession::Clock::now() - epoch).count());
+    }
+
+    // Function to bring a connection's scheduled alarms in line with what its session wants
+    void rearm(TimingWheel& wheel, Connection& connection) {
+        for (int alarm = 0; alarm < QuizSession::alarmCount; alarm++) {
+            auto wanted = connection.session.alarmTime(static_cast<QuizSession::Alarm>(alarm));
+            if (wanted == connection.armedFor[alarm]) continue;
+            wheel.cancel(connection.alarms[alarm]);
+            connection.alarms[alarm] = 0;
+            connection.armedFor[alarm] = wanted;
+            if (wanted != QuizSession::Clock::time_point::max()) {
+                // The alarm's number rides in the low bits of the (aligned) connection pointer
+                connection.alarms[alarm] = wheel.schedule(tickOf(wanted), reinterpret_cast<uintptr_t>(&connection) | alarm);
+            }
+        }
+    }
+
+    // Function to read what is available and answer every complete line; returns false to close.
+    // A client that half-closes still gets replies to the lines it sent before, then the connection closes.
+    bool serviceRead(Connection& connection) {
+        char block[4096];
+        bool ended = false;
+        while (!connection.closing) {
+            ssize_t n = recv(connection.fd, block, sizeof(block), 0);
+            if (n > 0) { connection.input.append(block, n); continue; }
+            if (n == 0) { ended = true; break; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        size_t start = 0, newline;
+        while (!connection.closing && (newline = connection.input.find('\n', start)) != string::npos) {
+            bool close = false;
+            connection.output += connection.session.handle(string_view(connection.input).substr(start, newline - start), close);
+            connection.output += '\n';
+            connection.closing = close;
+            start = newline + 1;
+        }
+        connection.input.erase(0, start);
+        if (ended) connection.closing = true;
+        return connection.input.size() <= maxLineLength;
+    }
+
+    void runWorker(int epollFd) {
+        unordered_map<Connection*, unique_ptr<Connection>> connections;
+        TimingWheel wheel(currentTick());
+        bool alarmsPending = false;  // The last pass hit alarmBudget
+        epoll_event events[256];
+        auto drop = [&](Connection* connection) {
+            for (TimingWheel::Handle alarm : connection->alarms) wheel.cancel(alarm);
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+            ::close(connection->fd);
+            connections.erase(connection);
+        };
+        // Function to hand pending output to epoll or close the connection once it is done; false if dropped
+        auto settle = [&](Connection* connection, bool alive) {
+            if (alive) alive = flushOutput(*connection);
+            if (!alive || (connection->closing && connection->output.empty())) {
+                drop(connection);
+                return false;
+            }
+            // A closing connection only waits for its last replies to drain
+            uint32_t wanted = (connection->closing ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)) |
+                              (connection->output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+            if (wanted != connection->events) {
+                epoll_event event{};
+                event.events = wanted;
+                event.data.ptr = connection;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+                connection->events = wanted;
+            }
+            return true;
+        };
+        auto fire = [&](uint64_t payload) {
+            Connection* connection = reinterpret_cast<Connection*>(payload & ~uint64_t(QuizSession::alarmCount - 1));
+            auto alarm = static_cast<QuizSession::Alarm>(payload & (QuizSession::alarmCount - 1));
+            connection->alarms[alarm] = 0;
+            connection->armedFor[alarm] = QuizSession::Clock::time_point::max();
+            if (connection->closing) return;
+            bool close = false;
+            string line = connection->session.alarm(alarm, QuizSession::Clock::now(), close);
+            if (!line.empty()) connection->output += line + '\n';
+            connection->closing = close;
+            rearm(wheel, *connection);
+            settle(connection, true);
+        };
+        while (!stopping) {
+            int timeout = -1;
+            if (alarmsPending) {
+                timeout = 0;
+            } else if (wheel.size() > 0) {
+                uint64_t now = currentTick(), due = wheel.nextDue();
+                timeout = due <= now ? 0 : static_cast<int>(min<uint64_t>(due - now, 1000));
+            }
+            int count = epoll_wait(epollFd, events, 256, timeout);
+            for (int i = 0; i < count; i++) {
+                void* tag = events[i].data.ptr;
+                if (tag == &wakeTag) continue;
+                if (tag == &listenTag) {
+                    int fd;
+                    while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                        int on = 1;
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                        auto connection = make_unique<Connection>(fd, versions.pin(), timing);
+                        connection->output = connection->session.greeting() + '\n';
+                        epoll_event event{};
+                        event.events = EPOLLIN | EPOLLRDHUP;
+                        event.data.ptr = connection.get();
+                        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+                        Connection* raw = connection.get();
+                        connections.emplace(raw, std::move(connection));
+                        sessionsServed++;
+                        rearm(wheel, *raw);
+                        if (!flushOutput(*raw)) drop(raw);
+                    }
+                    continue;
+                }
+                Connection* connection = static_cast<Connection*>(tag);
+                bool alive = true;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) alive = serviceRead(*connection);
+                if (alive && !connection->closing) rearm(wheel, *connection);
+                settle(connection, alive);
+            }
+            if (wheel.size() > 0 || alarmsPending) {
+                alarmsPending = wheel.advance(currentTick(), fire, alarmBudget) == alarmBudget;
+            }
+        }
+        for (auto& entry : connections) ::close(entry.second->fd);
+        ::close(epollFd);
+    }
+
+public:
+    explicit QuizServer(shared_ptr<const QuestionBank> questions, const ExamTiming& limits = ExamTiming())
+        : versions(std::move(questions)), timing(limits) {}
+    ~QuizServer() { stop(); }
+    QuizServer(const QuizServer&) = delete;
+    QuizServer& operator=(const QuizServer&) = delete;
+
+    // Function to bind the address and start the workers; returns false with a message on failure
+    bool start(const string& addressText, unsigned threadCount, string& error) {
+        sockaddr_storage address;
+        socklen_t length;
+        if (!parseSocketAddress(addressText, address, length)) { error = "bad address " + addressText; return false; }
+        listenFd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) { error = "socket failed"; return false; }
+        int on = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (address.ss_family == AF_UNIX) {
+            unixPath = reinterpret_cast<sockaddr_un*>(&address)->sun_path;
+            unlink(unixPath.c_str());
+        }
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(listenFd, 4096) != 0) {
+            error = "cannot listen on " + addressText + ": " + strerror(errno);
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        if (threadCount == 0) threadCount = 1;
+        for (unsigned i = 0; i < threadCount; i++) {
+            int epollFd = epoll_create1(EPOLL_CLOEXEC);
+            int wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLEXCLUSIVE;
+            event.data.ptr = &listenTag;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+            event.events = EPOLLIN;
+            event.data.ptr = &wakeTag;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+            wakeFds.push_back(wakeFd);
+            workers.emplace_back(&QuizServer::runWorker, this, epollFd);
+        }
+        return true;
+    }
+
+    // Function to stop the workers and close every connection
+    void stop() {
+        if (workers.empty()) return;
+        stopping = true;
+        for (int wakeFd : wakeFds) {
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+        for (auto& worker : workers) worker.join();
+        for (int wakeFd : wakeFds) ::close(wakeFd);
+        workers.clear();
+        wakeFds.clear();
+        ::close(listenFd);
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+    }
+
+    size_t sessionCount() const { return sessionsServed.load(); }
+
+    // Function to serve a new bank version to sessions that start from now on; returns its version number
+    uint64_t publish(shared_ptr<const QuestionBank> questions) { return versions.publish(std::move(questions)); }
+};
+
+
+// Results of a load test against a running server
+struct LoadTestReport {
+    size_t sessions = 0;          // Sessions that reached a SCORE reply
+    size_t requests = 0;          // Request/reply round trips timed
+    size_t failures = 0;          // Sessions that broke off early
+    double seconds = 0.0;
+    double p50Micros = 0.0;
+    double p99Micros = 0.0;
+};
+
+// Function to run scripted takers against a server: each of concurrency threads
+// opens sessions one after another, answers every question with NEXT/ANSWER and
+// submits. Every request's round trip is timed for the latency percentiles.
+LoadTestReport runLoadTest(const string& addressText, size_t sessions, unsigned concurrency) {
+    LoadTestReport report;
+    sockaddr_storage address;
+    socklen_t length;
+    if (!parseSocketAddress(addressText, address, length) || concurrency == 0) return report;
+    atomic<size_t> nextSession{0}, completed{0}, failed{0};
+    vector<vector<float>> latencies(concurrency);
+    auto start = chrono::steady_clock::now();
+
+    auto taker = [&](unsigned index) {
+        SplitMix64 random(index + 1);
+        string buffer, reply;
+        vector<float>& timings = latencies[index];
+        while (nextSession.fetch_add(1) < sessions) {
+            int fd = socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), length) != 0) {
+                if (fd >= 0) ::close(fd);
+                failed++;
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            buffer.clear();
+            // Function to read one reply line; false if the server hung up
+            auto readLine = [&]() {
+                size_t newline;
+                char block[4096];
+                while ((newline = buffer.find('\n')) == string::npos) {
+                    ssize_t n = recv(fd, block, sizeof(block), 0);
+                    if (n <= 0) return false;
+                    buffer.append(block, n);
+                }
+                reply.assign(buffer, 0, newline);
+                buffer.erase(0, newline + 1);
+                return true;
+            };
+            auto request = [&](const string& line) {
+                auto sent = chrono::steady_clock::now();
+                if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size())) return false;
+                bool ok = readLine();
+                // Skip what a timed server says unprompted; after TIMEOUT the SCORE line is the reply
+                while (ok && (reply.rfind("WARN ", 0) == 0 || reply.rfind("EXPIRED ", 0) == 0 || reply == "TIMEOUT")) ok = readLine();
+                timings.push_back(chrono::duration<float, micro>(chrono::steady_clock::now() - sent).count());
+                return ok;
+            };
+            auto scored = [&reply] { return reply.rfind("SCORE", 0) == 0; };  // Also how a timed-out exam ends
+            bool ok = readLine();  // READY greeting
+            while (ok) {
+                ok = request("NEXT\n");
+                if (!ok || reply == "NONE" || scored()) break;
+                ok = request(string("ANSWER ") + static_cast<char>('a' + random.below(4)) + "\n");
+                if (scored()) break;
+            }
+            ok = ok && (scored() || (request("SUBMIT FORCE\n") && scored()));
+            (ok ? completed : failed)++;
+            ::close(fd);
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 0; i < concurrency; i++) threads.emplace_back(taker, i);
+    for (auto& t : threads) t.join();
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report.sessions = completed;
+    report.failures = failed;
+
+    vector<float> all;
+    for (auto& timings : latencies) all.insert(all.end(), timings.begin(), timings.end());
+    report.requests = all.size();
+    if (!all.empty()) {
+        auto percentile = [&all](double p) {
+            size_t rank = min(all.size() - 1, static_cast<size_t>(p * (all.size() - 1) + 0.5));
+            nth_element(all.begin(), all.begin() + rank, all.end());
+            return static_cast<double>(all[rank]);
+        };
+        report.p50Micros = percentile(0.50);
+        report.p99Micros = percentile(0.99);
+    }
+    return report;
+}
+
+
+// Function to serve a saved bank until interrupted, reloading it on SIGHUP (--serve mode)
+int runServer(const string& bankPath, const string& address, unsigned threads, const ExamTiming& timing) {
+    Quiz quiz;
+    if (!quiz.open(bankPath)) return 1;
+    // Block the stop and reload signals before starting workers so only sigwait sees them
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    sigaddset(&stopSignals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    QuizServer server(quiz.publish(), timing);
+    string error;
+    if (!server.start(address, threads, error)) {
+        cout << "[Could not start server: " << error << "]" << endl;
+        return 1;
+    }
+    cout << "Serving " << quiz.getQuestionCount() << " questions on " << address << " with " << threads << " threads" << endl;
+    int received;
+    // SIGHUP re-reads the bank file; sessions already running finish on the version they started with
+    while (sigwait(&stopSignals, &received) == 0 && received == SIGHUP) {
+        if (!quiz.open(bankPath)) continue;
+        uint64_t version = server.publish(quiz.publish());
+        cout << "Published version " << version << " with " << quiz.getQuestionCount() << " questions" << endl;
+    }
+    server.stop();
+    cout << "Served " << server.sessionCount() << " sessions" << endl;
+    return 0;
+}
+
+// Function to load-test a running server and print the latency report (--loadtest mode)
+int runLoadTestCommand(const string& address, size_t sessions, unsigned concurrency) {
+    LoadTestReport report = runLoadTest(address, sessions, concurrency);
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    cout << fixed << setprecision(1)
+         << "Sessions: " << report.sessions << " completed, " << report.failures << " failed in " << report.seconds << "s\n"
+         << "Requests: " << report.requests << ", p50 " << report.p50Micros << " us, p99 " << report.p99Micros << " us\n"
+         << "Throughput: " << report.sessions / max(report.seconds, 1e-9) << " sessions/s, "
+         << report.sessions / max(report.seconds, 1e-9) / cores << " sessions/s per core (" << cores << " cores)" << endl;
+    return report.failures == 0 ? 0 : 2;
+}
+
+
+// Function to grade a file of answer sheets against a saved bank, optionally writing an item analysis (--grade mode)
+int runBatchGrading(const string& bankPath, const string& submissionsPath, const string& scoresPath,
+                    const string& reportPath = "") {
+    MappedBank bank;
+    if (!bank.open(bankPath) || !bank.checkRecords()) {
+        cout << "[Could not open quiz bank: " << bank.lastError() << "]" << endl;
+        return 1;
+    }
+    ifstream submissions(submissionsPath);
+    ofstream scores(scoresPath);
+    if (!submissions || !scores) {
+        cout << "[Could not open submissions or scores file]" << endl;
+        return 1;
+    }
+    GradingKey key = GradingKey::fromBank(bank);
+    WorkStealingPool pool;
+    ItemAccumulator items;
+    BatchGradeStats stats = gradeBatch(key, submissions, scores, pool, 512, reportPath.empty() ? nullptr : &items);
+    cout << "Graded " << stats.sheets << " sheets (" << stats.rejectedLines << " rejected) on "
+         << pool.size() << " threads in " << fixed << setprecision(3) << stats.seconds << "s: "
+         << setprecision(0) << stats.sheetsPerSecond() << " sheets/s" << endl;
+    if (!reportPath.empty()) {
+        ofstream report(reportPath);
+        items.writeReport(key, report);
+        if (!report) {
+            cout << "[Could not write item analysis to " << reportPath << "]" << endl;
+            return 1;
+        }
+        cout << "Item analysis written to " << reportPath << endl;
+    }
+    return 0;
+}
+
+// Function to rank the attempts in a scores file (--leaderboard mode): the top ten,
+// score quantiles, and where each named student stands
+int runLeaderboard(const string& scoresPath, const vector<string>& students) {
+    ifstream attempts(scoresPath);
+    if (!attempts) {
+        cout << "[Could not open scores file]" << endl;
+        return 1;
+    }
+    Leaderboard board(10);
+    WorkStealingPool pool;
+    auto start = chrono::steady_clock::now();
+    size_t rejected = board.ingest(attempts, pool);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Ranked " << board.attempts() << " attempts by " << board.students() << " students (" << rejected
+         << " rejected) on " << pool.size() << " threads in " << fixed << setprecision(3) << seconds << "s" << endl;
+    cout << setprecision(2);
+    vector<LeaderboardEntry> leaders = board.leaders();
+    for (size_t i = 0; i < leaders.size(); i++) {
+        cout << setw(4) << i + 1 << ". " << leaders[i].student << "\t" << fromFixedPoints(leaders[i].score) << endl;
+    }
+    cout << "Quantiles: p25 " << board.quantile(0.25) << ", p50 " << board.quantile(0.5) << ", p75 "
+         << board.quantile(0.75) << ", p90 " << board.quantile(0.9) << ", p99 " << board.quantile(0.99) << endl;
+    for (const string& student : students) {
+        Standing standing;
+        if (!board.standing(student, standing)) {
+            cout << student << ": [No attempts]" << endl;
+            continue;
+        }
+        cout << student << ": score " << standing.score << ", rank " << standing.rank << " of " << board.students()
+             << ", percentile " << standing.percentile << endl;
+    }
+    return 0;
+}
+
+// Function to import a CSV or JSONL file into a quiz and print what happened; false if it could not be read
+// or the imported questions could not be journaled
+bool importQuestions(Quiz& quiz, const string& path) {
+    BankImporter importer;
+    if (!importer.open(path)) {
+        cout << "[Could not import: " << importer.lastError() << "]" << endl;
+        return false;
+    }
+    WorkStealingPool pool;
+    ImportStats stats = importer.run(quiz, pool);
+    const size_t shown = 20;
+    for (size_t i = 0; i < importer.errors().size() && i < shown; i++) {
+        cout << "[Line " << importer.errors()[i].line << ": " << importer.errors()[i].message << "]" << endl;
+    }
+    if (importer.errors().size() > shown) cout << "[... " << importer.errors().size() - shown << " more]" << endl;
+    if (!quiz.syncJournal()) {
+        cout << "[" << Quiz::journalFailedMessage << "]" << endl;
+        return false;
+    }
+    cout << "Imported " << stats.questions << " questions (" << stats.rejected << " rejected) on " << pool.size()
+         << " threads in " << fixed << setprecision(3) << stats.seconds << "s: " << setprecision(0)
+         << stats.megabytesPerSecond() << " MB/s" << endl;
+    return true;
+}
+
+// Function to import a CSV or JSONL file and save it as a bank file (--import mode)
+int runImport(const string& inputPath, const string& bankPath) {
+    Quiz quiz;
+    if (!importQuestions(quiz, inputPath)) return 1;
+    return quiz.save(bankPath) ? 0 : 1;
+}
+
+// Function to generate and re-verify randomized forms for a class of students (--forms mode)
+int runFormGeneration(const string& bankPath, size_t students, size_t questionsPerForm, uint64_t seed) {
+    Quiz quiz;
+    if (!quiz.open(bankPath)) return 1;
+    FormSpec spec;
+    spec.questions = questionsPerForm;
+    spec.stratify = FormSpec::byType;
+    spec.seed = seed;
+    FormGenerator forms(quiz.publish(), spec);
+    WorkStealingPool pool;
+    vector<uint64_t> digests(students);
+
+    auto start = chrono::steady_clock::now();
+    forms.generateDigests(0, digests, pool);
+    double generateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    size_t mismatches = forms.verifyDigests(0, digests, pool);
+    double verifySeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Generated " << students << " forms of " << forms.questionsPerForm() << " questions on " << pool.size()
+         << " threads: " << fixed << setprecision(0) << students / max(generateSeconds, 1e-9) << " forms/s generated, "
+         << students / max(verifySeconds, 1e-9) << " forms/s verified, " << mismatches << " mismatches" << endl;
+    if (students > 0) {
+        ExamForm form;
+        forms.generate(0, form);
+        cout << "Student 0 key:";
+        for (int slot : form.slots) {
+            cout << ' ' << forms.questions().row(slot).id << '=' << forms.formAnswer(0, slot);
+        }
+        cout << endl;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Function to sit a saved bank at the console, submitted automatically when its time is up (--take mode)
+int runTimedExam(const string& bankPath, chrono::seconds limit) {
+    ios::sync_with_stdio(false);  // Gives cin its own buffer, which awaitInput() can see into
+    Quiz quiz;
+    if (!quiz.open(bankPath)) return 1;
+    ExamTiming timing;
+    timing.exam = limit;
+    timing.warning = min(timing.warning, chrono::milliseconds(limit) / 5);
+    quiz.setTiming(timing);
+    if (limit.count() > 0) cout << "You have " << limit.count() << " seconds." << endl;
+    quiz.conductQuiz();
+    quiz.submit();
+    return 0;
+}
+
+// Function to give one taker an adaptive test at the console (--adaptive mode)
+int runAdaptive(const string& bankPath, size_t questions) {
+    Quiz quiz;
+    if (!quiz.open(bankPath)) return 1;
+    AdaptiveSpec spec;
+    spec.questions = questions;
+    spec.seed = static_cast<uint64_t>(chrono::system_clock::now().time_since_epoch().count());
+    AdaptiveTest test(quiz.publish(), spec);
+    AdaptiveSession session(test, 0);
+    const QuestionStore& store = test.questions();
+    string answer;
+    for (int slot = session.next(); slot != -1 && cin; slot = session.next()) {
+        const Question& question = store.row(slot);
+        cout << "Question " << session.asked() + 1 << " of " << test.questionsPerTest() << ": " << question.text(store.strings()) << endl;
+        for (int i = 0; i < question.choiceCount; i++) {
+            cout << question.choiceLetter(i) << ". " << question.choiceText(store.strings(), i) << endl;
+        }
+        cout << "Your answer" << visitType(store.type(slot), [](auto type) { return decltype(type)::answerHint; }) << ": ";
+        if (!getline(cin, answer)) answer.clear();
+        session.answer(answer);
+    }
+    cout << fixed << setprecision(2) << "Ability estimate: " << session.ability() << " (standard error "
+         << session.standardError() << ") after " << session.asked() << " questions" << endl;
+    return 0;
+}
+
+// Function to list clusters of near-duplicate questions in a saved bank (--duplicates mode)
+int runDuplicates(const string& bankPath, double threshold) {
+    MappedBank bank;
+    if (!bank.open(bankPath)) {
+        cout << "[Could not open quiz bank: " << bank.lastError() << "]" << endl;
+        return 1;
+    }
+    if (!(threshold > 0 && threshold <= 1)) {
+        cout << "[Similarity threshold must be above 0 and at most 1]" << endl;
+        return 1;
+    }
+    WorkStealingPool pool;
+    auto source = [&bank](size_t index, MinHasher& hasher) {
+        hasher.add(bank, index);
+        return bank.record(index).id;
+    };
+    DuplicateReport report = findNearDuplicates(bank.size(), source, threshold, pool);
+    cout << fixed << setprecision(2);
+    for (const DuplicateCluster& cluster : report.clusters) {
+        cout << cluster.members[0].id << ":";
+        for (size_t i = 1; i < cluster.members.size(); i++) {
+            cout << ' ' << cluster.members[i].id << " (" << cluster.members[i].similarity << ")";
+        }
+        cout << '\n';
+    }
+    cout << "Compared " << report.questions << " questions on " << pool.size() << " threads in " << setprecision(3)
+         << report.seconds << "s: " << report.candidates << " candidate pairs, " << report.similarPairs
+         << " at or above " << setprecision(2) << threshold << ", " << report.clusters.size() << " clusters" << endl;
+    return 0;
+}
+
+// Function to print what interning and text coding save, field by field
+void printStringMemory(const StringMemory& memory) {
+    auto row = [](const char* field, const StringMemory::Field& counts) {
+        printf("%-8s %10zu values %12zu bytes as strings %12zu stored %12lld saved\n", field, counts.values,
+               counts.plainBytes, counts.storedBytes, counts.saved());
+    };
+    row("text", memory.text);
+    row("choices", memory.choices);
+    row("answers", memory.answers);
+    size_t plain = memory.text.plainBytes + memory.choices.plainBytes + memory.answers.plainBytes;
+    printf("%-8s %10zu strings %11zu bytes\n", "pool", memory.poolStrings, memory.poolBytes);
+    printf("%-8s %12lld bytes saved (%.1f%% of %zu)\n", "net", memory.netSaved(),
+           plain ? 100.0 * memory.netSaved() / plain : 0.0, plain);
+}
+
+// Function to check a saved bank's checksum and every record (--verify mode)
+int runVerify(const string& bankPath) {
+    MappedBank bank;
+    auto start = chrono::steady_clock::now();
+    if (!bank.open(bankPath) || !bank.verify()) {
+        cout << "[Quiz bank failed verification: " << bank.lastError() << "]" << endl;
+        return 1;
+    }
+    cout << "Verified " << bank.size() << " questions in " << fixed << setprecision(3)
+         << chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s" << endl;
+    return 0;
+}
+
+// Function to report the string memory of a saved bank once loaded (--memory mode)
+int runMemory(const string& bankPath) {
+    Quiz quiz;
+    if (!quiz.open(bankPath)) return 1;
+    printStringMemory(quiz.stringMemory());
+    return 0;
+}
+
+// Function to write a calibrated bank of every question type, for trying out the other modes (--synthesize mode)
+int runSynthesize(const string& bankPath, size_t questions, uint64_t seed) {
+    SyntheticBankSpec spec;
+    spec.questions = questions;
+    spec.mcqShare = 0.4;
+    spec.tfShare = 0.2;
+    spec.numericShare = 0.15;
+    spec.multiShare = 0.15;
+    spec.seed = seed;
+    spec.vocabulary = 5000;
+    spec.calibrated = true;
+    Quiz quiz;
+    buildSyntheticBank(quiz, spec);
+    if (!quiz.save(bankPath)) return 1;
+    cout << "Wrote " << quiz.getQuestionCount() << " questions to " << bankPath << endl;
+    return 0;
+}
+
+// Function to play synthetic takers against a saved bank (--simulate mode): their answer sheets for --grade,
+// and optionally every protocol command they send, for replaying against a session or server
+int runSimulation(const string& bankPath, size_t takers, const string& submissionsPath, const string& tracePath, uint64_t seed) {
+    MappedBank bank;
+    if (!bank.open(bankPath) || !bank.checkRecords()) {
+        cout << "[Could not open quiz bank: " << bank.lastError() << "]" << endl;
+        return 1;
+    }
+    ofstream submissions(submissionsPath), trace;
+    if (!tracePath.empty()) trace.open(tracePath);
+    if (!submissions || (!tracePath.empty() && !trace)) {
+        cout << "[Could not open submissions or trace file]" << endl;
+        return 1;
+    }
+    TakerSpec spec;
+    spec.takers = takers;
+    spec.seed = seed;
+    TakerSimulator simulator(bank);
+    WorkStealingPool pool;
+    SimulationStats stats = simulator.run(spec, &submissions, tracePath.empty() ? nullptr : &trace, nullptr, pool);
+    cout << "Simulated " << stats.takers << " takers (" << stats.partial << " submitted early) on " << pool.size()
+         << " threads in " << fixed << setprecision(3) << stats.seconds << "s: " << stats.events << " events, "
+         << stats.answers << " answers, " << setprecision(0) << stats.eventsPerSecond() << " events/s, mean score "
+         << setprecision(2) << stats.meanScore << endl;
+    return submissions && (tracePath.empty() || trace) ? 0 : 1;
+}
+
+#ifdef BENCHMARKING
+// Benchmark suite. Every global allocation is counted so each operation
+// can report allocations per op next to its time, and the kernel's
+// high-water mark is reset before each operation so peak RSS is per op.
+atomic<size_t> benchmarkAllocations{0};
+
+// Kept out of line so GCC does not pair the malloc()/free() inside with library calls
+__attribute__((noinline)) void* operator new(size_t size) {
+    benchmarkAllocations.fetch_add(1, memory_order_relaxed);
+    if (void* memory = malloc(size ? size : 1)) return memory;
+    throw bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* memory) noexcept { free(memory); }
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+// One measured operation at one bank size
+struct BenchmarkResult {
+    string operation;
+    size_t questions;
+    size_t ops;
+    double nsPerOp;
+    double allocationsPerOp;
+    long peakRssKb;
+};
 
+struct QuizBenchmark {
+    vector<BenchmarkResult> results;
+    uint64_t seed = 1;
 
+    // Function to read the resident-set high-water mark in KB
+    static long peakRssKb() {
+        ifstream status("/proc/self/status");
+        string line;
+        while (getline(status, line)) {
+            if (line.rfind("VmHWM:", 0) == 0) return atol(line.c_str() + 6);
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
     }
 
-    bool promptUser(shared_ptr<Question> question) {
-        string newAnswer;
-    do {
-        cout << "Do you want to?\n";
-        cout << "\t1. Edit this Answer\n";
-        cout << "\t2. Go to next question\n";
-        cout << "\t3. Jump to question\n";
-        cout << "\t4. Submit\n";
-        cout << "Select an action: ";
-        int action;
-        cin >> action;
-        clearInput();
-        // Execute action based on user's choice
-        switch (action) {
-            case 1:
-                cout << "Your new answer: ";
-                getline(cin, newAnswer);
-                // Convert input to lowercase for case-insensitive comparison
-                for (auto& c : newAnswer) c = tolower(c);
-                question -> studentAnswer = newAnswer;
-                clearInput();
-                return true;
-            case 2:
-                // Move to the next unanswered question
-                question = getNextUnansweredQuestion();
-                if (!question) {return false;}//if question still null, break loop
-
-                displayQuestion(question);
+    // Function to restart the high-water mark at the current RSS (Linux only)
+    static void resetPeakRss() {
+        ofstream clear("/proc/self/clear_refs");
+        clear << "5";
+    }
 
+    // Function to time body(), which performs ops operations
+    template <typename Body>
+    void measure(const string& operation, size_t questions, size_t ops, Body body) {
+        resetPeakRss();
+        size_t allocationsBefore = benchmarkAllocations.load();
+        auto start = chrono::steady_clock::now();
+        body();
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        size_t allocations = benchmarkAllocations.load() - allocationsBefore;
+        results.push_back({operation, questions, ops, ns / ops, static_cast<double>(allocations) / ops, peakRssKb()});
+        const BenchmarkResult& result = results.back();
+        printf("%-16s %10zu questions %10zu ops %14.1f ns/op %10.2f allocs/op %10ld KB peak\n", operation.c_str(),
+               questions, ops, result.nsPerOp, result.allocationsPerOp, result.peakRssKb);
+    }
 
-                return true;
-                break;
-            case 3:
-                int id;
-                cout << "Jump to question [" << 1 << "-" << questionCount << "]: ";
-                cin >> id;
-                question = getQuestionById(id);
-                if (question) {
-                    displayQuestion(question);
-                    return true;
-                }
-                cout << "[Question not found]" << endl;
+    // Function to run every operation against a synthetic bank of the given size
+    void runSize(size_t questions) {
+        SyntheticBankSpec spec;
+        spec.questions = questions;
+        spec.seed = seed;
+        spec.vocabulary = 50000;  // Realistic word frequencies, so the search index sees real-looking postings
+        Quiz quiz;
+        measure("build", questions, questions, [&] { buildSyntheticBank(quiz, spec); });
 
-                break;
-            case 4:
-                return false;
+        SplitMix64 random(seed ^ questions);
+        size_t lookups = max<size_t>(questions, 100000);
+        vector<int> ids(lookups);
+        for (auto& id : ids) id = 1 + static_cast<int>(random.below(questions));
+        volatile long sink = 0;
+        measure("lookup", questions, lookups, [&] {
+            long found = 0;
+            for (int id : ids) found += quiz.getQuestionById(id);
+            sink = found;
+        });
+        // What one instrumentation point costs when built with -DMETRICS
+        measure("metric timer", questions, lookups, [&] {
+            for (size_t i = 0; i < lookups; i++) MetricTimer timer(Metrics::getQuestionById);
+        });
 
-            default:
-                cout << "[Unknown input, please try again]" << endl;
+        // Queries built from words of random questions: single words, two-word ANDs and three-letter prefixes
+        vector<string> queries(3000);
+        for (size_t i = 0; i < queries.size(); i++) {
+            string text = quiz.store.row(quiz.store.slotOf(ids[i])).text(quiz.store.strings());
+            vector<string> words;
+            stringstream split(text);
+            for (string word; split >> word;) words.push_back(word);
+            const string& first = words[random.below(words.size())];
+            const string& second = words[random.below(words.size())];
+            if (i % 3 == 0) queries[i] = first;
+            else if (i % 3 == 1) queries[i] = first + " " + second;
+            else queries[i] = first.substr(0, 3) + "*";
         }
-    }while(true);
-
+        measure("search", questions, queries.size(), [&] {
+            size_t found = 0;
+            for (const string& query : queries) found += quiz.searchQuestions(query, 10).size();
+            sink = static_cast<long>(found);
+        });
+        // Two-word ANDs alone, the queries whose lists are longest, and the tail of single-query latency
+        measure("search and", questions, queries.size() / 3, [&] {
+            size_t found = 0;
+            for (size_t i = 1; i < queries.size(); i += 3) found += quiz.searchQuestions(queries[i], 10).size();
+            sink = static_cast<long>(found);
+        });
+        vector<pair<double, size_t>> latencies;
+        for (size_t i = 0; i < queries.size(); i++) {
+            auto start = chrono::steady_clock::now();
+            sink = static_cast<long>(quiz.searchQuestions(queries[i], 10).size());
+            latencies.push_back({chrono::duration<double, micro>(chrono::steady_clock::now() - start).count(), i});
+        }
+        sort(latencies.begin(), latencies.end());
+        printf("%-16s %10zu questions %14.1f us p99 %10.1f us max for \"%s\"\n", "search tail", questions,
+               latencies[latencies.size() * 99 / 100].first, latencies.back().first, queries[latencies.back().second].c_str());
+        printf("%-16s %10zu questions %14.1f%% of %zu KB bank\n", "index memory", questions,
+               100.0 * quiz.textIndex.memoryBytes() / quiz.store.memoryBytes(), quiz.store.memoryBytes() / 1024);
 
-    }
+        // Interned strings and coded text: what they save against one std::string each, and what showing a question costs
+        StringMemory strings = quiz.stringMemory();
+        auto savedShare = [](const StringMemory::Field& field) { return field.plainBytes ? 100.0 * field.saved() / field.plainBytes : 0.0; };
+        printf("%-16s %10zu questions %8.1f%% text %8.1f%% choices %8.1f%% answers %8.1f%% net saved\n", "string memory",
+               questions, savedShare(strings.text), savedShare(strings.choices), savedShare(strings.answers),
+               100.0 * strings.netSaved() / (strings.text.plainBytes + strings.choices.plainBytes + strings.answers.plainBytes));
+        string line;
+        measure("render", questions, lookups, [&] {
+            size_t bytes = 0;
+            for (int id : ids) {
+                quiz.renderQuestion(id, line);
+                bytes += line.size();
+            }
+            sink = static_cast<long>(bytes);
+        });
 
-    void conductQuiz(){
-        shared_ptr<Question> question = head;
-        bool cont = true;
+        // Near duplicates: the parallel pass over the whole bank, then the index that checks each new question
+        {
+            WorkStealingPool pool;
+            DuplicateReport report;
+            measure("duplicate scan", questions, questions, [&] { report = quiz.findDuplicates(0.8, pool); });
+            printf("%-16s %10zu questions %10zu candidate pairs %10zu clusters on %u threads\n", "duplicate pairs", questions,
+                   report.candidates, report.clusters.size(), pool.size());
+            measure("duplicate index", questions, questions, [&] { quiz.duplicates.enable(quiz.store); });
+            printf("%-16s %10zu questions %14.1f%% of %zu KB bank\n", "duplicate memory", questions,
+                   100.0 * quiz.duplicates.memoryBytes() / quiz.store.memoryBytes(), quiz.store.memoryBytes() / 1024);
+            measure("duplicate check", questions, lookups, [&] {
+                long found = 0;
+                for (int id : ids) found += quiz.similarQuestions(id).size();
+                sink = found;
+            });
+            quiz.duplicates = NearDuplicateIndex();  // Later rows time edits without it
+        }
 
-        while(cont) {
-            if(allQuestionAnswer()) {
-               cout << "All questions answered. ";
+        size_t edits = min<size_t>(questions, 100000);
+        string error;
+        vector<string> value{"edited question text"};
+        measure("edit", questions, edits, [&] {
+            for (size_t i = 0; i < edits; i++) quiz.setQuestionField(ids[i], "text", value, error);
+        });
+        // One edit then a new version for takers: copies a page, not the bank
+        shared_ptr<const QuestionBank> version = quiz.publish();
+        vector<string> answer(1);
+        measure("edit+publish", questions, edits, [&] {
+            for (size_t i = 0; i < edits; i++) {
+                answer[0] = as_const(quiz.store).correctAnswer(quiz.store.slotOf(ids[i]));
+                quiz.setQuestionField(ids[i], "answer", answer, error);
+                version = quiz.publish();
             }
-            if(question && question->studentAnswer.empty()) {
-               cont = promptUserEmpty(question);
+        });
+        // A version with nothing changed: only the page tables are copied, so it costs the same at every bank size
+        measure("publish", questions, edits, [&] {
+            for (size_t i = 0; i < edits; i++) version = quiz.publish();
+        });
+        version.reset();
+
+        // The same edits logged to a journal; group commit shares each fdatasync between many edits
+        {
+            string base = "bench_journal_" + to_string(questions);
+            Quiz journaled;
+            EditJournal journal;
+            journaled.openJournal(journal, base, error);
+            journaled.reserveQuestions(edits);
+            for (size_t i = 0; i < edits; i++) journaled.addQuestion("tf", "journaled question", {}, "true", 1, error);
+            journal.sync();
+            uint64_t syncsBefore = journal.syncCount();
+            vector<string> answer{"false"};
+            measure("journal edit", questions, edits, [&] {
+                for (size_t i = 0; i < edits; i++) {
+                    journaled.setQuestionField(static_cast<int>(i + 1), "answer", answer, error);
+                }
+                journal.sync();
+            });
+            printf("%-16s %10zu questions %10zu edits in %llu syncs\n", "journal syncs", questions, edits,
+                   static_cast<unsigned long long>(journal.syncCount() - syncsBefore));
+            journal.close();
+            for (uint64_t g = 0; g <= journal.currentGeneration() + 1; g++) {
+                remove((base + ".journal." + to_string(g)).c_str());
+                remove((base + ".snapshot." + to_string(g)).c_str());
             }
-            else {
-               cont = promptUser(question);
+        }
+
+        measure("answer", questions, questions, [&] {
+            for (size_t id = 1; id <= questions; id++) quiz.recordAnswer(static_cast<int>(id), "a");
+        });
+
+        size_t scans = max<size_t>(1, 10000000 / questions);
+        measure("allAnswered", questions, scans, [&] {
+            long answered = 0;
+            for (size_t i = 0; i < scans; i++) answered += quiz.allQuestionAnswer();
+            sink = answered;
+        });
+
+        size_t submits = max<size_t>(1, 1000000 / questions);
+        measure("submit", questions, submits, [&] {
+            double total = 0;
+            for (size_t i = 0; i < submits; i++) total += quiz.gradeAnswers();
+            sink = static_cast<long>(total);
+        });
+
+        string path = "bench_bank_" + to_string(questions) + ".qzb";
+        measure("save", questions, 1, [&] { quiz.save(path); });
+        measure("open(mmap)", questions, 1, [&] {
+            MappedBank bank;
+            bank.open(path);
+            sink = static_cast<long>(bank.size());
+        });
+        measure("open+verify", questions, 1, [&] {
+            MappedBank bank;
+            bank.open(path, true);
+            sink = static_cast<long>(bank.size());
+        });
+        remove(path.c_str());
+
+        // The same bank as CSV, quoting every text field
+        string csv;
+        for (int slot = quiz.store.nextLive(0); slot != -1; slot = quiz.store.nextLive(slot + 1)) {
+            const Question& question = quiz.store.row(slot);
+            csv += string(kindName(quiz.store.type(slot))) + ",\"" + question.text(quiz.store.strings()) + "\",";
+            csv += as_const(quiz.store).correctAnswer(slot);
+            csv += "," + to_string(fromFixedPoints(quiz.store.points(slot)));
+            for (int i = 0; i < question.choiceCount; i++) {
+                csv += ",\"";
+                csv += question.choiceText(quiz.store.strings(), i);
+                csv += '"';
             }
+            csv += '\n';
         }
-    }
+        WorkStealingPool pool;
+        BankImporter importer;
+        ImportStats imported;
+        measure("import", questions, questions, [&] {
+            Quiz copy;
+            importer.setText(csv);
+            imported = importer.run(copy, pool);
+        });
+        printf("%-16s %10zu questions %10.0f MB/s parse %6.0f MB/s index %6.0f MB/s total on %u threads\n", "import rate",
+               questions, imported.bytes / imported.parseSeconds / 1e6, imported.bytes / imported.indexSeconds / 1e6,
+               imported.megabytesPerSecond(), pool.size());
 
-    void submitTest() {
-        for (auto temp = head; temp; temp = temp->next) {
-            if (temp->studentAnswer.empty()) {
-                cout << "[Unanswered questions detected. Submit anyway? (y/n)] ";
-                errorMessage = true;
+        // A sitting of 50-question sheets (a million responses) from simulated takers on a calibrated bank
+        // of every type, graded with and without item analysis, and the takers' sessions replayed command by command
+        {
+            SyntheticBankSpec sittingSpec = spec;
+            sittingSpec.questions = 50;
+            sittingSpec.mcqShare = 0.4;
+            sittingSpec.tfShare = 0.2;
+            sittingSpec.numericShare = 0.15;
+            sittingSpec.multiShare = 0.15;
+            sittingSpec.calibrated = true;
+            Quiz sitting;
+            buildSyntheticBank(sitting, sittingSpec);
+            GradingKey key = sitting.gradingKey();
+            shared_ptr<const QuestionBank> published = sitting.publish();
+            TakerSimulator simulator(published->questions);
+            TakerSpec takerSpec;
+            takerSpec.takers = 20000;
+            takerSpec.seed = seed;
+            size_t sheetCount = takerSpec.takers;
+            ostringstream sheetsOut, traceOut;
+            SimulationStats simulated = simulator.run(takerSpec, &sheetsOut, &traceOut, nullptr, pool);
+            string sheets = sheetsOut.str(), trace = traceOut.str();
+            measure("simulate", questions, simulated.events, [&] {
+                ostringstream sheetsAgain, traceAgain;
+                sink = static_cast<long>(simulator.run(takerSpec, &sheetsAgain, &traceAgain, nullptr, pool).events);
+            });
+            printf("%-16s %10zu questions %10zu takers %10zu events, %zu submitted early, %.1fM events/s on %u threads\n",
+                   "simulation", questions, simulated.takers, simulated.events, simulated.partial,
+                   simulated.eventsPerSecond() / 1e6, pool.size());
+            measure("replay", questions, simulated.events, [&] {
+                unique_ptr<QuizSession> session;
+                string_view rest(trace), student;
+                bool close = false;
+                size_t replies = 0;
+                while (!rest.empty()) {
+                    size_t end = rest.find('\n'), tab = rest.find('\t');
+                    string_view line = rest.substr(0, end);
+                    rest.remove_prefix(end + 1);
+                    if (!session || line.substr(0, tab) != student) {
+                        student = line.substr(0, tab);
+                        session = make_unique<QuizSession>(published);
+                    }
+                    replies += session->handle(line.substr(tab + 1), close).size();
+                }
+                sink = static_cast<long>(replies);
+            });
+            auto grade = [&](ItemAccumulator* items) {
+                istringstream in(sheets);
+                ostringstream out;
+                gradeBatch(key, in, out, pool, 512, items);
+            };
+            measure("grade sheets", questions, sheetCount, [&] { grade(nullptr); });
+            ItemAccumulator items;
+            measure("grade+analysis", questions, sheetCount, [&] { grade(&items); });
+            SittingStatistics summary = items.summarize(key);
+            printf("%-16s %10zu questions %10zu responses, KR-20 %.3f, alpha %.3f\n", "item analysis", questions,
+                   sheetCount * key.size(), summary.kr20, summary.alpha);
+        }
 
+        // Graded attempts ranked on a leaderboard: students retake, so a quarter as many students as attempts
+        {
+            size_t attempts = questions * 10, students = max<size_t>(1, attempts / 4);
+            string scores;
+            for (size_t attempt = 0; attempt < attempts; attempt++) {
+                char line[64];
+                snprintf(line, sizeof(line), "s%zu\t%.2f\t100.00\n", static_cast<size_t>(random.below(students)),
+                         random.below(10001) / 100.0);
+                scores += line;
             }
+            Leaderboard board;
+            measure("rank ingest", questions, attempts, [&] {
+                istringstream in(scores);
+                board.ingest(in, pool);
+            });
+            size_t queries = 100000;
+            Standing standing;
+            measure("rank query", questions, queries, [&] {
+                for (size_t i = 0; i < queries; i++) {
+                    board.standing("s" + to_string(random.below(students)), standing);
+                    sink = static_cast<long>(standing.rank);
+                }
+            });
         }
-    }
 
-    void submit() {
-        for (auto temp = head; temp; temp = temp->next) {
-            if (temp->studentAnswer.empty()) {
-                cout << "[Unanswered questions detected. Submit anyway? (y/n)] ";
-                errorMessage = true;
-                string choice;
-                cin >> choice;
-                if (choice == "n") return;
-                else break;
+        FormSpec formSpec;
+        formSpec.questions = min<size_t>(questions, 50);
+        formSpec.stratify = FormSpec::byType;
+        formSpec.seed = seed;
+        FormGenerator forms(quiz.publish(), formSpec);
+        size_t formCount = 100000;
+        measure("form", questions, formCount, [&] {
+            ExamForm form;
+            uint64_t hash = 0;
+            for (size_t student = 0; student < formCount; student++) {
+                forms.generate(student, form);
+                hash ^= forms.digest(form);
             }
+            sink = static_cast<long>(hash);
+        });
+
+        // Adaptive tests: a calibrated bank, simulated takers answering with the model's own probabilities
+        {
+            SplitMix64 calibration(seed ^ 0xCA7);
+            for (int slot = quiz.store.nextLive(0); slot != -1; slot = quiz.store.nextLive(slot + 1)) {
+                ItemParameters& parameters = quiz.store.parameters(slot);
+                parameters.discrimination = static_cast<float>(0.5 + 1.5 * calibration.unit());
+                parameters.difficulty = static_cast<float>(6 * calibration.unit() - 3);
+                parameters.guessing = quiz.store.type(slot) == QuestionKind::wr ? 0.0f : 0.2f;
+            }
+            AdaptiveSpec adaptiveSpec;
+            adaptiveSpec.questions = 30;
+            adaptiveSpec.seed = seed;
+            unique_ptr<AdaptiveTest> test;
+            measure("adaptive tables", questions, 1, [&] { test = make_unique<AdaptiveTest>(quiz.publish(), adaptiveSpec); });
+            size_t takers = 2000, steps = 0;
+            vector<double> abilities(takers);
+            for (double& ability : abilities) ability = 4 * random.unit() - 2;
+            double error = 0;
+            measure("adaptive step", questions, takers * test->questionsPerTest(), [&] {
+                for (size_t taker = 0; taker < takers; taker++) {
+                    AdaptiveSession session(*test, taker);
+                    for (int slot = session.next(); slot != -1; slot = session.next()) {
+                        session.record(random.unit() < test->questions().parameters(slot).probability(abilities[taker]));
+                        steps++;
+                    }
+                    error += fabs(session.ability() - abilities[taker]);
+                }
+            });
+            printf("%-16s %10zu questions %10zu steps, mean |estimate - ability| %.3f\n", "adaptive error", questions, steps,
+                   error / takers);
         }
 
-        //double score = 0;
-        cout << "\n/!\\ Assessment Complete.\n=== SESSION LOG ===" << endl;
-        for (auto temp = head; temp; temp = temp->next) {
-            cout << "Question " << temp->id << ": " << temp->correctAnswer << endl;
-            cout << "Your answer: " << temp->studentAnswer << endl;
-            if (temp->correctAnswer == temp->studentAnswer) score += temp->points;
+        // Exam alarms for a crowd of timed sessions: deadlines up to an hour out in milliseconds,
+        // half cancelled as takers finish early, the rest fired as the clock runs
+        {
+            size_t timers = lookups * 10;
+            vector<uint64_t> deadlines(timers);
+            for (auto& deadline : deadlines) deadline = random.below(3600000);
+            TimingWheel wheel;
+            vector<TimingWheel::Handle> handles(timers);
+            measure("timer schedule", questions, timers, [&] {
+                for (size_t i = 0; i < timers; i++) handles[i] = wheel.schedule(deadlines[i], i);
+            });
+            measure("timer cancel", questions, timers / 2, [&] {
+                long cancelled = 0;
+                for (size_t i = 0; i < timers; i += 2) cancelled += wheel.cancel(handles[i]);
+                sink = cancelled;
+            });
+            size_t remaining = wheel.size();
+            measure("timer fire", questions, remaining, [&] {
+                uint64_t fired = 0;
+                for (uint64_t now = 0; now <= 3600000; now += 1000) wheel.advance(now, [&](uint64_t payload) { fired += payload; });
+                sink = fired;
+            });
         }
-        cout << fixed << setprecision(2) << "Final score: " << score << "/" << totalPoints << endl;
+
+        size_t deletes = questions / 10;
+        measure("delete", questions, deletes, [&] {
+            for (size_t i = 0; i < deletes; i++) quiz.removeQuestion(static_cast<int>(1 + (i * 7919) % questions));
+        });
     }
 
+    // Function to write every result as JSON for comparing runs across versions
+    bool writeJson(const string& path) const {
+        ofstream out(path);
+        out << "{\n  \"seed\": " << seed << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult& r = results[i];
+            out << "    {\"operation\": \"" << r.operation << "\", \"questions\": " << r.questions
+                << ", \"ops\": " << r.ops << fixed << setprecision(2) << ", \"ns_per_op\": " << r.nsPerOp
+                << ", \"allocs_per_op\": " << r.allocationsPerOp << ", \"peak_rss_kb\": " << r.peakRssKb << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
 };
 
-int main() {
+// Function to run the benchmark suite (BENCHMARKING builds)
+int runBenchmarks(int argc, char* argv[]) {
+    QuizBenchmark benchmark;
+    vector<size_t> sizes{10000, 100000, 1000000};
+    string jsonPath = "bench_results.json";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--sizes") {
+            sizes.clear();
+            stringstream list(value);
+            for (string size; getline(list, size, ',');) sizes.push_back(stoull(size));
+        } else if (flag == "--json") {
+            jsonPath = value;
+        } else if (flag == "--seed") {
+            benchmark.seed = stoull(value);
+        } else {
+            cout << "[Unknown option " << flag << "]" << endl;
+            return 1;
+        }
+    }
+    for (size_t size : sizes) benchmark.runSize(size);
+    if (!benchmark.writeJson(jsonPath)) {
+        cout << "[Could not write " << jsonPath << "]" << endl;
+        return 1;
+    }
+    cout << "Results written to " << jsonPath << endl;
+    return 0;
+}
+#endif
+
+
+int main(int argc, char* argv[]) {
 #ifdef UNIT_TESTING
+    (void)argc;
+    (void)argv;
     // Running the unit tests
     cout << "***This is a Debugging Version ***" << endl << endl;
     Quiz testQuiz;
@@ -683,13 +8721,1421 @@ int main() {
     assert(!test4.check2());
     cout << "\nCase 4 Passed" << endl << endl;
 
+    //Unit test 5
+    //test that ids stay stable and findable after deletes and compaction
+    QuestionStore test5;
+    cout << "Unit Test Case 5: Check question ids survive deleting from the question store" << endl;
+    for (int i = 0; i < 200; i++) test5.points(test5.emplace()) = i + 1;
+    for (int id = 1; id <= 150; id++) test5.erase(test5.slotOf(id));
+    assert(test5.size() == 50 && test5.slotOf(10) == -1);
+    assert(test5.points(test5.slotOf(151)) == 151 && test5.points(test5.slotOf(200)) == 200);
+    assert(test5.row(test5.emplace()).id == 201);
+    cout << "\nCase 5 Passed" << endl << endl;
+
+    //Unit test 6
+    //test that MCQ choices stop at Z and keep their text through compaction
+    cout << "Unit Test Case 6: Check answer choices are stored A-Z and survive compaction" << endl;
+    int slot6 = test5.slotOf(200);
+    for (int i = 0; i < Question::maxChoices; i++) {
+        assert(test5.row(slot6).addChoice(test5.strings(), "choice " + to_string(i)));
+    }
+    assert(!test5.row(slot6).addChoice(test5.strings(), "one too many"));
+    for (int id = 151; id < 200; id++) test5.erase(test5.slotOf(id));
+    slot6 = test5.slotOf(200);
+    assert(test5.row(slot6).choiceLetter(25) == 'Z');
+    assert(test5.row(slot6).choiceText(test5.strings(), 25) == "choice 25");
+    cout << "\nCase 6 Passed" << endl << endl;
+
+    //Unit test 7
+    //test that a saved bank maps back in and that corruption is caught
+    cout << "Unit Test Case 7: Save a quiz bank, map it back, and reject a corrupted copy" << endl;
+    const string bankPath = "unit_test_bank.qzb";
+    assert(test2.save(bankPath));
+    {
+        MappedBank bank;
+        assert(bank.open(bankPath) && bank.size() == 1);
+        assert(bank.view(bank.record(0).correctAnswer) == "38" && bank.record(0).points == 100);
+    }
+    Quiz test7;
+    assert(test7.open(bankPath) && test7.check1());
+    {
+        fstream corrupt(bankPath, ios::in | ios::out | ios::binary);
+        corrupt.seekp(-1, ios::end);
+        corrupt.put('!');
+    }
+    // Opening checks only the header and section sizes; the checksum is caught by verification
+    MappedBank corrupted;
+    assert(corrupted.open(bankPath) && corrupted.size() == 1);
+    assert(!corrupted.verify() && corrupted.lastError() == "checksum mismatch" && !corrupted.isOpen());
+    assert(!corrupted.open(bankPath, true) && corrupted.lastError() == "checksum mismatch");
+    {
+        // A reference out of the heap reads as empty text, is reported per record, and stops Quiz::open
+        assert(test2.save(bankPath));
+        fstream corrupt(bankPath, ios::in | ios::out | ios::binary);
+        corrupt.seekp(sizeof(BankHeader) + offsetof(BankRecord, text));
+        ArenaString outside{UINT32_MAX - 4, 8};
+        corrupt.write(reinterpret_cast<const char*>(&outside), sizeof(outside));
+    }
+    assert(corrupted.open(bankPath) && corrupted.view(corrupted.record(0).text).empty());
+    assert(corrupted.recordProblem(0) && string(corrupted.recordProblem(0)) == " out of bounds");
+    assert(!test7.open(bankPath) && test7.getQuestionCount() == 1);  // Left as it was
+    remove(bankPath.c_str());
+    cout << "\nCase 7 Passed" << endl << endl;
+
+    //Unit test 8
+    //test that batch grading matches submit() for each sheet, in input order
+    cout << "Unit Test Case 8: Grade a batch of answer sheets on a work-stealing pool" << endl;
+    {
+        GradingKey key = test2.gradingKey();
+        istringstream sheets("alice\t1=38\nbob\t1=85\n\ncarol\nmallory\t7=38\t1=38\n");
+        ostringstream results;
+        WorkStealingPool pool(2);
+        BatchGradeStats stats = gradeBatch(key, sheets, results, pool, 1);
+        assert(stats.sheets == 4);
+        assert(results.str() == "alice\t100.00\t100.00\nbob\t0.00\t100.00\ncarol\t0.00\t100.00\nmallory\t100.00\t100.00\n");
+    }
+    cout << "\nCase 8 Passed" << endl << endl;
+
+    //Unit test 9
+    //test that the vector kernel scores objective answers exactly like string compares
+    cout << "Unit Test Case 9: Check packed MCQ/TF grading matches submit() scoring" << endl;
+    {
+        GradingKey key;
+        const char* keys[] = {"b", "true", "false", "B", "a", "38", "z"};
+        for (int i = 0; i < 70; i++) key.add(i + 1, keys[i % 7], 0.25 * (i % 5) + 1);
+        key.pack();
+        assert(key.packed && key.textPositions.size() == 20 && key.objectiveKey.size() == 64);
+        const char* sheet[] = {"b", "true", "true", "b", "", "38", "zz"};
+        vector<string> answers(key.size());
+        vector<uint8_t> codes(key.objectiveKey.size(), answerBlank);
+        for (int i = 0; i < 70; i++) {
+            answers[i] = sheet[(i * 3) % 7];
+            if (key.objectiveIndex[i] != -1) codes[key.objectiveIndex[i]] = answerCode(answers[i], true);
+        }
+        assert(key.scorePacked(codes.data(), answers) == key.score(answers));
+        assert(!__builtin_cpu_supports("avx2") ||
+               objectiveScoreScalar(key.objectiveKey.data(), codes.data(), key.objectivePoints.data(), 64) ==
+               objectiveScoreAvx2(key.objectiveKey.data(), codes.data(), key.objectivePoints.data(), 64));
+        key.points[0] = toFixedPoints(0.1);  // Not a binary fraction, but fixed point adds it exactly in any order
+        key.pack();
+        assert(key.packed && key.scorePacked(codes.data(), answers) == key.score(answers));
+    }
+    cout << "\nCase 9 Passed" << endl << endl;
+
+    //Unit test 10
+    //test written-response canonical forms and tolerant matching, and verdicts cached per grading key
+    cout << "Unit Test Case 10: Check written answers match with case, spacing, numbers and typos" << endl;
+    assert(canonicalAnswer("  The  War, lasted 038.0 minutes!") == "the war lasted 38 minutes");
+    assert(canonicalAnswer("1,000 B.C.") == "1000 b c");
+    assert(WrKey("Photosynthesis").matches("photosynthesys"));
+    assert(WrKey("Paris").matches("PARIS."));
+    assert(!WrKey("Paris").matches("Pairs and more"));
+    assert(WrKey("38").matches("38.0") && !WrKey("38").matches("39"));
+    assert(!WrKey("George Washington").matches(""));
+    {
+        string longKey(70, 'a');
+        longKey[10] = 'b';
+        assert(WrKey(longKey).matches(string(70, 'a')) && !WrKey(longKey).matches(string(60, 'a')));
+        // Myers' kernel and the banded fallback must agree on random near-misses
+        unsigned seed = 7;
+        auto next = [&seed] { seed = seed * 1103515245 + 12345; return (seed >> 16) % 4; };
+        for (int trial = 0; trial < 500; trial++) {
+            string key, answer;
+            for (int i = 0; i < 12; i++) key += static_cast<char>('a' + next());
+            answer = key;
+            for (unsigned edits = next(); edits > 0; edits--) {
+                size_t at = next() * 3;
+                if (next() < 2) answer.insert(answer.begin() + at, 'a' + next());
+                else if (at < answer.size()) answer.erase(at, 1);
+            }
+            assert(WrKey(key).matchesCanonical(answer) == withinEditsBanded(key, answer, 2));
+        }
+    }
+    {
+        // Keys that were never packed still keep their cached verdicts apart
+        GradingKey capital, river;
+        capital.add(1, "paris", 1, QuestionKind::wr);
+        river.add(1, "seine", 1, QuestionKind::wr);
+        assert(capital.isCorrect(0, "paris") && !river.isCorrect(0, "paris"));
+        assert(river.isCorrect(0, "seine") && !capital.isCorrect(0, "seine"));
+        GradingKey copy = capital;
+        copy.add(2, "rhone", 1, QuestionKind::wr);
+        capital.add(2, "loire", 1, QuestionKind::wr);
+        assert(copy.isCorrect(1, "rhone") && !capital.isCorrect(1, "rhone") && capital.isCorrect(0, "paris"));
+    }
+    {
+        // Published banks grade against keys compiled once; an edit drops the compiled key of its page
+        Quiz quiz;
+        string error;
+        int capital = quiz.addQuestion("wr", "Capital of France?", {}, "Paris", 1, error);
+        quiz.addQuestion("wr", "Capital again?", {}, "Paris", 1, error);
+        quiz.addQuestion("tf", "Sky blue?", {}, "true", 1, error);
+        shared_ptr<const QuestionBank> first = quiz.publish();
+        const WrKey* compiled = first->questions.compiledKey(0);
+        assert(compiled && compiled == first->questions.compiledKey(1) && !first->questions.compiledKey(2));
+        assert(isCorrectAnswer(first->questions, 0, "paris.") && !isCorrectAnswer(first->questions, 0, "rome"));
+        assert(quiz.setQuestionField(capital, "answer", {"Rome"}, error));
+        shared_ptr<const QuestionBank> second = quiz.publish();
+        assert(second->questions.compiledKey(0) && second->questions.compiledKey(0) != compiled);
+        assert(isCorrectAnswer(second->questions, 0, "rome") && isCorrectAnswer(first->questions, 0, "paris"));
+    }
+    cout << "\nCase 10 Passed" << endl << endl;
+
+    //Unit test 11
+    //test replaying a session script without prompts
+    cout << "Unit Test Case 11: Replay an authoring and test-taking script headlessly" << endl;
+    {
+        FILE* captured = tmpfile();
+        {
+            TranscriptWriter transcript(captured);
+            ScriptDriver driver(transcript);
+            istringstream script("create\ttf\tSky blue?\tTrue\t2\ncreate\twr\tWar length?\t38 minutes\t3\n"
+                                 "answer\t1\ttrue\nanswer\t2\t38 MINUTES\nbogus\nsubmit\n");
+            driver.run(script);
+            assert(driver.errorCount() == 1);
+        }
+        rewind(captured);
+        string transcript;
+        char block[256];
+        for (size_t n; (n = fread(block, 1, sizeof(block), captured)) > 0;) transcript.append(block, n);
+        fclose(captured);
+        assert(transcript.find("5\tbogus\terror\tunknown command\n") != string::npos);
+        assert(transcript.find("6\tsubmit\tok\tscore=5.00\ttotal=5.00\tunanswered=0\n") != string::npos);
+    }
+    cout << "\nCase 11 Passed" << endl << endl;
+
+    //Unit test 12
+    //test that synthetic banks are reproducible from their seed
+    cout << "Unit Test Case 12: Build the same synthetic bank twice from one seed" << endl;
+    {
+        SyntheticBankSpec spec;
+        spec.questions = 500;
+        Quiz first, second;
+        buildSyntheticBank(first, spec);
+        buildSyntheticBank(second, spec);
+        GradingKey a = first.gradingKey(), b = second.gradingKey();
+        assert(a.size() == 500 && a.correctAnswers == b.correctAnswers && a.points == b.points);
+        assert(count(a.kinds.begin(), a.kinds.end(), QuestionKind::wr) > 0);
+    }
+    cout << "\nCase 12 Passed" << endl << endl;
+
+    //Unit test 13
+    //test the answer sheet that drives next-question navigation
+    cout << "Unit Test Case 13: Track answered questions and find the next blank one" << endl;
+    {
+        QuestionStore store;
+        AnswerSheet sheet;
+        for (int i = 0; i < 130; i++) store.emplace();
+        for (int slot = 0; slot < 130; slot++) if (slot != 70 && slot != 129) sheet.setAnswer(store, slot, "a");
+        assert(sheet.unansweredCount(store) == 2 && sheet.firstUnanswered(store) == 70);
+        sheet.forget(store.row(70).id);
+        store.erase(70);
+        assert(sheet.unansweredCount(store) == 1 && sheet.firstUnanswered(store) == 129);
+        sheet.setAnswer(store, 3, "");
+        assert(sheet.firstUnanswered(store) == 3 && sheet.answer(store, 4) == "a");
+        sheet.setAnswer(store, 3, "b");
+        sheet.setAnswer(store, 129, "c");
+        assert(sheet.unansweredCount(store) == 0 && sheet.firstUnanswered(store) == -1);
+    }
+    cout << "\nCase 13 Passed" << endl << endl;
+
+    //Unit test 14
+    //test the server's session protocol, then serve real takers over a socket, including one that half-closes
+    cout << "Unit Test Case 14: Run quiz sessions over the line protocol and a Unix socket" << endl;
+    {
+        shared_ptr<const QuestionBank> shared = test3.publish();
+        QuizSession session(shared), other(shared);
+        bool close = false;
+        assert(session.greeting() == "READY 1");
+        assert(session.handle("ANSWER 38", close) == "ERR no current question");
+        assert(session.handle("NEXT", close).rfind("Q 1\twr\t", 0) == 0);
+        assert(session.handle("SUBMIT", close) == "CONFIRM 1 unanswered" && !close);
+        assert(session.handle("ANSWER 38", close) == "OK" && session.handle("NEXT", close) == "NONE");
+        assert(session.handle("SUBMIT", close) == "SCORE 100.00 100.00" && close);
+        assert(other.handle("SUBMIT", close) == "CONFIRM 1 unanswered" && test3.unansweredCount() == 1);
+        assert(other.memoryBytes() == 0 && session.memoryBytes() < 1024);
+
+        SyntheticBankSpec spec;
+        spec.questions = 20;
+        Quiz bank;
+        buildSyntheticBank(bank, spec);
+        QuizServer server(bank.publish());
+        string error;
+        assert(server.start("unix:/tmp/quiz_unit_test.sock", 2, error));
+        LoadTestReport report = runLoadTest("unix:/tmp/quiz_unit_test.sock", 30, 4);
+
+        // A client that sends its last lines and half-closes still gets every reply, then the server closes
+        sockaddr_storage address;
+        socklen_t length;
+        assert(parseSocketAddress("unix:/tmp/quiz_unit_test.sock", address, length));
+        int client = socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        assert(client >= 0 && connect(client, reinterpret_cast<sockaddr*>(&address), length) == 0);
+        string request = "NEXT\nSUBMIT FORCE\n", replies;
+        assert(send(client, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size()));
+        shutdown(client, SHUT_WR);
+        char block[4096];
+        for (ssize_t n; (n = recv(client, block, sizeof(block), 0)) > 0;) replies.append(block, n);
+        ::close(client);
+        assert(replies.rfind("READY 20\nQ 1\t", 0) == 0 && replies.find("\nSCORE 0.00 ") != string::npos && replies.back() == '\n');
+        server.stop();
+        assert(report.sessions == 30 && report.failures == 0 && report.requests == 30 * 42);
+    }
+    cout << "\nCase 14 Passed" << endl << endl;
+
+    //Unit test 15
+    //test randomized exam forms: reproducible, stratified, and graded through remapped keys
+    cout << "Unit Test Case 15: Draw seeded exam forms with shuffled choices" << endl;
+    {
+        SyntheticBankSpec spec;
+        spec.questions = 200;
+        Quiz bank;
+        buildSyntheticBank(bank, spec);
+        shared_ptr<const QuestionBank> shared = bank.publish();
+        const QuestionStore& store = shared->questions;
+        FormSpec formSpec;
+        formSpec.questions = 40;
+        formSpec.stratify = FormSpec::byType;
+        formSpec.seed = 7;
+        FormGenerator forms(shared, formSpec);
+
+        ExamForm first, again, other;
+        forms.generate(12, first);
+        forms.generate(12, again);
+        forms.generate(13, other);
+        assert(first.slots.size() == 40 && first.slots == again.slots && first.slots != other.slots);
+        vector<int> sorted = first.slots;
+        sort(sorted.begin(), sorted.end());
+        assert(unique(sorted.begin(), sorted.end()) == sorted.end());
+        int mcqInBank = 0, mcqOnForm = 0;
+        for (int slot = 0; slot < store.slotCount(); slot++) mcqInBank += store.type(slot) == QuestionKind::mcq;
+        for (int slot : first.slots) mcqOnForm += store.type(slot) == QuestionKind::mcq;
+        assert(abs(mcqOnForm - mcqInBank * 40.0 / 200) <= 1);
+
+        for (int slot : first.slots) {
+            string shown = forms.formAnswer(12, slot);
+            assert(forms.bankAnswer(12, slot, shown) == store.correctAnswer(slot));
+            if (store.type(slot) != QuestionKind::mcq) continue;
+            string line;
+            forms.renderQuestion(12, slot, line);
+            string correctChoice(store.row(slot).choiceText(store.strings(), store.correctAnswer(slot)[0] - 'a'));
+            assert(line.find(string(1, toupper(shown[0])) + ". " + correctChoice) != string::npos);
+        }
+
+        WorkStealingPool pool(2);
+        vector<uint64_t> digests(10000);
+        forms.generateDigests(500, digests, pool);
+        assert(forms.verifyDigests(500, digests, pool) == 0 && forms.verify(512, digests[12]));
+        digests[3] ^= 1;
+        assert(forms.verifyDigests(500, digests, pool) == 1);
+    }
+    cout << "\nCase 15 Passed" << endl << endl;
+
+    //Unit test 16
+    //test full-text search through creates, edits and deletes
+    cout << "Unit Test Case 16: Search question text by word, prefix and phrase" << endl;
+    {
+        Quiz bank;
+        string error;
+        int capital = bank.addQuestion("mcq", "What is the capital of France?", {"Paris", "Lyon"}, "a", 1, error);
+        int capitals = bank.addQuestion("tf", "Capital letters start a sentence, capital.", {}, "true", 1, error);
+        int river = bank.addQuestion("wr", "Which river runs through the capital Paris?", {}, "seine", 1, error);
+        assert(bank.searchQuestions("capital", 10) == vector<int>({capitals, river, capital}));
+        assert(bank.searchQuestions("paris", 10).size() == 2 && bank.searchQuestions("paris", 1).size() == 1);
+        assert(bank.searchQuestions("capital paris", 10).size() == 2);
+        assert(bank.searchQuestions("cap*", 10).size() == 3 && bank.searchQuestions("riv* seine", 10).empty());
+        assert(bank.searchQuestions("\"capital of\"", 10) == vector<int>({capital}));
+        assert(bank.searchQuestions("\"of capital\"", 10).empty() && bank.searchQuestions("", 10).empty());
+
+        assert(bank.setQuestionField(river, "text", {"Which river runs through Rome?"}, error));
+        assert(bank.searchQuestions("paris", 10) == vector<int>({capital}) && bank.searchQuestions("rome", 10) == vector<int>({river}));
+        assert(bank.removeQuestion(capital));
+        assert(bank.searchQuestions("paris", 10).empty() && bank.searchQuestions("capital", 10) == vector<int>({capitals}));
+        int again = bank.addQuestion("wr", "Paris is in France", {}, "yes", 1, error);
+        assert(bank.searchQuestions("france", 10) == vector<int>({again}));
+    }
+    {
+        // Lists many blocks long, against a scan of every question, through edits that revive,
+        // insert into and squeeze coded postings
+        SplitMix64 random(16);
+        vector<string> vocabulary;
+        for (int i = 0; i < 40; i++) {
+            string word;
+            for (int length = 3 + static_cast<int>(random.below(3)); length > 0; length--) word += static_cast<char>('a' + random.below(3));
+            vocabulary.push_back(word);
+        }
+        auto sentence = [&](int words) {
+            string text;
+            for (int i = 0; i < words; i++) text += (i ? " " : "") + vocabulary[random.below(words == 8 ? 40 : 12)];
+            return text;
+        };
+        Quiz bank;
+        string error;
+        map<int, string> texts;
+        for (int i = 0; i < 3000; i++) {
+            string text = sentence(8);
+            texts[bank.addQuestion("wr", text, {}, "key", 1, error)] = text;
+        }
+        for (int i = 0; i < 1500; i++) {
+            int id = 1 + static_cast<int>(random.below(3000));
+            if (!texts.count(id)) continue;
+            if (i % 3 == 0) {
+                assert(bank.removeQuestion(id));
+                texts.erase(id);
+            } else {
+                string text = sentence(i % 2 ? 8 : 3);
+                assert(bank.setQuestionField(id, "text", {text}, error));
+                texts[id] = text;
+            }
+        }
+        auto has = [](const string& text, const string& word, bool prefix) {
+            stringstream split(text);
+            for (string token; split >> token;) if (prefix ? token.rfind(word, 0) == 0 : token == word) return true;
+            return false;
+        };
+        for (int query = 0; query < 200; query++) {
+            string first = vocabulary[random.below(40)], second = vocabulary[random.below(40)];
+            bool prefix = query % 4 == 3;
+            if (prefix) second = second.substr(0, 2);
+            vector<int> expected;
+            for (const auto& [id, text] : texts) if (has(text, first, false) && has(text, second, prefix)) expected.push_back(id);
+            string words = first + " " + second + (prefix ? "*" : "");
+            vector<int> found = bank.searchQuestions(words, 100000), top = bank.searchQuestions(words, 10);
+            assert(top.size() == min<size_t>(10, expected.size()));
+            for (int id : top) assert(find(found.begin(), found.end(), id) != found.end());
+            sort(found.begin(), found.end());
+            assert(found == expected);
+        }
+    }
+    {
+        // A word added to every other older question fills its blocks in the middle until they split
+        Quiz bank;
+        string error;
+        for (int id = 1; id <= 400; id++) bank.addQuestion("wr", id % 2 ? "odd common" : "even filler", {}, "key", 1, error);
+        for (int id = 2; id <= 400; id += 2) assert(bank.setQuestionField(id, "text", {"even filler common"}, error));
+        vector<int> all = bank.searchQuestions("common", 1000), both = bank.searchQuestions("even common", 1000);
+        sort(all.begin(), all.end());
+        sort(both.begin(), both.end());
+        assert(all.size() == 400 && all.front() == 1 && all.back() == 400);
+        assert(both.size() == 200 && both.front() == 2 && both.back() == 400);
+        assert(bank.searchQuestions("filler", 1000).size() == 200);
+    }
+    cout << "\nCase 16 Passed" << endl << endl;
+
+    //Unit test 17
+    //test bulk import from CSV and JSON Lines, including records that straddle parse chunks
+    cout << "Unit Test Case 17: Import CSV and JSONL banks in parallel with line-numbered errors" << endl;
+    {
+        WorkStealingPool pool(3);
+        Quiz bank;
+        BankImporter importer;
+        string csv = "\xEF\xBB\xBFtype,text,answer,points,choice A,choice B\n"
+                     "MCQ,\"Capital of France, really?\",B,2,Lyon,Paris,,\n"
+                     "tf,Sky is blue,TRUE,1\r\n"
+                     "wr,\"Two\nlines \"\"quoted\"\"\",38 Minutes,3\n"
+                     "quiz,bad type,a,1\n"
+                     "mcq,bad points,a,-1\n"
+                     "tf,too few\n";
+        importer.setText(csv);
+        ImportStats stats = importer.run(bank, pool);
+        assert(stats.questions == 3 && stats.rejected == 3);
+        assert(importer.errors()[0].line == 6 && string(importer.errors()[0].message) == "invalid question type");
+        assert(importer.errors()[1].line == 7 && importer.errors()[2].line == 8);
+        shared_ptr<const QuestionBank> shared = bank.publish();
+        const QuestionStore& store = shared->questions;
+        assert(store.type(0) == QuestionKind::mcq && store.correctAnswer(0) == "b" && store.row(0).choiceCount == 2);
+        assert(store.row(0).text(store.strings()) == "Capital of France, really?" && store.row(0).choiceText(store.strings(), 1) == "Paris");
+        assert(store.correctAnswer(1) == "true" && store.row(2).text(store.strings()) == "Two\nlines \"quoted\"");
+        assert(store.correctAnswer(2) == "38 Minutes" && shared->totalPoints == 6);
+
+        string jsonl = "{\"type\": \"mcq\", \"text\": \"Caf\\u00e9 \\\"menu\\\"\", \"answer\": \"A\", \"points\": 1.5,"
+                       " \"choices\": [\"x\", \"y\"], \"tags\": {\"level\": [1, 2]}}\n"
+                       "\n"
+                       "{\"type\": \"tf\", \"text\": \"missing points\", \"answer\": \"true\"}\n"
+                       "{\"type\": \"tf\", \"text\": \"t\", \"answer\": \"maybe\", \"points\": 1}\n";
+        importer.setText(jsonl);
+        stats = importer.run(bank, pool);
+        assert(stats.questions == 1 && stats.rejected == 2 && importer.errors()[1].line == 4);
+        assert(bank.searchQuestions("café", 10).size() == 1);
+
+        // Enough rows for many chunks, with quoted newlines and commas crossing chunk edges
+        string large;
+        for (int i = 0; i < 40000; i++) {
+            large += "wr,\"Question " + to_string(i) + ",\nwith a line break\",answer " + to_string(i) + ",1\n";
+        }
+        large += "tf,last,maybe,1\n";
+        large += "wr,Twin rows are indexed together,a,1\nwr,Twin rows are indexed together,a,1\n";
+        Quiz big;
+        assert(big.similarQuestions(0).empty());  // Keep the duplicate index from the start
+        importer.setText(large);
+        stats = importer.run(big, pool);
+        assert(stats.questions == 40002 && stats.rejected == 1 && importer.errors()[0].line == 80001);
+        // Imported rows are searchable and checked for duplicates once the import returns
+        assert(big.searchQuestions("line break", 100000).size() == 40000);
+        vector<int> twins = big.searchQuestions("twin", 10);
+        assert(twins.size() == 2 && big.searchQuestions("12345 question", 10).size() == 1);
+        assert(big.similarQuestions(twins[0]).size() == 1 && big.similarQuestions(twins[0])[0].id == twins[1]);
+        shared = big.publish();
+        assert(shared->questions.row(39999).text(shared->questions.strings()) == "Question 39999,\nwith a line break");
+        assert(shared->questions.correctAnswer(12345) == "answer 12345");
+    }
+    cout << "\nCase 17 Passed" << endl << endl;
+
+    //Unit test 18
+    //test latency histograms and the lock-free merge of per-thread metrics
+    cout << "Unit Test Case 18: Record latencies on several threads and export a snapshot" << endl;
+    {
+        LatencyHistogram histogram;
+        for (uint64_t ns = 1; ns <= 1000000; ns++) histogram.record(ns);
+        for (double q : {0.5, 0.9, 0.99}) assert(abs(histogram.quantile(q) - q * 1e6) <= q * 1e6 * 0.01);
+        assert(histogram.quantile(1.0) == 1000000 && histogram.total == 1000000);
+        for (uint64_t ns : {0ull, 63ull, 64ull, 1000ull, 123456789ull, 1ull << 39}) {
+            uint64_t value = LatencyHistogram::bucketValue(LatencyHistogram::bucketOf(ns));
+            assert(abs(static_cast<double>(value) - ns) <= ns * 0.01);
+        }
+        assert(LatencyHistogram::bucketOf(1ull << 50) == LatencyHistogram::bucketCount - 1);
+
+        Metrics::Snapshot before = Metrics::snapshot();
+        vector<thread> recorders;
+        for (int t = 0; t < 4; t++) {
+            recorders.emplace_back([] {
+                for (int i = 0; i < 10000; i++) {
+                    Metrics::count(Metrics::submits);
+                    Metrics::record(Metrics::submit, 1000 + i);
+                }
+            });
+        }
+        for (auto& recorder : recorders) recorder.join();
+        Metrics::Snapshot after = Metrics::snapshot();
+        assert(after.counters[Metrics::submits] - before.counters[Metrics::submits] == 40000);
+        assert(after.timers[Metrics::submit].total - before.timers[Metrics::submit].total == 40000);
+        assert(after.timers[Metrics::submit].maxNs >= 10999);
+        string text = Metrics::prometheus(after);
+        assert(text.find("# TYPE quiz_submit_seconds summary\n") != string::npos);
+        assert(text.find("quiz_submits_total " + to_string(after.counters[Metrics::submits]) + "\n") != string::npos);
+        assert(Metrics::writeSnapshot("unit_test_metrics.prom"));
+        ifstream exported("unit_test_metrics.prom");
+        string first;
+        assert(getline(exported, first) && first.rfind("# HELP quiz_", 0) == 0);
+        remove("unit_test_metrics.prom");
+    }
+    cout << "\nCase 18 Passed" << endl << endl;
+
+    //Unit test 19
+    //test the edit journal: recovery after a torn write, background compaction, and refusing edits after a failed write
+    cout << "Unit Test Case 19: Journal edits, recover after a crash, and compact into a snapshot" << endl;
+    {
+        string base = "unit_test_journal";
+        auto removeFiles = [&base] {
+            for (int g = 0; g < 64; g++) {
+                remove((base + ".journal." + to_string(g)).c_str());
+                remove((base + ".snapshot." + to_string(g)).c_str());
+            }
+        };
+        removeFiles();
+        string error;
+        {
+            EditJournal journal;
+            Quiz authoring;
+            assert(authoring.openJournal(journal, base, error) && authoring.getQuestionCount() == 0);
+            int first = authoring.addQuestion("mcq", "Capital of France?", {"Lyon", "Paris"}, "b", 2, error);
+            int second = authoring.addQuestion("tf", "Sky is blue", {}, "true", 1, error);
+            authoring.addQuestion("wr", "War length?", {}, "38 minutes", 3, error);
+            assert(authoring.setQuestionField(first, "text", {"Capital city of France?"}, error));
+            assert(authoring.removeQuestion(second));
+            journal.sync();
+        }
+        {
+            // A crash mid-write leaves half a record at the end of the journal
+            ofstream torn(base + ".journal.1", ios::binary | ios::app);
+            torn.write("\x40\0\0\0garbage", 11);
+        }
+        {
+            EditJournal journal;
+            Quiz recovered;
+            assert(recovered.openJournal(journal, base, error));
+            assert(recovered.getQuestionCount() == 2 && recovered.getTotalPoints() == 5);
+            assert(recovered.searchQuestions("city", 10) == vector<int>({1}));
+            assert(recovered.addQuestion("tf", "After recovery", {}, "false", 1, error) == 4);  // Ids are never reused
+        }
+        {
+            // A tiny threshold, so the journal rolls over and is folded into a snapshot while editing goes on
+            EditJournal journal(4096);
+            Quiz compacted;
+            assert(compacted.openJournal(journal, base, error) && compacted.getQuestionCount() == 3);
+            for (int i = 0; i < 200; i++) compacted.setQuestionField(3, "answer", {"answer " + to_string(i)}, error);
+            journal.sync();
+            journal.waitForCompaction();
+            assert(journal.currentGeneration() > 1 && journal.syncCount() >= 1);
+        }
+        {
+            EditJournal journal;
+            Quiz reopened;
+            assert(reopened.openJournal(journal, base, error) && reopened.getQuestionCount() == 3);
+            shared_ptr<const QuestionBank> shared = reopened.publish();
+            assert(shared->questions.correctAnswer(shared->questions.slotOf(3)) == "answer 199");
+            assert(access((base + ".journal.1").c_str(), F_OK) != 0);  // Folded into a snapshot and removed
+        }
+        string kept;
+        {
+            // A full disk: the file size limit lets a record or two through, then cuts one off part way
+            EditJournal journal;
+            Quiz failing;
+            assert(failing.openJournal(journal, base, error) && journal.sync());
+            struct stat info;
+            assert(stat((base + ".journal." + to_string(journal.currentGeneration())).c_str(), &info) == 0);
+            rlimit original, limited;
+            getrlimit(RLIMIT_FSIZE, &original);
+            limited = original;
+            limited.rlim_cur = info.st_size + 150;
+            signal(SIGXFSZ, SIG_IGN);
+            setrlimit(RLIMIT_FSIZE, &limited);
+            int edit = 0;
+            for (; edit < 20; edit++) {
+                string answer = "kept " + to_string(edit);
+                assert(failing.setQuestionField(3, "answer", {answer}, error));
+                if (!journal.sync()) break;
+                kept = answer;
+            }
+            setrlimit(RLIMIT_FSIZE, &original);
+            signal(SIGXFSZ, SIG_DFL);
+            assert(edit > 0 && edit < 20 && journal.hasFailed());
+            // Once failed, every change is refused instead of being reported as saved
+            assert(!failing.setQuestionField(3, "answer", {"lost"}, error) && error == Quiz::journalFailedMessage);
+            assert(failing.addQuestion("tf", "Lost", {}, "true", 1, error) == -1 && !failing.removeQuestion(1));
+        }
+        {
+            // Recovery keeps every edit that was reported durable; the partial record was cut back off
+            EditJournal journal;
+            Quiz reopened;
+            assert(reopened.openJournal(journal, base, error) && reopened.getQuestionCount() == 3);
+            shared_ptr<const QuestionBank> shared = reopened.publish();
+            assert(shared->questions.correctAnswer(shared->questions.slotOf(3)) == kept);
+        }
+        removeFiles();
+    }
+    cout << "\nCase 19 Passed" << endl << endl;
+
+    //Unit test 20
+    //test bank versions: pages shared between versions, pinned readers, and freeing drained versions
+    cout << "Unit Test Case 20: Publish bank versions while attempts keep reading the version they pinned" << endl;
+    {
+        Quiz authoring;
+        string error;
+        for (int i = 0; i < 300; i++) authoring.addQuestion("tf", "Statement " + to_string(i), {}, "true", 1, error);
+        BankPublisher publisher(authoring.publish());
+        shared_ptr<const QuestionBank> first = publisher.pin();
+        QuizSession early(publisher.pin());
+        bool close;
+        assert(early.handle("JUMP 5", close) == "Q 5\ttf\tStatement 4");
+
+        // An edit copies the page holding the question and shares every other page
+        assert(authoring.setQuestionField(5, "text", {"Edited statement"}, error));
+        assert(publisher.publish(authoring.publish()) == 2);
+        shared_ptr<const QuestionBank> second = publisher.pin();
+        int slot = second->questions.slotOf(5);
+        assert(!second->questions.sharesSlot(first->questions, slot));
+        assert(second->questions.sharesSlot(first->questions, slot + QuestionStore::pageSize));
+        assert(first->questions.row(slot).text(first->questions.strings()) == "Statement 4" && second->questions.row(slot).text(second->questions.strings()) == "Edited statement");
+        assert(early.handle("JUMP 5", close) == "Q 5\ttf\tStatement 4");  // Still on the version it pinned
+        QuizSession late(publisher.pin());
+        assert(late.handle("JUMP 5", close) == "Q 5\ttf\tEdited statement");
+
+        // Deletes publish the same way; a version is freed once its last reader lets go
+        assert(authoring.removeQuestion(1));
+        publisher.publish(authoring.publish());
+        assert(publisher.pin()->questions.size() == 299 && first->questions.size() == 300);
+        weak_ptr<const QuestionBank> firstVersion = first;
+        first.reset();
+        assert(!firstVersion.expired());  // The early session still holds it
+        early = QuizSession(publisher.pin());
+        assert(firstVersion.expired());
+
+        // Readers pin and read on several threads while new versions are published
+        atomic<bool> done{false};
+        atomic<size_t> reads{0};
+        vector<thread> readers;
+        for (int t = 0; t < 3; t++) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    shared_ptr<const QuestionBank> pinned = publisher.pin();
+                    const QuestionStore& questions = pinned->questions;
+                    assert(questions.row(questions.slotOf(5)).text(questions.strings()).rfind("Edited statement", 0) == 0);
+                    assert(pinned->totalPoints == questions.size());
+                    uint64_t seen = publisher.version();  // Never reads a node a publish may be freeing
+                    assert(seen >= 3 && seen <= 203);
+                    reads++;
+                }
+            });
+        }
+        for (int version = 0; version < 200; version++) {
+            authoring.setQuestionField(5, "text", {"Edited statement " + to_string(version)}, error);
+            publisher.publish(authoring.publish());
+        }
+        done = true;
+        for (auto& reader : readers) reader.join();
+        shared_ptr<const QuestionBank> last = publisher.pin();
+        assert(last->questions.row(last->questions.slotOf(5)).text(last->questions.strings()) == "Edited statement 199");
+        assert(publisher.version() == 203);
+    }
+    cout << "\nCase 20 Passed" << endl << endl;
+
+    //Unit test 21
+    //test item analysis: difficulty, point-biserial, response counts and reliability, however sheets are chunked
+    cout << "Unit Test Case 21: Analyze items while grading a sitting" << endl;
+    {
+        GradingKey key;
+        key.add(1, "b", 1);
+        key.add(2, "true", 1);
+        key.add(3, "a", 2);
+        key.totalPoints = 4;
+        key.pack();
+        string sheets = "s1\t1=b\t2=true\t3=a\n"
+                        "s2\t1=B\t2=false\t3=c\n"
+                        "s3\t1=a\t2=true\t3=a\n"
+                        "s4\t2=false\t3=b\n";
+        WorkStealingPool pool(2);
+        ItemAccumulator whole, chunked;
+        for (size_t chunk : {size_t(512), size_t(1)}) {
+            istringstream in(sheets);
+            ostringstream out;
+            gradeBatch(key, in, out, pool, chunk, chunk == 1 ? &chunked : &whole);
+        }
+        auto near = [](double a, double b) { return fabs(a - b) < 1e-9; };
+        for (const ItemAccumulator* items : {&whole, &chunked}) {
+            SittingStatistics sitting = items->summarize(key);
+            // Scores 4, 1, 3, 0: mean 2, variance 2.5; right counts 3, 1, 2, 0: variance 1.25
+            assert(sitting.sheets == 4 && near(sitting.meanScore, 2) && near(sitting.scoreDeviation, sqrt(2.5)));
+            assert(near(sitting.items[0].difficulty, 0.5) && near(sitting.items[0].pointBiserial, 0.5 / sqrt(2.5)));
+            assert(near(sitting.items[1].pointBiserial, 1.5 / sqrt(2.5)) && near(sitting.items[2].pointBiserial, 1.5 / sqrt(2.5)));
+            assert(near(sitting.kr20, 0.6) && near(sitting.alpha, 0.6));
+        }
+        ostringstream report;
+        whole.writeReport(key, report);
+        assert(report.str().find("1\tb\t0.500\t0.316\tblank=1 a=1 b=2\n") != string::npos);
+        assert(report.str().find("3\ta\t0.500\t0.949\tblank=0 a=2 b=1 c=1\n") != string::npos);
+        // Everyone right on one question: its discrimination is undefined, not a division by zero
+        ItemAccumulator same(1);
+        uint8_t right = 1, code = 2;
+        same.addSheet(1, &right, &code);
+        same.addSheet(1, &right, &code);
+        GradingKey single;
+        single.add(7, "b", 1);
+        assert(std::isnan(same.summarize(single).items[0].pointBiserial) && std::isnan(same.summarize(single).kr20));
+    }
+    cout << "\nCase 21 Passed" << endl << endl;
+
+    //Unit test 22
+    //test numeric and multi-select questions through authoring, grading, batch grading and saving
+    cout << "Unit Test Case 22: Check numeric tolerance and multi-select question types" << endl;
+    {
+        Quiz typed;
+        string error;
+        int pi = typed.addQuestion("NUMERIC", "Value of pi?", {}, " 3.14 ~ 0.01 ", 2, error);
+        int primes = typed.addQuestion("multi", "Which are prime?", {"2", "4", "5", "9"}, "C, a", 3, error);
+        assert(pi == 1 && primes == 2);
+        assert(typed.addQuestion("numeric", "Bad key", {}, "pi", 1, error) == -1 && error == "invalid correct answer");
+        assert(typed.addQuestion("multi", "Bad key", {"x"}, "a1", 1, error) == -1 && error == "invalid correct answer");
+        assert(typed.addQuestion("essay", "Bad type", {}, "x", 1, error) == -1 && error == "invalid question type");
+        string line;
+        assert(typed.renderQuestion(primes, line) && line == "Q 2\tmulti\tWhich are prime?\tA. 2\tB. 4\tC. 5\tD. 9");
+
+        assert(NumericType::grade(NumericType::compile("3.14~0.01"), "3.15") && !NumericType::grade(NumericType::compile("3.14~0.01"), "3.16"));
+        assert(NumericType::grade(NumericType::compile("-2"), " -2.0 ") && !NumericType::grade(NumericType::compile("-2"), "two"));
+        assert(MultiType::grade(MultiType::compile("ac"), "c,a") && !MultiType::grade(MultiType::compile("ac"), "a"));
+
+        typed.recordAnswer(pi, "3.149");
+        typed.recordAnswer(primes, "c a");
+        assert(typed.gradeAnswers() == 5);
+        typed.recordAnswer(primes, "abc");
+        assert(typed.gradeAnswers() == 2);
+
+        // Batch grading runs the same policies without the quiz
+        GradingKey key = typed.gradingKey();
+        assert(key.kinds[0] == QuestionKind::numeric && key.kinds[1] == QuestionKind::multi && key.textPositions.size() == 2);
+        istringstream sheets("s1\t1=3.135\t2=A,C\ns2\t1=3\t2=ac\n");
+        ostringstream scores;
+        WorkStealingPool pool(1);
+        gradeBatch(key, sheets, scores, pool);
+        assert(scores.str() == "s1\t5.00\t5.00\ns2\t3.00\t5.00\n");
+
+        // A type change keeps the answer only if the new type accepts it
+        assert(!typed.setQuestionField(pi, "type", {"tf"}, error) && error == "correct answer does not fit tf");
+        assert(typed.setQuestionField(primes, "type", {"MCQ"}, error) && typed.gradingKey().kinds[1] == QuestionKind::mcq);
+        assert(typed.setQuestionField(primes, "type", {"multi"}, error) && typed.setQuestionField(primes, "answer", {"A C"}, error));
+        assert(!typed.setQuestionField(pi, "answer", {"3.14~-1"}, error) && error == "invalid correct answer");
+
+        const string path = "unit_test_types.bank";
+        assert(typed.save(path));
+        Quiz reopened;
+        assert(reopened.open(path));
+        GradingKey again = reopened.gradingKey();
+        assert(again.kinds == typed.gradingKey().kinds && again.correctAnswers[1] == "ac");
+        remove(path.c_str());
+    }
+    cout << "\nCase 22 Passed" << endl << endl;
+
+    //Unit test 23
+    //test exact fixed-point totals, and leaderboard ranks, percentiles, quantiles and top list under parallel ingestion
+    cout << "Unit Test Case 23: Rank graded attempts on a leaderboard" << endl;
+    {
+        Quiz tenths;
+        string error;
+        for (int i = 0; i < 1000; i++) tenths.addQuestion("tf", "Statement", {}, "true", 0.1, error);
+        assert(tenths.getTotalPoints() == 100);
+        for (int id = 1; id <= 1000; id += 2) tenths.removeQuestion(id);
+        assert(tenths.getTotalPoints() == 50);
+        for (int id = 2; id <= 1000; id += 2) tenths.removeQuestion(id);
+        assert(tenths.getTotalPoints() == 0);
+
+        const string attempts = "alice\t90.00\t100.00\nbob\t75.50\t100.00\ncarol\t90.00\t100.00\n"
+                                "eve\tabc\t100.00\nalice\t95.00\t100.00\r\ndave\t60.00\t100.00\n"
+                                "frank\nerin\t90.00\t100.00\nalice\t10.00\t100.00\n";
+        WorkStealingPool pool(3);
+        for (size_t chunkBytes : {size_t(1) << 20, size_t(16)}) {
+            Leaderboard board(2);
+            istringstream in(attempts);
+            assert(board.ingest(in, pool, chunkBytes) == 2);
+            assert(board.attempts() == 7 && board.students() == 5);
+            vector<LeaderboardEntry> leaders = board.leaders();
+            assert(leaders.size() == 2 && leaders[0].student == "alice" && leaders[0].score == toFixedPoints(95));
+            assert(leaders[1].student == "carol");  // Tied with erin, listed by id
+            Standing alice, carol, erin, dave;
+            assert(board.standing("alice", alice) && board.standing("carol", carol) && board.standing("erin", erin));
+            assert(board.standing("dave", dave) && !board.standing("frank", dave) && !board.standing("eve", dave));
+            assert(alice.score == 95 && alice.rank == 1 && alice.percentile == 90);
+            assert(carol.rank == 2 && erin.rank == 2 && carol.percentile == 60);
+            assert(dave.rank == 5 && dave.percentile == 10);
+            assert(board.quantile(0.5) == 90 && board.quantile(0) == 60 && board.quantile(1) == 95);
+        }
+
+        // With more distinct scores than buckets can tell apart, ranks stay close to exact
+        Leaderboard crowd;
+        SplitMix64 random(23);
+        vector<FixedPoints> scores(20000);
+        {
+            Leaderboard::Writer writer(crowd);
+            for (size_t i = 0; i < scores.size(); i++) {
+                scores[i] = static_cast<FixedPoints>(random.next() % 100000000);
+                writer.record("student" + to_string(i), scores[i]);
+            }
+        }
+        vector<FixedPoints> sorted = scores;
+        sort(sorted.begin(), sorted.end());
+        for (size_t i = 0; i < scores.size(); i += 997) {
+            Standing standing;
+            assert(crowd.standing("student" + to_string(i), standing));
+            int64_t exact = sorted.end() - upper_bound(sorted.begin(), sorted.end(), scores[i]) + 1;
+            assert(llabs(static_cast<int64_t>(standing.rank) - exact) <= 20);
+        }
+    }
+    cout << "\nCase 23 Passed" << endl << endl;
+
+    //Unit test 24
+    //test IRT parameters through saving and journaling, and adaptive selection within content and exposure limits
+    cout << "Unit Test Case 24: Give adaptive tests from a calibrated bank" << endl;
+    {
+        Quiz calibrated;
+        string error;
+        // 300 tf and 200 mcq questions, difficulties spread evenly over -3..3
+        for (int i = 0; i < 500; i++) {
+            int id = i < 300 ? calibrated.addQuestion("tf", "Statement " + to_string(i), {}, "true", 1, error)
+                             : calibrated.addQuestion("mcq", "Pick one " + to_string(i), {"yes", "no"}, "a", 1, error);
+            assert(calibrated.setQuestionField(id, "irt", {"1.5", to_string(-3 + 6.0 * (i % 100) / 99)}, error));
+        }
+        assert(!calibrated.setQuestionField(1, "irt", {"0", "1"}, error) && error == "invalid IRT parameters");
+        assert(!calibrated.setQuestionField(1, "irt", {"1", "hard"}, error) && !calibrated.setQuestionField(1, "irt", {"1", "0", "1"}, error));
+
+        // Parameters survive a save, and a version 1 bank (no parameter section) opens uncalibrated
+        const string path = "unit_test_adaptive.bank";
+        assert(calibrated.save(path));
+        Quiz reopened;
+        assert(reopened.open(path));
+        const ItemParameters& saved = reopened.publish()->questions.parameters(99);
+        assert(saved.discrimination == 1.5f && saved.difficulty == 3.0f && saved.guessing == 0.0f);
+        {
+            ifstream in(path, ios::binary);
+            string file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            BankHeader header;
+            memcpy(&header, file.data(), sizeof(header));
+            file.erase(sizeof(header) + header.questionCount * sizeof(BankRecord), header.questionCount * sizeof(BankParameters));
+            header.version = 1;
+            header.checksum = bankChecksum(file.data() + sizeof(header), file.size() - sizeof(header));
+            memcpy(&file[0], &header, sizeof(header));
+            ofstream(path, ios::binary | ios::trunc) << file;
+        }
+        Quiz older;
+        assert(older.open(path) && older.getQuestionCount() == 500 && older.publish()->questions.parameters(99).isDefault());
+        remove(path.c_str());
+
+        // ... and a journal replay
+        string base = "unit_test_adaptive";
+        auto removeFiles = [&base] {
+            remove((base + ".journal.1").c_str());
+            remove((base + ".snapshot.1").c_str());
+        };
+        removeFiles();
+        {
+            EditJournal journal;
+            Quiz authoring;
+            assert(authoring.openJournal(journal, base, error));
+            int id = authoring.addQuestion("tf", "Calibrated", {}, "true", 1, error);
+            assert(authoring.setQuestionField(id, "irt", {"2", "-1", "0.25"}, error));
+            journal.sync();
+        }
+        {
+            EditJournal journal;
+            Quiz recovered;
+            assert(recovered.openJournal(journal, base, error));
+            const ItemParameters& replayed = recovered.publish()->questions.parameters(0);
+            assert(replayed.discrimination == 2.0f && replayed.difficulty == -1.0f && replayed.guessing == 0.25f);
+        }
+        removeFiles();
+
+        // The first question suits an average taker; quotas keep the bank's 3:2 mix; nothing repeats
+        AdaptiveSpec spec;
+        spec.questions = 10;
+        AdaptiveTest test(calibrated.publish(), spec);
+        const QuestionStore& store = test.questions();
+        AdaptiveSession first(test, 0);
+        int slot = first.next();
+        assert(fabs(store.parameters(slot).difficulty) < 0.1 && first.next() == slot);
+        assert(first.answer(store.type(slot) == QuestionKind::tf ? "TRUE" : "A") && first.ability() > 0);
+        assert(!first.answer("true"));  // Nothing is pending until next() asks again
+
+        // A taker who knows everything below 1.2 is placed near 1.2
+        AdaptiveSession able(test, 1);
+        vector<int> asked;
+        for (slot = able.next(); slot != -1; slot = able.next()) {
+            asked.push_back(slot);
+            able.record(store.parameters(slot).difficulty < 1.2f);
+        }
+        assert(asked.size() == 10 && able.asked() == 10 && fabs(able.ability() - 1.2) < 0.4 && able.standardError() < 0.5);
+        assert(count_if(asked.begin(), asked.end(), [&store](int s) { return store.type(s) == QuestionKind::tf; }) == 6);
+        sort(asked.begin(), asked.end());
+        assert(unique(asked.begin(), asked.end()) == asked.end());
+
+        // Many average takers: no question is given in much more than maxExposure of the tests
+        for (uint64_t taker = 2; taker < 200; taker++) {
+            AdaptiveSession session(test, taker);
+            for (slot = session.next(); slot != -1; slot = session.next()) session.record(store.parameters(slot).difficulty < 0);
+        }
+        size_t used = 0;
+        for (int s = store.nextLive(0); s != -1; s = store.nextLive(s + 1)) {
+            assert(test.exposure(s) <= spec.maxExposure * test.testsStarted() + 1);
+            used += test.exposure(s) > 0;
+        }
+        assert(used >= 50);
+
+        // With a target error the test stops as soon as it is reached
+        spec.questions = 100;
+        spec.targetError = 0.5;
+        AdaptiveTest precise(calibrated.publish(), spec);
+        AdaptiveSession quick(precise, 0);
+        for (slot = quick.next(); slot != -1; slot = quick.next()) quick.record(precise.questions().parameters(slot).difficulty < -0.5f);
+        assert(quick.asked() < 100 && quick.standardError() < 0.5);
+    }
+    cout << "\nCase 24 Passed" << endl << endl;
+
+    //Unit test 25
+    //test the timing wheel against a sorted list, and exam and question time limits on sessions and the server
+    cout << "Unit Test Case 25: Warn, expire and auto-submit timed sessions from a timing wheel" << endl;
+    {
+        // Random deadlines from now to past the top level's reach, some cancelled, fired in uneven steps
+        TimingWheel wheel(1000);
+        SplitMix64 random(25);
+        map<pair<uint64_t, uint64_t>, bool> expected;  // (deadline, payload) not yet fired or cancelled
+        vector<uint64_t> deadlines;
+        vector<TimingWheel::Handle> handles;
+        for (uint64_t i = 0; i < 20000; i++) {
+            uint64_t reach = 1ull << (8 * (1 + random.below(4)));
+            deadlines.push_back(1000 + random.below(reach) + (i % 1000 == 0 ? (1ull << 33) : 0));
+            handles.push_back(wheel.schedule(deadlines.back(), i));
+            expected[{deadlines.back(), i}] = true;
+        }
+        for (uint64_t i = 0; i < handles.size(); i += 3) {
+            assert(wheel.cancel(handles[i]) && !wheel.cancel(handles[i]));
+            expected.erase({deadlines[i], i});
+        }
+        assert(wheel.size() == expected.size() && !wheel.cancel(0));
+        uint64_t now = 1000;
+        size_t budgeted = 0;
+        while (!expected.empty()) {
+            assert(wheel.nextDue() <= expected.begin()->first.first);
+            now = random.below(4) == 0 ? wheel.nextDue() : now + random.below(1ull << (4 * random.below(9)));
+            uint64_t lastDeadline = 0;
+            auto fire = [&](uint64_t payload) {
+                size_t erased = expected.erase({deadlines[payload], payload});
+                assert(erased == 1 && deadlines[payload] <= now && deadlines[payload] >= lastDeadline);
+                lastDeadline = deadlines[payload];
+            };
+            size_t fired = wheel.advance(now, fire, 50);
+            budgeted += fired == 50;
+            while (fired == 50) fired = wheel.advance(now, fire, 50);
+            assert(expected.empty() || expected.begin()->first.first > now);
+        }
+        assert(wheel.size() == 0 && wheel.nextDue() == UINT64_MAX && budgeted > 0 && now > (1ull << 33));
+        assert(!wheel.cancel(handles[1]) && wheel.schedule(5, 7) != handles[1]);
+
+        // A session's limits, driven by hand: exam 10 s, questions 3 s each, warnings 1 s ahead
+        SyntheticBankSpec spec;
+        spec.questions = 3;
+        spec.mcqShare = 0;
+        spec.tfShare = 1;
+        Quiz bank;
+        buildSyntheticBank(bank, spec);
+        ExamTiming timing;
+        timing.exam = chrono::seconds(10);
+        timing.question = chrono::seconds(3);
+        timing.warning = chrono::seconds(1);
+        auto start = QuizSession::Clock::now();
+        auto at = [start](double seconds) { return start + chrono::milliseconds(static_cast<long>(seconds * 1000)); };
+        QuizSession session(bank.publish(), timing, start);
+        bool close = false;
+        assert(session.greeting() == "READY 3 TIMED 10000 3000");
+        assert(session.alarmTime(QuizSession::examAlarm) == at(9) && session.alarmTime(QuizSession::questionAlarm) == QuizSession::Clock::time_point::max());
+        assert(session.handle("NEXT", close, at(0)).rfind("Q 1\t", 0) == 0 && session.alarmTime(QuizSession::questionAlarm) == at(2));
+        assert(session.alarm(QuizSession::questionAlarm, at(2), close) == "WARN QUESTION 1 1" && session.alarmTime(QuizSession::questionAlarm) == at(3));
+        assert(session.handle("JUMP 2", close, at(2.5)).rfind("Q 2\t", 0) == 0);  // Question 1 keeps its 0.5 s
+        assert(session.handle("JUMP 1", close, at(4)).rfind("Q 1\t", 0) == 0 && session.alarmTime(QuizSession::questionAlarm) == at(3.5));
+        assert(session.alarm(QuizSession::questionAlarm, at(4.5), close) == "EXPIRED 1" && !close);
+        assert(session.handle("ANSWER true", close, at(5)) == "ERR no current question");
+        assert(session.handle("JUMP 1", close, at(5)) == "ERR time is up for question 1");
+        assert(session.handle("NEXT", close, at(5)).rfind("Q 2\t", 0) == 0);
+        // An answer after the limit is refused even if the alarm has not arrived yet
+        assert(session.handle("ANSWER true", close, at(9)) == "EXPIRED 2\nERR no current question");
+        assert(session.handle("SUBMIT", close, at(9)) == "CONFIRM 1 unanswered");
+        assert(session.alarm(QuizSession::examAlarm, at(9), close) == "WARN EXAM 1" && session.alarmTime(QuizSession::examAlarm) == at(10));
+        assert(session.alarm(QuizSession::examAlarm, at(10), close).rfind("TIMEOUT\nSCORE 0.00 ", 0) == 0 && close);
+        assert(session.handle("NEXT", close, at(11)).rfind("TIMEOUT\nSCORE", 0) == 0 && close);
+
+        // The server pushes the same lines on its own, without the taker asking
+        timing.exam = chrono::milliseconds(300);
+        timing.question = chrono::milliseconds(0);
+        timing.warning = chrono::seconds(60);  // Due before the server started: sent at once
+        QuizServer server(bank.publish(), timing);
+        string error;
+        assert(server.start("unix:/tmp/quiz_unit_test_timed.sock", 1, error));
+        sockaddr_storage address;
+        socklen_t length;
+        assert(parseSocketAddress("unix:/tmp/quiz_unit_test_timed.sock", address, length));
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        assert(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), length) == 0);
+        timeval patience{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &patience, sizeof(patience));
+        string received;
+        char block[4096];
+        ssize_t n;
+        while ((n = recv(fd, block, sizeof(block), 0)) > 0) received.append(block, n);
+        ::close(fd);
+        server.stop();
+        char expectedLines[128];
+        snprintf(expectedLines, sizeof(expectedLines), "READY 3 TIMED 300 0\nWARN EXAM 1\nTIMEOUT\nSCORE 0.00 %.2f\n", bank.getTotalPoints());
+        assert(received == expectedLines);
+    }
+    cout << "\nCase 25 Passed" << endl << endl;
+
+    //Unit test 26
+    //test near-duplicate detection: signature estimates, the batch pass over a quiz and a bank file, and the check on insert
+    cout << "Unit Test Case 26: Find near-duplicate questions with MinHash signatures and LSH bands" << endl;
+    {
+        // Signatures read text as the search index does, and estimate the shingles' exact Jaccard similarity
+        MinHasher hasher;
+        MinHashSignature first, second;
+        hasher.add("What is the capital city of France?");
+        assert(hasher.finish(first) && !hasher.finish(second));
+        hasher.add("what IS the capital city, of  france");
+        assert(hasher.finish(second) && first.similarity(second) == 1);
+        hasher.add("?! --");
+        assert(!hasher.finish(second));
+        auto shingles = [](const string& text) {
+            vector<string> pieces;
+            for (size_t at = 0; at + 5 <= text.size(); at++) pieces.push_back(text.substr(at, 5));
+            sort(pieces.begin(), pieces.end());
+            pieces.erase(unique(pieces.begin(), pieces.end()), pieces.end());
+            return pieces;
+        };
+        SplitMix64 random(26);
+        double totalError = 0;
+        for (int trial = 0; trial < 200; trial++) {
+            string text = syntheticText(random, 200), edited = text;
+            for (uint64_t edits = 1 + random.below(30); edits > 0; edits--) edited[random.below(edited.size())] = static_cast<char>('a' + random.below(26));
+            vector<string> a = shingles(text), b = shingles(edited), common;
+            set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(common));
+            double exact = static_cast<double>(common.size()) / (a.size() + b.size() - common.size());
+            hasher.add(text);
+            hasher.finish(first);
+            hasher.add(edited);
+            hasher.finish(second);
+            assert(fabs(first.similarity(second) - exact) < 0.25);
+            totalError += fabs(first.similarity(second) - exact);
+        }
+        assert(totalError / 200 < 0.05);
+
+        // Plant copies of some questions with one character changed among unrelated synthetic questions
+        SyntheticBankSpec spec;
+        spec.questions = 3000;
+        spec.vocabulary = 5000;
+        spec.seed = 26;
+        Quiz bank;
+        buildSyntheticBank(bank, spec);
+        shared_ptr<const QuestionBank> originals = bank.publish();
+        vector<pair<int, int>> planted;  // (original id, copy id)
+        string error;
+        for (int id = 7; id <= 3000; id += 75) {
+            const QuestionStore& store = originals->questions;
+            int slot = store.slotOf(id);
+            string text = store.row(slot).text(store.strings());
+            text[text.size() / 2] = text[text.size() / 2] == 'q' ? 'z' : 'q';
+            vector<string> choices;
+            for (int i = 0; i < store.row(slot).choiceCount; i++) choices.emplace_back(store.row(slot).choiceText(store.strings(), i));
+            int copy = bank.addQuestion(kindName(store.type(slot)), text, choices, string(store.correctAnswer(slot)), 1, error);
+            vector<DuplicateMatch> similar = bank.similarQuestions(copy, 0.7);
+            assert(!similar.empty() && similar[0].id == id && similar[0].similarity >= 0.7 && similar.size() == 1);
+            planted.push_back({id, copy});
+        }
+        WorkStealingPool pool(4);
+        auto clustered = [](const DuplicateReport& report) {
+            vector<pair<int, int>> pairs;
+            for (const DuplicateCluster& cluster : report.clusters) {
+                assert(cluster.members.size() == 2 && cluster.members[0].similarity == 1);
+                pairs.push_back({cluster.members[0].id, cluster.members[1].id});
+            }
+            return pairs;
+        };
+        DuplicateReport report = bank.findDuplicates(0.7, pool);
+        assert(report.questions == 3000 + planted.size() && report.similarPairs == planted.size());
+        assert(clustered(report) == planted);
+
+        // The same clusters come out of the saved bank file
+        assert(bank.save("/tmp/quiz_unit_test_duplicates.bank"));
+        MappedBank mapped;
+        assert(mapped.open("/tmp/quiz_unit_test_duplicates.bank"));
+        auto source = [&mapped](size_t index, MinHasher& fileHasher) {
+            fileHasher.add(mapped, index);
+            return mapped.record(index).id;
+        };
+        assert(clustered(findNearDuplicates(mapped.size(), source, 0.7, pool)) == planted);
+        mapped.close();
+        remove("/tmp/quiz_unit_test_duplicates.bank");
+
+        // The index follows deletes and edits
+        for (size_t i = 0; i < planted.size(); i += 2) assert(bank.removeQuestion(planted[i].first));
+        for (size_t i = 0; i < planted.size(); i++) {
+            vector<DuplicateMatch> similar = bank.similarQuestions(planted[i].second, 0.7);
+            assert(similar.size() == (i % 2 == 0 ? 0u : 1u));
+        }
+        assert(bank.findDuplicates(0.7, pool).clusters.size() == planted.size() / 2);
+        int plain = bank.addQuestion("wr", "How many sides does a regular hexagon have?", {}, "6", 1, error);
+        int other = bank.addQuestion("wr", "Who painted the ceiling of the Sistine Chapel?", {}, "michelangelo", 1, error);
+        assert(bank.similarQuestions(other).empty());
+        assert(bank.setQuestionField(other, "text", {"How many sides does a regular hexagon have"}, error));
+        vector<DuplicateMatch> similar = bank.similarQuestions(other);
+        assert(similar.size() == 1 && similar[0].id == plain && similar[0].similarity == 1);
+
+        // Thousands of copies of one question stay cheap to add, check, cluster and remove
+        vector<int> copies;
+        for (int i = 0; i < 5000; i++) copies.push_back(bank.addQuestion("wr", "Name the largest ocean on Earth", {}, "pacific", 1, error));
+        similar = bank.similarQuestions(copies.back());
+        assert(similar.size() == 5 && similar[0].similarity == 1);
+        report = bank.findDuplicates(0.8, pool);
+        assert(report.clusters.back().members.size() == copies.size() && report.clusters.back().members[0].id == copies[0]);
+        for (size_t i = 1; i < copies.size(); i++) assert(bank.removeQuestion(copies[i]));
+        assert(bank.similarQuestions(copies[0]).empty());
+    }
+    cout << "\nCase 26 Passed" << endl << endl;
+
+    //Unit test 27
+    //test string interning and text coding: handles, copies sharing the pool, long text round trips, saved banks and the memory report
+    cout << "Unit Test Case 27: Intern repeated strings and code long question text against the pool" << endl;
+    {
+        // Equal strings get equal handles, the empty string is handle 0, and strings span pages
+        StringPool pool;
+        assert(pool.intern("") == 0 && pool.view(0).empty());
+        StringHandle yes = pool.intern("true");
+        assert(pool.intern(string("tr") + "ue") == yes && pool.intern("false") != yes && pool.view(yes) == "true");
+        vector<StringHandle> handles;
+        for (int i = 0; i < 3000; i++) handles.push_back(pool.intern("choice " + to_string(i)));
+        for (int i = 0; i < 3000; i++) assert(pool.intern("choice " + to_string(i)) == handles[i] && pool.view(handles[i]) == "choice " + to_string(i));
+        assert(pool.size() == 3003);
+
+        // A copy shares the strings, finds them again once it rebuilds its lookup, and adds apart from the original
+        StringPool copy = pool;
+        assert(copy.intern("choice 1234") == handles[1234] && copy.size() == 3003);
+        StringHandle added = copy.intern("only in the copy");
+        assert(added == 3003 && copy.view(added) == "only in the copy" && pool.size() == 3003);
+        assert(pool.intern("only in the original") == 3003 && copy.view(added) == "only in the copy");
+        assert(pool.view(handles[2999]) == "choice 2999");
+
+        // Long text is coded word by word and decoded exactly, blanks and line breaks included; short text is kept as is
+        string stored, scratch;
+        assert(!pool.pack("Short question text", stored) && stored == "Short question text");
+        SplitMix64 random(27);
+        for (int trial = 0; trial < 500; trial++) {
+            string text = syntheticText(random, 64 + static_cast<int>(random.below(200)), 300);
+            if (trial % 3 == 0) text = "  " + text + "\nsecond  line ";
+            bool coded = pool.pack(text, stored);
+            assert(coded && stored.size() < text.size() && pool.unpack(stored, scratch) == text);
+        }
+        string oneWord(100, 'x');  // Becomes a single handle, so identical long text is stored once
+        assert(pool.pack(oneWord, stored) && stored.size() <= 3 && pool.unpack(stored, scratch) == oneWord);
+
+        // A quiz interns keys and choices: repeated ones share a handle, a saved bank writes them once,
+        // and the grading key compiles each distinct key once
+        Quiz quiz;
+        string error;
+        string longText = "Which of the following statements about the water cycle is correct for question ";
+        vector<string> choices{"Evaporation", "Condensation", "All of the above", "None of the above"};
+        for (int i = 0; i < 400; i++) {
+            if (i % 2) quiz.addQuestion("tf", longText + to_string(i), {}, i % 4 == 1 ? "true" : "false", 1, error);
+            else quiz.addQuestion("mcq", longText + to_string(i), choices, string(1, static_cast<char>('a' + i % 4)), 2, error);
+        }
+        shared_ptr<const QuestionBank> bank = quiz.publish();
+        const QuestionStore& store = bank->questions;
+        assert(store.answerKey(store.slotOf(1)) == store.answerKey(store.slotOf(9)) && store.correctAnswer(store.slotOf(9)) == "a");
+        assert(store.row(store.slotOf(1)).choices[2] == store.row(store.slotOf(399)).choices[2]);
+        assert(store.row(0).packedText && store.row(0).text(store.strings()) == longText + "0");
+        GradingKey key = quiz.gradingKey();
+        assert(get<static_cast<size_t>(QuestionKind::tf)>(key.compiled).size() == 2);
+        assert(get<static_cast<size_t>(QuestionKind::mcq)>(key.compiled).size() == 2);  // Only "a" and "c" are used
+        vector<string> answers(key.size());
+        for (size_t i = 0; i < key.size(); i++) answers[i] = store.correctAnswer(store.slotOf(key.ids[i]));
+        answers[3] = "true";  // Question 4 is tf with "false"
+        assert(key.score(answers) == toFixedPoints(599));
+
+        assert(quiz.save("/tmp/quiz_unit_test_strings.bank"));
+        MappedBank mapped;
+        assert(mapped.open("/tmp/quiz_unit_test_strings.bank"));
+        assert(mapped.record(1).correctAnswer.offset == mapped.record(5).correctAnswer.offset);
+        assert(mapped.choiceText(mapped.record(0), 3) == "None of the above");
+        GradingKey fromFile = GradingKey::fromBank(mapped);
+        assert(get<static_cast<size_t>(QuestionKind::tf)>(fromFile.compiled).size() == 2 && fromFile.score(answers) == toFixedPoints(599));
+        Quiz reopened;
+        assert(reopened.open("/tmp/quiz_unit_test_strings.bank"));
+        shared_ptr<const QuestionBank> reread = reopened.publish();
+        for (int id = 1; id <= 400; id++) {
+            int from = store.slotOf(id), to = reread->questions.slotOf(id);
+            assert(reread->questions.row(to).text(reread->questions.strings()) == store.row(from).text(store.strings()));
+            assert(reread->questions.correctAnswer(to) == store.correctAnswer(from));
+        }
+        remove("/tmp/quiz_unit_test_strings.bank");
+
+        // The report counts every live string, and repeated keys, choices and words save bytes
+        StringMemory memory = quiz.stringMemory();
+        assert(memory.text.values == 400 && memory.answers.values == 400 && memory.choices.values == 800);
+        assert(memory.text.saved() > 0 && memory.choices.saved() > 0 && memory.answers.saved() > 0 && memory.netSaved() > 0);
+
+        // Edits after publishing leave the published text alone; compacting drops strings nothing uses
+        assert(quiz.setQuestionField(1, "text", {longText + "edited with brand new words nobody used before"}, error));
+        assert(store.row(0).text(store.strings()) == longText + "0");
+        assert(quiz.publish()->questions.row(0).text(quiz.publish()->questions.strings()).find("brand new words") != string::npos);
+        size_t before = quiz.publish()->questions.strings().size();
+        for (int id = 1; id <= 300; id++) assert(quiz.removeQuestion(id));
+        shared_ptr<const QuestionBank> compacted = quiz.publish();
+        const QuestionStore& kept = compacted->questions;
+        assert(kept.size() == 100 && kept.slotCount() < 400 && kept.strings().size() < before);
+        for (int id = 301; id <= 400; id++) assert(kept.row(kept.slotOf(id)).text(kept.strings()) == longText + to_string(id - 1));
+        assert(quiz.stringMemory().text.values == 100);
+    }
+    cout << "\nCase 27 Passed" << endl << endl;
+
+    //Unit test 28
+    //test synthetic takers: reproducible from the seed on any number of threads, sheets that grade to the scores
+    //the simulator expects, and traces that reach the same scores when replayed through quiz sessions
+    cout << "Unit Test Case 28: Simulate takers whose sheets and command traces reproduce their expected scores" << endl;
+    {
+        SyntheticBankSpec bankSpec;
+        bankSpec.questions = 60;
+        bankSpec.mcqShare = 0.3;
+        bankSpec.tfShare = 0.2;
+        bankSpec.numericShare = 0.2;
+        bankSpec.multiShare = 0.2;
+        bankSpec.seed = 28;
+        bankSpec.calibrated = true;
+        Quiz bank;
+        buildSyntheticBank(bank, bankSpec);
+        assert(bank.removeQuestion(7) && bank.removeQuestion(30));  // Sessions skip deleted slots, and so must takers
+        shared_ptr<const QuestionBank> published = bank.publish();
+        const QuestionStore& questions = published->questions;
+        int kinds[questionKindCount] = {};
+        for (int slot = questions.nextLive(0); slot != -1; slot = questions.nextLive(slot + 1)) {
+            kinds[static_cast<int>(questions.type(slot))]++;
+            assert(!questions.parameters(slot).isDefault() && validItemParameters(questions.parameters(slot)));
+        }
+        for (int count : kinds) assert(count > 0);
+        TakerSimulator simulator(questions);
+        assert(simulator.size() == 58);
+
+        TakerSpec spec;
+        spec.takers = 700;
+        spec.seed = 5;
+        auto simulate = [&](const TakerSpec& takers, unsigned threads, string& sheets, string& trace, string& scores) {
+            WorkStealingPool pool(threads);
+            ostringstream sheetsOut, traceOut, scoresOut;
+            SimulationStats stats = simulator.run(takers, &sheetsOut, &traceOut, &scoresOut, pool);
+            sheets = sheetsOut.str();
+            trace = traceOut.str();
+            scores = scoresOut.str();
+            return stats;
+        };
+        string sheets, trace, scores, sheets2, trace2, scores2;
+        SimulationStats stats = simulate(spec, 1, sheets, trace, scores);
+        assert(stats.takers == 700 && count(trace.begin(), trace.end(), '\n') == static_cast<long>(stats.events));
+        assert(count(sheets.begin(), sheets.end(), '\n') == 700 && count(scores.begin(), scores.end(), '\n') == 700);
+        assert(stats.partial > 30 && stats.partial < 120 && stats.answers > 700 * 58 * 0.9);
+        assert(trace.find("\tJUMP ") != string::npos && trace.find("\tSUBMIT FORCE\n") != string::npos);
+        assert(stats.meanScore > 0 && stats.meanScore < bank.gradingKey().totalPoints);
+
+        // The same seed gives the same run on any number of threads; another seed gives another run
+        simulate(spec, 3, sheets2, trace2, scores2);
+        assert(sheets2 == sheets && trace2 == trace && scores2 == scores);
+        TakerSpec other = spec;
+        other.seed = 6;
+        simulate(other, 1, sheets2, trace2, scores2);
+        assert(sheets2 != sheets && trace2 != trace);
+
+        // Batch grading comes to the scores the simulator expected
+        GradingKey key = bank.gradingKey();
+        WorkStealingPool pool(2);
+        istringstream sheetsIn(sheets);
+        ostringstream graded;
+        assert(gradeBatch(key, sheetsIn, graded, pool).sheets == 700 && graded.str() == scores);
+
+        // Replaying each taker's commands through a session ends in the same score, with revisions and
+        // early submits confirmed the way a real client would see them
+        istringstream traceIn(trace), scoresIn(scores);
+        string line, expected, lastReply;
+        unique_ptr<QuizSession> session;
+        size_t replayed = 0, confirms = 0;
+        string student;
+        bool close = false;
+        auto finish = [&] {
+            if (!session) return;
+            assert(close && getline(scoresIn, expected));
+            size_t tab = expected.find('\t');
+            assert(expected.substr(0, tab) == student);
+            string score = expected.substr(tab + 1);
+            replace(score.begin(), score.end(), '\t', ' ');
+            assert(lastReply == "SCORE " + score);
+            replayed++;
+        };
+        while (getline(traceIn, line)) {
+            size_t tab = line.find('\t');
+            if (line.compare(0, tab, student) != 0 || !session) {
+                finish();
+                student = line.substr(0, tab);
+                session = make_unique<QuizSession>(published);
+                close = false;
+            }
+            assert(!close);
+            lastReply = session->handle(string_view(line).substr(tab + 1), close);
+            assert(lastReply.rfind("ERR", 0) != 0 && lastReply != "NONE");
+            confirms += lastReply.rfind("CONFIRM", 0) == 0;
+        }
+        finish();
+        assert(replayed == 700 && confirms == stats.partial);
+
+        // A saved bank file yields the same takers as the store it came from
+        const string path = "/tmp/quiz_unit_test_takers.bank";
+        assert(bank.save(path));
+        MappedBank mapped;
+        assert(mapped.open(path));
+        TakerSimulator fromFile(mapped);
+        ostringstream fileSheets, fileScores;
+        fromFile.run(spec, &fileSheets, nullptr, &fileScores, pool);
+        assert(fileSheets.str() == sheets && fileScores.str() == scores);
+        remove(path.c_str());
+    }
+    cout << "\nCase 28 Passed" << endl << endl;
+
     cout << "***End of the Debugging Version ***" << endl << endl;
 
 
 
+#elif defined(BENCHMARKING)
+    return runBenchmarks(argc, argv);
 #else
+#ifdef METRICS
+    unique_ptr<MetricsExporter> metricsExporter;
+    if (const char* metricsPath = getenv("QUIZ_METRICS_FILE")) {
+        const char* interval = getenv("QUIZ_METRICS_INTERVAL");
+        metricsExporter = make_unique<MetricsExporter>(metricsPath, interval ? atof(interval) : 10.0);
+    }
+#endif
+    if ((argc == 5 || argc == 6) && string(argv[1]) == "--grade") {
+        return runBatchGrading(argv[2], argv[3], argv[4], argc == 6 ? argv[5] : "");
+    }
+    if (argc >= 3 && string(argv[1]) == "--leaderboard") {
+        return runLeaderboard(argv[2], vector<string>(argv + 3, argv + argc));
+    }
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--take") {
+        return runTimedExam(argv[2], chrono::seconds(argc == 4 ? atoi(argv[3]) : 0));
+    }
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--adaptive") {
+        return runAdaptive(argv[2], argc == 4 ? strtoull(argv[3], nullptr, 10) : 20);
+    }
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--duplicates") {
+        return runDuplicates(argv[2], argc == 4 ? strtod(argv[3], nullptr) : 0.8);
+    }
+    if (argc == 3 && string(argv[1]) == "--verify") {
+        return runVerify(argv[2]);
+    }
+    if (argc == 3 && string(argv[1]) == "--memory") {
+        return runMemory(argv[2]);
+    }
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "--synthesize") {
+        return runSynthesize(argv[2], strtoull(argv[3], nullptr, 10), argc == 5 ? strtoull(argv[4], nullptr, 10) : 1);
+    }
+    if (argc >= 5 && argc <= 7 && string(argv[1]) == "--simulate") {
+        return runSimulation(argv[2], strtoull(argv[3], nullptr, 10), argv[4], argc >= 6 ? argv[5] : "",
+                             argc == 7 ? strtoull(argv[6], nullptr, 10) : 1);
+    }
+    if (argc == 4 && string(argv[1]) == "--import") {
+        return runImport(argv[2], argv[3]);
+    }
+    if ((argc == 5 || argc == 6) && string(argv[1]) == "--forms") {
+        return runFormGeneration(argv[2], strtoull(argv[3], nullptr, 10), strtoull(argv[4], nullptr, 10),
+                                 argc == 6 ? strtoull(argv[5], nullptr, 10) : 1);
+    }
+    if (argc >= 4 && argc <= 7 && string(argv[1]) == "--serve") {
+        ExamTiming timing;
+        if (argc >= 6) timing.exam = chrono::seconds(atoi(argv[5]));
+        if (argc == 7) timing.question = chrono::seconds(atoi(argv[6]));
+        // Warn a minute ahead, or a fifth of the way from the end of a shorter limit
+        for (chrono::milliseconds limit : {timing.exam, timing.question}) {
+            if (limit.count() > 0) timing.warning = min(timing.warning, limit / 5);
+        }
+        return runServer(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : thread::hardware_concurrency(), timing);
+    }
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "--loadtest") {
+        return runLoadTestCommand(argv[2], strtoull(argv[3], nullptr, 10), argc == 5 ? atoi(argv[4]) : 64);
+    }
+    if (argc == 3 && string(argv[1]) == "--script") {
+        TranscriptWriter transcript(stdout);
+        ScriptDriver driver(transcript);
+        if (string(argv[2]) == "-") {
+            driver.run(cin);
+        } else {
+            ifstream script(argv[2]);
+            if (!script) {
+                cout << "[Could not open script " << argv[2] << "]" << endl;
+                return 1;
+            }
+            driver.run(script);
+        }
+        return driver.errorCount() == 0 ? 0 : 2;
+    }
+
+    EditJournal journal;  // Outlives the quiz, which only points at it
     Quiz quiz;   // Create an instance of the Quiz class
     bool cont = true;
+    if (argc == 3 && string(argv[1]) == "--journal") {
+        string error;
+        if (!quiz.openJournal(journal, argv[2], error)) {
+            cout << "[Could not open edit journal: " << error << "]" << endl;
+            return 1;
+        }
+        quiz.displaySessionLog();
+    }
 
     // Main loop for quiz management
     while (cont) {
@@ -698,6 +10144,9 @@ int main() {
         cout << "\t2. Edit question\n";
         cout << "\t3. Delete question\n";
         cout << "\t4. Finish\n";
+        cout << "\t5. Save quiz bank\n";
+        cout << "\t6. Open quiz bank\n";
+        cout << "\t7. Import questions from CSV or JSONL\n";
         cout << "Select an action: ";
         int action;
         cin >> action;
@@ -720,6 +10169,22 @@ int main() {
                     cont = false;
                 }
                 break;
+            case 5:
+            case 6: {
+                string path;
+                cout << "Quiz bank file: ";
+                getline(cin, path);
+                if (action == 5 && quiz.save(path)) cout << "Quiz bank saved." << endl;
+                if (action == 6 && quiz.open(path)) quiz.displaySessionLog();
+                break;
+            }
+            case 7: {
+                string path;
+                cout << "CSV or JSONL file: ";
+                getline(cin, path);
+                if (importQuestions(quiz, path)) quiz.displaySessionLog();
+                break;
+            }
             default:
                 cout << "[Unknown input, please try again]" << endl;
         }